@@ -0,0 +1,35 @@
+#if !defined(SIMD_DEFS_H)
+#define SIMD_DEFS_H
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+//  SIMD code paths are selected at compile time by the target instruction set
+//  (-mavx2, -mavx512f, /arch:AVX2 ...); every kernel has a scalar fallback
+//-----------------------------------------------------------------------------
+#if defined(__AVX2__)
+    #define ENA_SIMD_AVX2
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    #define ENA_SIMD_AVX512
+#endif
+
+#if defined(__SSE4_2__)
+    #define ENA_SIMD_SSE42
+#endif
+
+#if defined(__PCLMUL__)
+    #define ENA_SIMD_PCLMUL
+#endif
+
+#if defined(ENA_SIMD_AVX2) || defined(ENA_SIMD_AVX512) || defined(ENA_SIMD_SSE42) || defined(ENA_SIMD_PCLMUL)
+    #include <immintrin.h>
+#endif
+
+namespace SysUtils {
+    //-----------------------------------------------------------------------------
+    inline bool isAligned(const void* ptr, unsigned alignment) { return (reinterpret_cast<uintptr_t>(ptr) & (alignment - 1)) == 0; }
+}
+
+#endif // SIMD_DEFS_H
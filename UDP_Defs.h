@@ -53,15 +53,61 @@ namespace UDP_LIB
 		int           isStream;    // stream or common transfer, when bundle has only 1 packet transfer is not stream
 	};
 
+	struct TRxInfo
+	{
+		uint64_t      firstTime;   // kernel receive time of the first packet of the bundle, ns of CLOCK_REALTIME, 0 - not available
+		uint64_t      lastTime;    // receive time of the last packet
+		uint32_t      drops;       // packets dropped by the socket (receive buffer overflow) since the previous bundle of the socket
+	};
+
+	struct TTxStat
+	{
+		uint64_t      packets;     // sent by the transmit channel and sendGather()
+		uint64_t      bytes;       // UDP payload
+		uint64_t      firstTime;   // start of the first send, ns of CLOCK_MONOTONIC (departure time with TxTime)
+		uint64_t      lastTime;    // end of the last send
+		uint64_t      bitRate;     // achieved between firstTime and lastTime, UDP payload bit/s
+		uint64_t      packetRate;  // packets/s
+	};
+
+	struct TSegment
+	{
+		const void*   buf;
+		unsigned      length;
+	};
+
+	struct TGatherPacket
+	{
+		const TSegment* segments;  // packet data is the concatenation of the segments
+		unsigned        segmentNum;
+	};
+
 	struct TNetAddr
 	{
 		unsigned long ipAddr;
 		unsigned      port;
 	};
 
+	struct TSocketObject;
+	typedef TSocketObject* TSocketHandle;  // opaque socket reference (Linux), see createSocketHandle()
+
+	typedef enum
+	{
+		UseUring            = 0x0001,  // Linux: io_uring instead of internal thread (see qudp_linux.h), fallback to the thread when not available
+		UseOffload          = 0x0002,  // Linux: UDP GSO (transmit), GRO (receive)
+		PinThreads          = 0x0004,  // Linux: internal thread(s) pinned to CPU TParams::cpu (+ queue index)
+		SteerByPeer         = 0x0008,  // Linux: receive queue selected by peer IP address (default - by flow hash)
+		SteerByCpu          = 0x0010,  // Linux: receive queue selected by receiving CPU (queue 'n' - CPU 'n')
+		RxTimestamps        = 0x0020,  // Linux: TRxInfo of received bundles (SO_TIMESTAMPNS, SO_RXQ_OVFL), UseUring is ignored
+		TxTime              = 0x0040   // Linux: transmit pacing by departure times (SO_TXTIME, fq qdisc on the interface), user space pacing when not available
+	} TOption;
+
 	typedef void (*OnTransferReadyFunc)(const TNetAddr& host, const TNetAddr& peer, UDP_LIB::TDirection dir);
 	struct TParams
 	{
+		TParams() : netPacketSize(0), numPacketsInBundle(0), numBundles(0), threadPriority(0), timeout(0), socketBufSize(0), peerAddr(0), peerPort(0),
+		            onTransferReady(0), options(0), queueNum(0), cpu(0), txBitRate(0), txPacketRate(0), txBurst(0) {}
+
 		unsigned            netPacketSize;			// size of 'atomic' UDP packet ('small buffer')
 		unsigned            numPacketsInBundle;     // number of 'atomic' UDP packets in bundle
 		unsigned            numBundles;				// number of bundles ('big buffers')
@@ -71,6 +117,12 @@ namespace UDP_LIB
 		unsigned long       peerAddr;				// peer (another side) IP address
 		unsigned            peerPort;				// peer (another side) IP port
 		OnTransferReadyFunc onTransferReady;        // callback function (notifier), called from TSocket::onExec() at the end of (!) 'sendToReadyQueue'
+		unsigned            options;				// TOption bits, 0 - defaults
+		unsigned            queueNum;				// Linux: receive queues (SO_REUSEPORT sockets of one port), 0 - one
+		int                 cpu;					// Linux: CPU of the thread of queue 0, see PinThreads
+		uint64_t            txBitRate;				// Linux: transmit pacing, UDP payload bit/s, 0 - no limit
+		unsigned            txPacketRate;			// Linux: transmit pacing, packets/s, 0 - no limit
+		unsigned            txBurst;				// Linux: packets sent back-to-back when paced, 0 - 1
 	};
 }    
 
@@ -0,0 +1,198 @@
+#if !defined(CRC32C_H)
+#define CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "SimdDefs.h"
+
+//-----------------------------------------------------------------------------
+//  CRC32C (Castagnoli), optionally fused with copy of the data
+//
+//  SSE4.2: data are split into 3 streams of StreamLen bytes processed in
+//  parallel (crc32 instruction latency is 3 cycles), stream CRCs are combined
+//  by carry-less multiplication (PCLMUL) or by software GF(2) multiplication;
+//  without SSE4.2 - slicing-by-8 tables
+//
+//  update() functions take and return finalized CRC value, so
+//  update(update(0,a),b) == crc(a + b)
+//-----------------------------------------------------------------------------
+class TCrc32c
+{
+    public:
+        static uint32_t calc(const void* data, size_t len) { return update(0,data,len); }
+        static uint32_t update(uint32_t crc, const void* data, size_t len) { return ~process<false>(~crc,0,static_cast<const uint8_t*>(data),len); }
+
+        //--- dst = src, returns CRC of src
+        static uint32_t copy(void* dst, const void* src, size_t len, uint32_t crc = 0)
+        {
+            return ~process<true>(~crc,static_cast<uint8_t*>(dst),static_cast<const uint8_t*>(src),len);
+        }
+
+    private:
+        static const uint32_t Poly      = 0x82F63B78;   // reflected
+        static const size_t   StreamLen = 4096;
+
+        static uint32_t multModP(uint32_t a, uint32_t b);
+        static uint32_t xPowModP(uint64_t n);
+        static uint32_t shift(uint32_t crc, size_t len);
+        static const uint32_t* table();
+
+        template<bool Copy> static uint32_t process(uint32_t crc, uint8_t* dst, const uint8_t* src, size_t len);
+        template<bool Copy> static uint32_t processStream(uint32_t crc, uint8_t* dst, const uint8_t* src, size_t len);
+};
+
+//-----------------------------------------------------------------------------
+//  a*b mod P, reflected bit order (x^0 is bit 31)
+//-----------------------------------------------------------------------------
+inline uint32_t TCrc32c::multModP(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for(uint32_t mask = 1u << 31; mask; mask >>= 1) {
+        if(a & mask) {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ Poly : b >> 1;
+    }
+    return product;
+}
+
+//-----------------------------------------------------------------------------
+inline uint32_t TCrc32c::xPowModP(uint64_t n)
+{
+    uint32_t result = 1u << 31;         // x^0
+    uint32_t power  = 1u << 30;         // x^1
+    for(; n; n >>= 1, power = multModP(power,power)) {
+        if(n & 1) {
+            result = multModP(result,power);
+        }
+    }
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+//  CRC register after 'len' zero bytes: crc*x^(8*len) mod P; constants are
+//  made once for the stream lengths used by process()
+//-----------------------------------------------------------------------------
+inline uint32_t TCrc32c::shift(uint32_t crc, size_t len)
+{
+    #if defined(ENA_SIMD_SSE42) && defined(ENA_SIMD_PCLMUL)
+    //--- clmul(crc,k)*x^33 by crc32 of the 64-bit product: k = x^(8*len - 33)
+    static const uint32_t K1 = xPowModP(8*StreamLen - 33);
+    static const uint32_t K2 = xPowModP(2*8*StreamLen - 33);
+    const uint32_t k = (len == StreamLen) ? K1 : (len == 2*StreamLen) ? K2 : xPowModP(8*static_cast<uint64_t>(len) - 33);
+    const __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(static_cast<int>(crc)),_mm_cvtsi32_si128(static_cast<int>(k)),0);
+    return static_cast<uint32_t>(_mm_crc32_u64(0,static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+    #else
+    static const uint32_t K1 = xPowModP(8*StreamLen);
+    static const uint32_t K2 = xPowModP(2*8*StreamLen);
+    const uint32_t k = (len == StreamLen) ? K1 : (len == 2*StreamLen) ? K2 : xPowModP(8*static_cast<uint64_t>(len));
+    return multModP(k,crc);
+    #endif
+}
+
+//-----------------------------------------------------------------------------
+inline const uint32_t* TCrc32c::table()
+{
+    struct TTable
+    {
+        uint32_t val[8][256];
+        TTable()
+        {
+            for(uint32_t n = 0; n < 256; ++n) {
+                uint32_t crc = n;
+                for(int bit = 0; bit < 8; ++bit) {
+                    crc = (crc & 1) ? (crc >> 1) ^ Poly : crc >> 1;
+                }
+                val[0][n] = crc;
+            }
+            for(uint32_t n = 0; n < 256; ++n) {
+                for(int k = 1; k < 8; ++k) {
+                    val[k][n] = (val[k - 1][n] >> 8) ^ val[0][val[k - 1][n] & 0xFF];
+                }
+            }
+        }
+    };
+    static const TTable table;
+    return &table.val[0][0];
+}
+
+//-----------------------------------------------------------------------------
+//  single stream, CRC register in/out (not inverted)
+//-----------------------------------------------------------------------------
+template<bool Copy> uint32_t TCrc32c::processStream(uint32_t crc, uint8_t* dst, const uint8_t* src, size_t len)
+{
+    #if defined(ENA_SIMD_SSE42)
+    uint64_t crc64 = crc;
+    for(; len >= 8; len -= 8, src += 8, dst += Copy ? 8 : 0) {
+        uint64_t val;
+        std::memcpy(&val,src,sizeof(val));
+        crc64 = _mm_crc32_u64(crc64,val);
+        if(Copy) {
+            std::memcpy(dst,&val,sizeof(val));
+        }
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for(; len; --len, ++src, dst += Copy ? 1 : 0) {
+        crc = _mm_crc32_u8(crc,*src);
+        if(Copy) {
+            *dst = *src;
+        }
+    }
+    #else
+    const uint32_t* t = table();
+    for(; len >= 8; len -= 8, src += 8, dst += Copy ? 8 : 0) {
+        uint32_t lo, hi;
+        std::memcpy(&lo,src,sizeof(lo));
+        std::memcpy(&hi,src + 4,sizeof(hi));
+        if(Copy) {
+            std::memcpy(dst,src,8);
+        }
+        lo ^= crc;
+        crc = t[7*256 + (lo & 0xFF)] ^ t[6*256 + ((lo >> 8) & 0xFF)] ^ t[5*256 + ((lo >> 16) & 0xFF)] ^ t[4*256 + (lo >> 24)] ^
+              t[3*256 + (hi & 0xFF)] ^ t[2*256 + ((hi >> 8) & 0xFF)] ^ t[1*256 + ((hi >> 16) & 0xFF)] ^ t[0*256 + (hi >> 24)];
+    }
+    for(; len; --len, ++src, dst += Copy ? 1 : 0) {
+        crc = (crc >> 8) ^ t[(crc ^ *src) & 0xFF];
+        if(Copy) {
+            *dst = *src;
+        }
+    }
+    #endif
+    return crc;
+}
+
+//-----------------------------------------------------------------------------
+template<bool Copy> uint32_t TCrc32c::process(uint32_t crc, uint8_t* dst, const uint8_t* src, size_t len)
+{
+    #if defined(ENA_SIMD_SSE42)
+    //--- 3 interleaved streams: crc = crcA*x^(2*StreamLen) + crcB*x^StreamLen + crcC
+    for(; len >= 3*StreamLen; len -= 3*StreamLen, src += 3*StreamLen, dst += Copy ? 3*StreamLen : 0) {
+        uint64_t crcA = crc;
+        uint64_t crcB = 0;
+        uint64_t crcC = 0;
+        const uint8_t* srcA = src;
+        const uint8_t* srcB = src + StreamLen;
+        const uint8_t* srcC = src + 2*StreamLen;
+        for(size_t offset = 0; offset < StreamLen; offset += 8) {
+            uint64_t a, b, c;
+            std::memcpy(&a,srcA + offset,sizeof(a));
+            std::memcpy(&b,srcB + offset,sizeof(b));
+            std::memcpy(&c,srcC + offset,sizeof(c));
+            crcA = _mm_crc32_u64(crcA,a);
+            crcB = _mm_crc32_u64(crcB,b);
+            crcC = _mm_crc32_u64(crcC,c);
+            if(Copy) {
+                std::memcpy(dst + offset,&a,sizeof(a));
+                std::memcpy(dst + StreamLen + offset,&b,sizeof(b));
+                std::memcpy(dst + 2*StreamLen + offset,&c,sizeof(c));
+            }
+        }
+        crc = shift(static_cast<uint32_t>(crcA),2*StreamLen) ^ shift(static_cast<uint32_t>(crcB),StreamLen) ^ static_cast<uint32_t>(crcC);
+    }
+    #endif
+    return processStream<Copy>(crc,dst,src,len);
+}
+
+#endif // CRC32C_H
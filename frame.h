@@ -2,24 +2,31 @@
 #define FRAME_H
 
 #include <cstdint>
+#include <cstddef>
 
 #include "msg.h"
 #include "rawbuf.h"
+#include "framehash.h"
+#include "crc32c.h"
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
+//-----------------------------------------------------------------------------
+//  stream length is 64-bit: pixel buffers of stitched/stacked frames exceed
+//  4 GB; single-transfer formats with 32-bit length fields check the
+//  length themselves (see serializeFrame(), TFrameChunkWriter)
 //-----------------------------------------------------------------------------
 class TSerializer
 {
     public:
-        TSerializer(void* streamBuf, uint32_t maxLen) : MaxLen(maxLen), mStream(streamBuf), mStreamLen(0), mBufOverrun(false) {}
+        TSerializer(void* streamBuf, uint64_t maxLen) : MaxLen(maxLen), mStream(streamBuf), mStreamLen(0), mBufOverrun(false) {}
         bool isOk() const { return !mBufOverrun; }
-        uint32_t streamLen() const { return isOk() ? mStreamLen : 0; }
+        uint64_t streamLen() const { return isOk() ? mStreamLen : 0; }
         void* streamPtr() const { return isOk() ? mStream : 0; }
 
         //---
-        template<typename T> uint32_t write(T var)
+        template<typename T> uint64_t write(T var)
         {
             //---
             if(!isOk()) {
@@ -27,7 +34,7 @@ class TSerializer
             }
 
             //---
-            if((mStreamLen + sizeof(T)) > MaxLen) {
+            if(sizeof(T) > MaxLen - mStreamLen) {
                 mBufOverrun = true;
                 return 0;
             }
@@ -39,7 +46,7 @@ class TSerializer
         }
 
         //---
-        template<typename T> uint32_t write(T* array, unsigned arrayLen)
+        template<typename T> uint64_t write(T* array, size_t arrayLen)
         {
             //---
             if(!isOk()) {
@@ -47,8 +54,8 @@ class TSerializer
             }
 
             //---
-            const unsigned ArrayByteLen = sizeof(T)*arrayLen;
-            if((mStreamLen + ArrayByteLen) > MaxLen) {
+            const uint64_t ArrayByteLen = static_cast<uint64_t>(sizeof(T))*arrayLen;
+            if(ArrayByteLen > MaxLen - mStreamLen) {
                 mBufOverrun = true;
                 return 0;
             }
@@ -61,13 +68,114 @@ class TSerializer
             return mStreamLen;
         }
 
+        //--- write(array,arrayLen) with CRC32C of the data calculated while copying
+        template<typename T> uint64_t writeCrc32c(T* array, size_t arrayLen, uint32_t& crc)
+        {
+            //---
+            if(!isOk()) {
+                return 0;
+            }
+
+            //---
+            const uint64_t ArrayByteLen = static_cast<uint64_t>(sizeof(T))*arrayLen;
+            if(ArrayByteLen > MaxLen - mStreamLen) {
+                mBufOverrun = true;
+                return 0;
+            }
+
+            crc = TCrc32c::copy(mStream,array,ArrayByteLen,crc);
+            mStreamLen += ArrayByteLen;
+            mStream = static_cast<uint8_t*>(mStream) + ArrayByteLen;
+            return mStreamLen;
+        }
+
     private:
-        const uint32_t MaxLen;
+        const uint64_t MaxLen;
         void*          mStream;
-        uint32_t       mStreamLen;
+        uint64_t       mStreamLen;
         bool           mBufOverrun;
 };
 
+//-----------------------------------------------------------------------------
+//  TSerializer counterpart: every read is bounded by the stream length, the
+//  first failed read sets error state and makes next reads fail. Typed reads
+//  are made by memcpy, so the stream may be unaligned; POD structs (see
+//  TFrameSerialHeader) are read by one call.
+//
+//  check() of the whole expected length up front makes next reads of a
+//  fixed layout free of further failures
+//-----------------------------------------------------------------------------
+class TDeserializer
+{
+    public:
+        TDeserializer(const void* stream, uint64_t len) : mStream(static_cast<const uint8_t*>(stream)), mLen(len), mPos(0), mBufUnderrun(false) {}
+        bool isOk() const { return !mBufUnderrun; }
+        uint64_t pos() const { return mPos; }
+        uint64_t remaining() const { return isOk() ? mLen - mPos : 0; }
+        const uint8_t* streamPtr() const { return isOk() ? mStream + mPos : 0; }
+
+        //---
+        bool check(uint64_t len)
+        {
+            if(!isOk() || (len > mLen - mPos)) {
+                mBufUnderrun = true;
+            }
+            return isOk();
+        }
+
+        //---
+        template<typename T> bool read(T& var)
+        {
+            if(!check(sizeof(T))) {
+                return false;
+            }
+            std::memcpy(&var,mStream + mPos,sizeof(T));
+            mPos += sizeof(T);
+            return true;
+        }
+
+        //---
+        template<typename T> bool read(T* array, size_t arrayLen)
+        {
+            const uint64_t ArrayByteLen = static_cast<uint64_t>(sizeof(T))*arrayLen;
+            if(!check(ArrayByteLen)) {
+                return false;
+            }
+            std::memcpy(array,mStream + mPos,ArrayByteLen);
+            mPos += ArrayByteLen;
+            return true;
+        }
+
+        //--- read(array,arrayLen) with CRC32C of the data calculated while copying
+        template<typename T> bool readCrc32c(T* array, size_t arrayLen, uint32_t& crc)
+        {
+            const uint64_t ArrayByteLen = static_cast<uint64_t>(sizeof(T))*arrayLen;
+            if(!check(ArrayByteLen)) {
+                return false;
+            }
+            crc = TCrc32c::copy(array,mStream + mPos,ArrayByteLen,crc);
+            mPos += ArrayByteLen;
+            return true;
+        }
+
+        //--- zero-copy access: pointer to 'len' bytes of the stream
+        const uint8_t* skip(uint64_t len)
+        {
+            if(!check(len)) {
+                return 0;
+            }
+            const uint8_t* ptr = mStream + mPos;
+            mPos += len;
+            return ptr;
+        }
+
+    private:
+        const uint8_t* mStream;
+        const uint64_t mLen;
+        uint64_t       mPos;
+        bool           mBufUnderrun;
+};
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 class TMetaInfo
@@ -87,34 +195,49 @@ class TMetaInfo
         uint32_t metaAppendInfoByteSize() const { return mAppendInfoSize*metaElemSize(); }
         const void* getMetaInfoBuf() const { return mMetaBuf; }
 
+        //--- serialized metainfo: THeader, mMetaBuf
+        struct THeader
+        {
+            uint32_t metaBufSize;                                   // [offset:  0] MetaBufSize() check
+            uint32_t metaElemSize;                                  // [offset:  1] metaElemSize() check
+            uint32_t metaInfoByteSize;                              // [offset:  2]
+            uint32_t metaAppendInfoByteSize;                        // [offset:  3]
+        };
+        static uint32_t serialSize() { return sizeof(THeader) + MetaBufByteSize; }
+
         //---
         bool serialize(TSerializer& serializer)
         {
             if(!serializer.isOk()) {
                 return false;
             }
-            serializer.write(MetaBufSize());
-            serializer.write(metaElemSize());
-            serializer.write(metaInfoByteSize());
-            serializer.write(metaAppendInfoByteSize());
+            const THeader header = { MetaBufSize(), metaElemSize(), metaInfoByteSize(), metaAppendInfoByteSize() };
+            serializer.write(header);
             serializer.write(mMetaBuf,MetaBufSize());
             return serializer.isOk();
         }
 
-        //---
-        static void* deserialize(void* src, TMetaInfo& obj)
+        //--- sizes are checked, so the stream may come from untrusted source
+        bool deserialize(TDeserializer& deserializer)
         {
-            uint32_t* srcPtr32 = static_cast<uint32_t*>(src);
-            if(obj.MetaBufSize() != *srcPtr32++)                    // [offset:  0] MetaBufSize() check
-                return 0;
-            if(obj.metaElemSize() != *srcPtr32++)                   // [offset:  1] metaElemSize() check
-                return 0;
-            obj.mWriteIdx       = (*srcPtr32++)/obj.metaElemSize(); // [offset:  2] metaInfoByteSize()
-            obj.mAppendInfoSize = (*srcPtr32++)/obj.metaElemSize(); // [offset:  3] metaAppendInfoByteSize()
+            THeader header;
+            if(!deserializer.read(header) || (header.metaBufSize != MetaBufSize()) || (header.metaElemSize != metaElemSize()) ||
+               (header.metaInfoByteSize > MetaBufSize()) || (header.metaAppendInfoByteSize > MetaBufSize())) {
+                return false;
+            }
+            if(!deserializer.read(mMetaBuf,MetaBufSize())) {
+                return false;
+            }
+            mWriteIdx       = header.metaInfoByteSize/metaElemSize();
+            mAppendInfoSize = header.metaAppendInfoByteSize/metaElemSize();
+            return true;
+        }
 
-            std::memcpy(obj.mMetaBuf,srcPtr32,obj.MetaBufSize());   // [offset:  4] mMetaBuf
-            srcPtr32 += (obj.MetaBufSize()/sizeof(uint32_t));
-            return srcPtr32;
+        //--- unbounded source: the caller guarantees serialSize() bytes
+        static void* deserialize(void* src, TMetaInfo& obj)
+        {
+            TDeserializer deserializer(src,serialSize());
+            return obj.deserialize(deserializer) ? static_cast<uint8_t*>(src) + serialSize() : 0;
         }
 
         //---
@@ -197,8 +320,9 @@ class TBaseFrame
 		virtual int width() const = 0;
 		virtual int height() const = 0;
         virtual int pixelSize() const = 0;
-        virtual int size() const { return width()*height(); }
-        virtual int byteSize() const { return size()*pixelSize(); }
+        virtual int64_t size() const { return static_cast<int64_t>(width())*height(); }
+        virtual int64_t byteSize() const { return size()*pixelSize(); }
+        virtual int bytesPerLine() const = 0;
         virtual int colorCount() const = 0;
 		virtual bool resizeImg(int width, int height) = 0;
 
@@ -213,9 +337,20 @@ class TBaseFrame
         virtual TMetaInfo& metaInfo() = 0;
         template <typename T> T& castMetaInfo() { return static_cast<T&>(metaInfo());}
 
+        //--- content hash cache (see frameHash()): it is invalidated by any access to pixels or metainfo
+        bool hashValid() const { return mHashValid; }
+        uint64_t cachedHash() const { return mHash; }
+        void setHash(uint64_t hash) { mHash = hash; mHashValid = true; }
+        void invalidateHash() { mHashValid = false; }
+
 	protected:
+        TBaseFrame() : mHash(0), mHashValid(false) {}
 		virtual ~TBaseFrame() {}
 		virtual void* getPixelBuf(int) = 0;
+
+    private:
+        uint64_t mHash;
+        bool     mHashValid;
 };
 
 //-----------------------------------------------------------------------------
@@ -233,11 +368,12 @@ template <typename TFrameImpl> class TFrame : public TBaseFrame
 		virtual int height() const { return mFrameImpl->height(); }
         virtual int pixelSize() const { return mFrameImpl->pixelSize(); }
         virtual int colorCount() const { return mFrameImpl->colorCount(); }
-		virtual bool resizeImg(int width, int height) {  return mFrameImpl->resizeImg(width, height); }
+        virtual int bytesPerLine() const { return mFrameImpl->bytesPerLine(); }
+		virtual bool resizeImg(int width, int height) { invalidateHash(); return mFrameImpl->resizeImg(width, height); }
 
-		virtual QImage* getImage() { return mFrameImpl->getImage(); }
-		virtual void* getPixelBuf(int pixelSize) { return mFrameImpl->getPixelBuf(pixelSize); }
-        virtual void* getPixelBuf() { return mFrameImpl->getPixelBuf(sizeof(TPixel)); }
+		virtual QImage* getImage() { invalidateHash(); return mFrameImpl->getImage(); }
+		virtual void* getPixelBuf(int pixelSize) { invalidateHash(); return mFrameImpl->getPixelBuf(pixelSize); }
+        virtual void* getPixelBuf() { invalidateHash(); return mFrameImpl->getPixelBuf(sizeof(TPixel)); }
 
         //---
 		virtual TBaseFrame& operator=(const TBaseFrame& baseRight)
@@ -247,6 +383,11 @@ template <typename TFrameImpl> class TFrame : public TBaseFrame
 				return *this;
 			*mFrameImpl = *derivedRight.mFrameImpl;
             mMetaInfo   = derivedRight.mMetaInfo;
+            if(derivedRight.hashValid()) {
+                setHash(derivedRight.cachedHash());
+            } else {
+                invalidateHash();
+            }
             // not need to use TBaseFrame::operator=(baseRight);
             //qDebug() << "TBaseFrame& TFrame<TFrameImpl>::operator=";
 			return *this;
@@ -262,7 +403,7 @@ template <typename TFrameImpl> class TFrame : public TBaseFrame
         }
 
         //---
-        virtual TMetaInfo& metaInfo() { return mMetaInfo; }
+        virtual TMetaInfo& metaInfo() { invalidateHash(); return mMetaInfo; }
 
 	protected:
 		virtual ~TFrame() { delete mFrameImpl; /* qDebug() << "~Frame"; */ }
@@ -287,7 +428,7 @@ template <typename T, typename T2 = uint16_t> class TRawFrameImpl : public TRawB
 		class TCreator : public TRawBuf::TCreator<TPixel>
 		{
 			public:
-                TCreator(int width, int height) : TRawBuf::TCreator<T>(width*height), mWidth(width), mHeight(height)  {}
+                TCreator(int width, int height) : TRawBuf::TCreator<T>(static_cast<size_t>(width)*height), mWidth(width), mHeight(height)  {}
 				TFrame<TRawFrameImpl>* createMsg() { return new TFrame<TRawFrameImpl>(new TRawFrameImpl(mWidth, mHeight));	}
 
 			private:
@@ -299,18 +440,19 @@ template <typename T, typename T2 = uint16_t> class TRawFrameImpl : public TRawB
 		int height() const { return mHeight; }
         int pixelSize() const { return sizeof(TPixel); }
         int colorCount() const { return 0; }
+        int bytesPerLine() const { return mWidth*sizeof(TPixel); }
 		QImage* getImage() { return 0; }
 		bool resizeImg(int width, int height)
 		{
 			mWidth = width;
 			mHeight = height;
-			TRawBuf::resizeBuf<TPixel>(mWidth*mHeight);
+			TRawBuf::resizeBuf<TPixel>(static_cast<size_t>(mWidth)*mHeight);
 			return true;
 		}
 		void* getPixelBuf(int pixelSize) { return (pixelSize == sizeof(TPixel)) ? TRawBuf::getDataBuf<TPixel>() : 0; }
 
 		//---
-		TRawFrameImpl(int width, int height) : TRawBuf(width*height,sizeof(TPixel)), mWidth(width), mHeight(height)  {  /* qDebug() << "TRawFrameImpl"; */  }
+		TRawFrameImpl(int width, int height) : TRawBuf(static_cast<size_t>(width)*height,sizeof(TPixel)), mWidth(width), mHeight(height)  {  /* qDebug() << "TRawFrameImpl"; */  }
 		~TRawFrameImpl() { /* qDebug() << "~TRawFrameImpl"; */ }
 		TRawFrameImpl<T>& operator=(const TRawFrameImpl<T>& right)
 		{
@@ -363,95 +505,331 @@ template<int Width, int Height, int Id> class RawFrame : public TRawFrame
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-template<typename T> uint32_t serializeFrame(TRawFramePtr framePtr, uint8_t* dst, uint32_t maxLen)
+//  serialized frame: TFrameSerialHeader, payload: metainfo (TMetaInfo::serialize()), pixels
+//
+//  FrameMagic2 header is protected by header CRC32C, payload - by payload
+//  CRC32C; FrameMagic (0) header without checksums (TFrameSerialHeaderV1) is
+//  accepted by deserializeFrame() for recorded files
+//-----------------------------------------------------------------------------
+const uint32_t FrameMagic       = 0;
+const uint32_t FrameMagic2      = 0x324D5246;  // 'FRM2'
+const uint32_t FrameVersion     = 2;
+const uint32_t FrameHeaderWords = 17;
+const uint32_t FrameHashFlag    = 0x01;
+const uint32_t FrameChunkFlag   = 0x02;         // header of chunked stream, see TFrameChunkWriter
+
+//-----------------------------------------------------------------------------
+struct TFrameSerialHeader
 {
-    T* frame;
+    uint32_t magic;             // [offset:    0] FrameMagic2
+    uint32_t versionSize;       // [offset:    1] version (hi 16 bits), header size in words (lo 16 bits)
+    uint32_t flags;             // [offset:    2]
+    uint32_t msgClassId;        // [offset:    3]
+    uint32_t netSrcHi;          // [offset:    4]
+    uint32_t netSrcLo;          // [offset:    5]
+    uint32_t netDstHi;          // [offset:    6]
+    uint32_t netDstLo;          // [offset:    7]
+    uint32_t msgId;             // [offset:    8] usually used as host frame num
+    uint32_t pixelSize;         // [offset:    9]
+    uint32_t height;            // [offset:   10]
+    uint32_t width;             // [offset:   11]
+    uint32_t hashLo;            // [offset:   12] frameHash(), FrameHashFlag
+    uint32_t hashHi;            // [offset:   13]
+    uint32_t payloadLen;        // [offset:   14] bytes, 0 for FrameChunkFlag
+    uint32_t payloadCrc;        // [offset:   15] CRC32C, 0 for FrameChunkFlag
+    uint32_t headerCrc;         // [offset:   16] CRC32C of the words above
+
+    uint32_t calcHeaderCrc() const { return TCrc32c::calc(this,offsetof(TFrameSerialHeader,headerCrc)); }
+};
 
-    if(framePtr && (frame = checkMsg<T>(framePtr))) {
-        TSerializer serializer(dst,maxLen);
+//-----------------------------------------------------------------------------
+//  FrameMagic: magic, msgClassId ... width
+//-----------------------------------------------------------------------------
+struct TFrameSerialHeaderV1
+{
+    uint32_t msgClassId;        // [offset:    1] existed in serialized frame but not used
+    uint32_t netSrcHi;          // [offset:    2]
+    uint32_t netSrcLo;          // [offset:    3]
+    uint32_t netDstHi;          // [offset:    4]
+    uint32_t netDstLo;          // [offset:    5]
+    uint32_t msgId;             // [offset:    6]
+    uint32_t pixelSize;         // [offset:    7]
+    uint32_t height;            // [offset:    8]
+    uint32_t width;             // [offset:    9]
+};
 
-        //--- test data
-        serializer.write(static_cast<uint32_t>(0));                      // [offset:    0] 'magic number'
+static_assert(sizeof(TFrameSerialHeader) == FrameHeaderWords*sizeof(uint32_t),"TFrameSerialHeader layout");
 
-        //--- frame container data
-        serializer.write(static_cast<uint32_t>(framePtr->msgClassId())); // [offset:    1]
-        CfgDefs::TNetAddr netSrc = framePtr->netSrc();
-        serializer.write(static_cast<uint32_t>(netSrc >> 32));           // [offset:    2]
-        serializer.write(static_cast<uint32_t>(netSrc));                 // [offset:    3]
-        CfgDefs::TNetAddr netDst = framePtr->netDst();
-        serializer.write(static_cast<uint32_t>(netDst >> 32));           // [offset:    4]
-        serializer.write(static_cast<uint32_t>(netDst));                 // [offset:    5]
-        serializer.write(static_cast<uint32_t>(framePtr->msgId()));      // [offset:    6] usually used as host frame num
+//-----------------------------------------------------------------------------
+//  deserializeFrame() results, counters are not atomic: one instance per thread
+//-----------------------------------------------------------------------------
+struct TFrameSerialStat
+{
+    TFrameSerialStat() : frames(0), formatErrors(0), sizeErrors(0), headerCrcErrors(0), payloadCrcErrors(0) {}
 
-        //--- frame data
-        serializer.write(static_cast<uint32_t>(frame->pixelSize()));     // [offset:    7]
-        serializer.write(static_cast<uint32_t>(frame->height()));        // [offset:    8]
-        serializer.write(static_cast<uint32_t>(frame->width()));         // [offset:    9]
+    uint64_t frames;            // deserialized successfully
+    uint64_t formatErrors;      // magic, version, frame type, metainfo format
+    uint64_t sizeErrors;        // truncated data, frame size mismatch
+    uint64_t headerCrcErrors;
+    uint64_t payloadCrcErrors;
+};
 
-        //--- frame metainfo
-        frame->metaInfo().serialize(serializer);                         // [offset:   10]
+//-----------------------------------------------------------------------------
+//  hash of pixels (packed lines), frame size and metainfo, cached in the frame
+//-----------------------------------------------------------------------------
+inline uint64_t frameHash(TBaseFrame* frame)
+{
+    if(frame->hashValid()) {
+        return frame->cachedHash();
+    }
 
-        //--- frame pixel buf
-        serializer.write(static_cast<uint8_t*>(frame->getPixelBuf()),frame->byteSize());
-        return serializer.streamLen();
-	} else {
+    THash64 hasher;
+    TMetaInfo& metaInfo = frame->metaInfo();
+    const uint32_t header[4] = { static_cast<uint32_t>(frame->width()), static_cast<uint32_t>(frame->height()),
+                                 static_cast<uint32_t>(frame->pixelSize()), metaInfo.metaElemSize() };
+    hasher.update(header,sizeof(header));
+
+    const int lineLen = frame->width()*frame->pixelSize();
+    const uint8_t* line = static_cast<const uint8_t*>(frame->getPixelBuf());
+    if(frame->bytesPerLine() == lineLen) {
+        hasher.update(line,frame->byteSize());
+    } else {
+        for(int row = 0; row < frame->height(); ++row, line += frame->bytesPerLine()) {
+            hasher.update(line,lineLen);
+        }
+    }
+    hasher.update(metaInfo.getMetaInfoBuf(),metaInfo.metaInfoByteSize());
+
+    const uint64_t hash = hasher.digest();
+    frame->setHash(hash);
+    return hash;
+}
+
+//-----------------------------------------------------------------------------
+//  O(1) for frames with cached hash, e.g. deserialized from data with hash.
+//  The cache is invalidated by the frame accessors only: no writes to the
+//  pixels or metainfo may happen after the last accessor call (through the
+//  pointers taken before, e.g. checkFrameView(), TFrameRoi, TTileExec tiles,
+//  driver buffers), otherwise the result is stale; operator== is exact
+//-----------------------------------------------------------------------------
+inline bool frameHashEqual(TBaseFrame* frame1, TBaseFrame* frame2)
+{
+    return frameHash(frame1) == frameHash(frame2);
+}
+
+//-----------------------------------------------------------------------------
+//  upper bound of serializeFrame() length; frames above 4 GB are sent by
+//  TFrameChunkWriter
+//-----------------------------------------------------------------------------
+inline uint64_t serialFrameMaxSize(TBaseFrame* frame)
+{
+    return sizeof(TFrameSerialHeader) + TMetaInfo::serialSize() + frame->byteSize();
+}
+
+//-----------------------------------------------------------------------------
+//  header without CRC words, see serialFrameFinish()
+//-----------------------------------------------------------------------------
+inline void serialFrameHeader(TSerializer& serializer, const TRawFramePtr& framePtr, int pixelSize, int width, int height, bool enaHash, uint64_t hash)
+{
+    const CfgDefs::TNetAddr netSrc = framePtr->netSrc();
+    const CfgDefs::TNetAddr netDst = framePtr->netDst();
+    const TFrameSerialHeader header = {
+        FrameMagic2,
+        (FrameVersion << 16) | FrameHeaderWords,
+        enaHash ? FrameHashFlag : 0u,
+        static_cast<uint32_t>(framePtr->msgClassId()),
+        static_cast<uint32_t>(netSrc >> 32),
+        static_cast<uint32_t>(netSrc),
+        static_cast<uint32_t>(netDst >> 32),
+        static_cast<uint32_t>(netDst),
+        static_cast<uint32_t>(framePtr->msgId()),
+        static_cast<uint32_t>(pixelSize),
+        static_cast<uint32_t>(height),
+        static_cast<uint32_t>(width),
+        static_cast<uint32_t>(hash),
+        static_cast<uint32_t>(hash >> 32),
+        0, 0, 0
+    };
+    serializer.write(header);
+}
+
+//-----------------------------------------------------------------------------
+inline uint32_t serialFrameFinish(uint8_t* dst, const TSerializer& serializer, uint32_t payloadCrc)
+{
+    if(!serializer.isOk() || (serializer.streamLen() > 0xFFFFFFFF)) {
         return 0;
-	}
+    }
+    TFrameSerialHeader header;
+    std::memcpy(&header,dst,sizeof(header));
+    header.payloadLen = static_cast<uint32_t>(serializer.streamLen() - sizeof(header));
+    header.payloadCrc = payloadCrc;
+    header.headerCrc  = header.calcHeaderCrc();
+    std::memcpy(dst,&header,sizeof(header));
+    return serializer.streamLen();
 }
 
 //-----------------------------------------------------------------------------
-template<typename T> bool deserializeFrame(TRawFramePtr framePtr, void* src, uint32_t srcLen)
+//  pixel geometry of serialized frame without deserialization (any header
+//  version), returns offset of pixels or 0 for bad data
+//-----------------------------------------------------------------------------
+inline uint32_t serialFrameGeometry(const void* src, uint32_t srcLen, int& width, int& height, int& pixelSize)
+{
+    TDeserializer deserializer(src,srcLen);
+    uint32_t magic;
+    if(!deserializer.read(magic)) {
+        return 0;
+    }
+
+    if(magic == FrameMagic2) {
+        TFrameSerialHeader header;
+        if(!TDeserializer(src,srcLen).read(header)) {
+            return 0;
+        }
+        pixelSize = header.pixelSize;
+        height    = header.height;
+        width     = header.width;
+        deserializer.skip(sizeof(header) - sizeof(magic));
+    } else {
+        TFrameSerialHeaderV1 header;
+        if((magic != FrameMagic) || !deserializer.read(header)) {
+            return 0;
+        }
+        pixelSize = header.pixelSize;
+        height    = header.height;
+        width     = header.width;
+    }
+
+    const uint32_t offset = static_cast<uint32_t>(deserializer.pos()) + TMetaInfo::serialSize();
+    return (deserializer.isOk() && (static_cast<uint64_t>(width)*height*pixelSize + offset == srcLen)) ? offset : 0;
+}
+
+//-----------------------------------------------------------------------------
+template<typename T> uint32_t serializeFrame(TRawFramePtr framePtr, uint8_t* dst, uint32_t maxLen, bool enaHash = false)
 {
     T* frame;
+
     if(framePtr && (frame = checkMsg<T>(framePtr))) {
-        uint32_t* srcPtr32 = static_cast<uint32_t*>(src);
+        TSerializer serializer(dst,maxLen);
 
-        //---
-        if(*srcPtr32++ != 0)                   // [offset:    0] 'magic number' check
-            return false;
+        //--- frame container data, frame data
+        const uint64_t hash = enaHash ? frameHash(frame) : 0;
+        serialFrameHeader(serializer,framePtr,frame->pixelSize(),frame->width(),frame->height(),enaHash,hash);
 
-        //--- frame container data
-        ++srcPtr32;                            // [offset:    1] msgClassId - existed in serialized frame but not used
+        //--- frame metainfo
+        uint8_t* metaInfo = static_cast<uint8_t*>(serializer.streamPtr());
+        frame->metaInfo().serialize(serializer);
+        uint32_t crc = serializer.isOk() ? TCrc32c::calc(metaInfo,static_cast<uint8_t*>(serializer.streamPtr()) - metaInfo) : 0;
+
+        //--- frame pixel buf (lines are packed when frame lines are padded), CRC is calculated while copying
+        const int lineLen = frame->width()*frame->pixelSize();
+        if(frame->bytesPerLine() == lineLen) {
+            serializer.writeCrc32c(static_cast<uint8_t*>(frame->getPixelBuf()),frame->byteSize(),crc);
+        } else {
+            uint8_t* line = static_cast<uint8_t*>(frame->getPixelBuf());
+            for(int row = 0; row < frame->height(); ++row, line += frame->bytesPerLine()) {
+                serializer.writeCrc32c(line,lineLen,crc);
+            }
+        }
+        if(enaHash) {
+            frame->setHash(hash);       // contents were accessed for reading only
+        }
+        return serialFrameFinish(dst,serializer,crc);
+	} else {
+        return 0;
+	}
+}
 
-        //---
-        uint32_t netSrcHi = *srcPtr32++;       // [offset:    2] netSrc (hi)
-        uint32_t netSrcLo = *srcPtr32++;       // [offset:    3] netSrc (lo)
-        CfgDefs::TNetAddr netSrc = (static_cast<CfgDefs::TNetAddr>(netSrcHi) << 32) | netSrcLo;
-        framePtr->setNetSrc(netSrc);
+//-----------------------------------------------------------------------------
+//  the source may be untrusted: all reads are bounded by 'srcLen', the frame
+//  is not modified until header and length are validated; 'stat' (optional)
+//  receives result of the call
+//-----------------------------------------------------------------------------
+template<typename T> bool deserializeFrame(TRawFramePtr framePtr, void* src, uint32_t srcLen, TFrameSerialStat* stat = 0)
+{
+    auto fail = [stat](uint64_t TFrameSerialStat::* counter) { if(stat) ++(stat->*counter); return false; };
 
-        //---
-        uint32_t netDstHi = *srcPtr32++;       // [offset:    4] netDst (hi)
-        uint32_t netDstLo = *srcPtr32++;       // [offset:    5] netDst (lo)
-        CfgDefs::TNetAddr netDst = (static_cast<CfgDefs::TNetAddr>(netDstHi) << 32) | netDstLo;
-        framePtr->setNetDst(netDst);
+    T* frame;
+    if(!framePtr || !(frame = checkMsg<T>(framePtr))) {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
 
-        //---
-        framePtr->setMsgId(*srcPtr32++);       // [offset:    6] msgId      - usually used as host frame num
-        //--- msgPoolId - not existed in serialized frame and not used
+    TDeserializer deserializer(src,srcLen);
+    const uint64_t payloadLen = TMetaInfo::serialSize() + frame->byteSize();
+    uint32_t magic;
+    if(!deserializer.read(magic)) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
 
-        //--- frame compatibility check
-        if(static_cast<uint32_t>(frame->pixelSize()) != *srcPtr32++)  // [offset:    7] pixelSize
-            return false;
-        if(static_cast<uint32_t>(frame->height()) != *srcPtr32++)     // [offset:    8] frameHeight
-            return false;
-        if(static_cast<uint32_t>(frame->width()) != *srcPtr32++)      // [offset:    9] frameWidth
-            return false;
+    //--- header
+    TFrameSerialHeader header;
+    bool enaHash = false;
+    if(magic == FrameMagic2) {
+        if(!TDeserializer(src,srcLen).read(header)) {
+            return fail(&TFrameSerialStat::sizeErrors);
+        }
+        if(header.versionSize != ((FrameVersion << 16) | FrameHeaderWords)) {
+            return fail(&TFrameSerialStat::formatErrors);
+        }
+        if(header.calcHeaderCrc() != header.headerCrc) {
+            return fail(&TFrameSerialStat::headerCrcErrors);
+        }
+        deserializer.skip(sizeof(header) - sizeof(magic));
+        enaHash = (header.flags & FrameHashFlag) != 0;
+    } else if(magic == FrameMagic) {
+        TFrameSerialHeaderV1 headerV1;
+        if(!deserializer.read(headerV1)) {
+            return fail(&TFrameSerialStat::sizeErrors);
+        }
+        header.netSrcHi   = headerV1.netSrcHi;
+        header.netSrcLo   = headerV1.netSrcLo;
+        header.netDstHi   = headerV1.netDstHi;
+        header.netDstLo   = headerV1.netDstLo;
+        header.msgId      = headerV1.msgId;
+        header.pixelSize  = headerV1.pixelSize;
+        header.height     = headerV1.height;
+        header.width      = headerV1.width;
+        header.payloadLen = static_cast<uint32_t>(payloadLen);
+    } else {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
 
-        //--- frame metainfo
-        void* pixelBuf = TMetaInfo::deserialize(srcPtr32, frame->metaInfo());
-        if(!pixelBuf)
-            return false;
+    //--- frame compatibility and length check: the rest is read without failures
+    if((static_cast<uint32_t>(frame->pixelSize()) != header.pixelSize) || (static_cast<uint32_t>(frame->height()) != header.height) ||
+       (static_cast<uint32_t>(frame->width()) != header.width) || (header.payloadLen != payloadLen) || (deserializer.remaining() != payloadLen)) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
 
-        //--- frame data
-        std::memcpy(frame->getPixelBuf(),pixelBuf,frame->byteSize());
+    //--- payload: frame metainfo
+    uint32_t crc = TCrc32c::calc(deserializer.streamPtr(),TMetaInfo::serialSize());
+    if(!frame->metaInfo().deserialize(deserializer)) {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
 
-        //--- size check (optional)
-        if(((static_cast<uint8_t*>(pixelBuf) - static_cast<uint8_t*>(src)) + static_cast<uint32_t>(frame->byteSize())) != srcLen)
-            return false;
-        return true;
+    //--- payload: frame pixel buf
+    const int lineLen = frame->width()*frame->pixelSize();
+    if(frame->bytesPerLine() == lineLen) {
+        deserializer.readCrc32c(static_cast<uint8_t*>(frame->getPixelBuf()),frame->byteSize(),crc);
     } else {
-        return false;
+        uint8_t* line = static_cast<uint8_t*>(frame->getPixelBuf());
+        for(int row = 0; row < frame->height(); ++row, line += frame->bytesPerLine()) {
+            deserializer.readCrc32c(line,lineLen,crc);
+        }
+    }
+    if((magic == FrameMagic2) && (crc != header.payloadCrc)) {
+        return fail(&TFrameSerialStat::payloadCrcErrors);
+    }
+
+    //--- frame container data
+    framePtr->setNetSrc((static_cast<CfgDefs::TNetAddr>(header.netSrcHi) << 32) | header.netSrcLo);
+    framePtr->setNetDst((static_cast<CfgDefs::TNetAddr>(header.netDstHi) << 32) | header.netDstLo);
+    framePtr->setMsgId(header.msgId);
+    if(enaHash) {
+        frame->setHash((static_cast<uint64_t>(header.hashHi) << 32) | header.hashLo);
+    }
+    if(stat) {
+        ++stat->frames;
     }
+    return true;
 }
 
 #endif // FRAME_H
@@ -0,0 +1,297 @@
+#if !defined(FRAME_ACCUM_H)
+#define FRAME_ACCUM_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "SimdDefs.h"
+#include "framepar.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Temporal accumulation of TRawFrame stream:
+//      Sum     - 32-bit sum of frames, result is saturated to pixel range
+//      Average - 32-bit sum of frames, result is sum/frameNum
+//      Ema     - float exponential moving average: acc += alpha*(pix - acc)
+//      MaxHold - per pixel maximum
+//
+//  accumulation buffer is allocated on the first frame (or after resize),
+//  frames of the stream are not copied
+//-----------------------------------------------------------------------------
+class TFrameAccum
+{
+    public:
+        typedef TRawFrame::TPixel          TPixel;
+        typedef TRawFrame::TMetaDataElem   TMetaDataElem;
+
+        enum TMode
+        {
+            Sum,
+            Average,
+            Ema,
+            MaxHold
+        };
+
+        static const int MaxSumFrames = 0x10000;   // 32-bit sum of 16-bit pixels does not overflow
+
+        explicit TFrameAccum(TMode mode = Average, float emaAlpha = 0.1f) : mMode(mode), mEmaAlpha(emaAlpha), mMaxThreads(0), mWidth(0), mHeight(0), mFrameNum(0), mMsgId(0) {}
+
+        void setMode(TMode mode) { mMode = mode; reset(); }
+        void setEmaAlpha(float emaAlpha) { mEmaAlpha = emaAlpha; }
+        void setMaxThreads(int maxThreads) { mMaxThreads = maxThreads; }
+        void reset() { mFrameNum = 0; }
+
+        TMode mode() const { return mMode; }
+        int width() const { return mWidth; }
+        int height() const { return mHeight; }
+        int frameNum() const { return mFrameNum; }
+        const uint32_t* accumBuf() const { return (mMode != Ema && mFrameNum) ? &mAccum32[0] : 0; }
+        const float* accumBufF() const { return (mMode == Ema && mFrameNum) ? &mAccumF[0] : 0; }
+
+        bool addFrame(TRawFramePtr framePtr);
+        int addFrames(TMsgWrapperPoolQueue& queue, int maxFrames = 0);
+
+        //--- result is written to pooled frame, metainfo and container data are taken from the last frame
+        bool getResult(TRawFramePtr dstPtr) const;
+        template<typename TPool> bool getResult(TPool& pool, TRawFramePtr& dstPtr) const
+        {
+            if(!pool.get(dstPtr)) {
+                return false;
+            }
+            if(getResult(dstPtr)) {
+                return true;
+            }
+            #if !defined(MSG_SELF_RELEASE)
+                TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(dstPtr);
+            #endif
+            dstPtr.reset();
+            return false;
+        }
+
+    private:
+        void addRows(const TPixel* src, size_t beginIdx, size_t endIdx, bool first);
+        void resultRows(TPixel* dst, size_t beginIdx, size_t endIdx) const;
+
+        TMode                         mMode;
+        float                         mEmaAlpha;
+        int                           mMaxThreads;
+        int                           mWidth;
+        int                           mHeight;
+        int                           mFrameNum;
+        std::vector<uint32_t>         mAccum32;
+        std::vector<float>            mAccumF;
+
+        //--- last frame data
+        uint32_t                      mMsgId;
+        CfgDefs::TNetAddr             mNetSrc;
+        CfgDefs::TNetAddr             mNetDst;
+        TMetaInfoImpl<TMetaDataElem>  mMetaInfo;
+};
+
+//-----------------------------------------------------------------------------
+inline void TFrameAccum::addRows(const TPixel* src, size_t beginIdx, size_t endIdx, bool first)
+{
+    size_t idx = beginIdx;
+
+    //---
+    if(mMode == Ema) {
+        float* acc = &mAccumF[0];
+        if(first) {
+            for(; idx < endIdx; ++idx) {
+                acc[idx] = src[idx];
+            }
+            return;
+        }
+
+        const float alpha = mEmaAlpha;
+        #if defined(ENA_SIMD_AVX2)
+        const __m256 vAlpha = _mm256_set1_ps(alpha);
+        for(; idx + 8 <= endIdx; idx += 8) {
+            const __m256 pix = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx))));
+            const __m256 a   = _mm256_loadu_ps(acc + idx);
+            _mm256_storeu_ps(acc + idx,_mm256_add_ps(a,_mm256_mul_ps(vAlpha,_mm256_sub_ps(pix,a))));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            acc[idx] += alpha*(src[idx] - acc[idx]);
+        }
+        return;
+    }
+
+    //---
+    uint32_t* acc = &mAccum32[0];
+    if(first) {
+        for(; idx < endIdx; ++idx) {
+            acc[idx] = src[idx];
+        }
+        return;
+    }
+
+    if(mMode == MaxHold) {
+        #if defined(ENA_SIMD_AVX2)
+        for(; idx + 8 <= endIdx; idx += 8) {
+            const __m256i pix = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + idx),_mm256_max_epu32(pix,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx))));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            acc[idx] = std::max<uint32_t>(acc[idx],src[idx]);
+        }
+    } else {
+        #if defined(ENA_SIMD_AVX2)
+        for(; idx + 8 <= endIdx; idx += 8) {
+            const __m256i pix = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + idx),_mm256_add_epi32(pix,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx))));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            acc[idx] += src[idx];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameAccum::resultRows(TPixel* dst, size_t beginIdx, size_t endIdx) const
+{
+    size_t idx = beginIdx;
+
+    //---
+    if(mMode == Ema) {
+        const float* acc = &mAccumF[0];
+        #if defined(ENA_SIMD_AVX2)
+        for(; idx + 16 <= endIdx; idx += 16) {
+            const __m256i lo = _mm256_cvtps_epi32(_mm256_loadu_ps(acc + idx));
+            const __m256i hi = _mm256_cvtps_epi32(_mm256_loadu_ps(acc + idx + 8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx),_mm256_permute4x64_epi64(_mm256_packus_epi32(lo,hi),0xD8));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            dst[idx] = static_cast<TPixel>(std::min(std::max(std::lrint(acc[idx]),0L),0xFFFFL));
+        }
+        return;
+    }
+
+    //---
+    const uint32_t* acc = &mAccum32[0];
+    if(mMode == Average && mFrameNum > 1) {
+        const float scale = 1.0f/mFrameNum;
+        #if defined(ENA_SIMD_AVX2)
+        const __m256 vScale = _mm256_set1_ps(scale);
+        for(; idx + 16 <= endIdx; idx += 16) {
+            //--- sums are < 2^32, signed conversion is corrected for the sign bit
+            const __m256i sumLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx));
+            const __m256i sumHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx + 8));
+            const __m256  bias  = _mm256_set1_ps(4294967296.0f);
+            __m256 fLo = _mm256_cvtepi32_ps(sumLo);
+            __m256 fHi = _mm256_cvtepi32_ps(sumHi);
+            fLo = _mm256_add_ps(fLo,_mm256_and_ps(_mm256_castsi256_ps(_mm256_srai_epi32(sumLo,31)),bias));
+            fHi = _mm256_add_ps(fHi,_mm256_and_ps(_mm256_castsi256_ps(_mm256_srai_epi32(sumHi,31)),bias));
+            const __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(fLo,vScale));
+            const __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(fHi,vScale));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx),_mm256_permute4x64_epi64(_mm256_packus_epi32(lo,hi),0xD8));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            dst[idx] = static_cast<TPixel>(std::min(std::lrint(static_cast<float>(acc[idx])*scale),0xFFFFL));
+        }
+    } else {
+        #if defined(ENA_SIMD_AVX2)
+        const __m256i maxPix = _mm256_set1_epi32(0xFFFF);
+        for(; idx + 16 <= endIdx; idx += 16) {
+            const __m256i lo = _mm256_min_epu32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx)),maxPix);
+            const __m256i hi = _mm256_min_epu32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + idx + 8)),maxPix);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx),_mm256_permute4x64_epi64(_mm256_packus_epi32(lo,hi),0xD8));
+        }
+        #endif
+        for(; idx < endIdx; ++idx) {
+            dst[idx] = static_cast<TPixel>(std::min<uint32_t>(acc[idx],0xFFFF));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameAccum::addFrame(TRawFramePtr framePtr)
+{
+    TBaseFrame* frame;
+    const TPixel* src;
+    if(!framePtr || !(frame = checkMsg<TBaseFrame>(framePtr)) || !(src = frame->getPixelBuf<TRawFrame>())) {
+        return false;
+    }
+
+    //--- first frame defines accumulator size
+    if(mFrameNum && ((frame->width() != mWidth) || (frame->height() != mHeight))) {
+        return false;
+    }
+    if(mMode != Ema && mFrameNum >= MaxSumFrames) {
+        return false;
+    }
+    if(!mFrameNum) {
+        mWidth  = frame->width();
+        mHeight = frame->height();
+        if(mMode == Ema) {
+            mAccumF.resize(frame->size());
+        } else {
+            mAccum32.resize(frame->size());
+        }
+    }
+
+    const bool first   = (mFrameNum == 0);
+    const int  stripes = TStripeExec::stripeNum(mHeight,mWidth,mMaxThreads);
+    auto stripeFunc = [&](int, int rowBegin, int rowEnd) {
+        addRows(src,static_cast<size_t>(rowBegin)*mWidth,static_cast<size_t>(rowEnd)*mWidth,first);
+    };
+    TStripeExec::run(mHeight,stripes,stripeFunc);
+    ++mFrameNum;
+
+    mMsgId    = framePtr->msgId();
+    mNetSrc   = framePtr->netSrc();
+    mNetDst   = framePtr->netDst();
+    static_cast<TMetaInfo&>(mMetaInfo) = frame->metaInfo();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  takes frames from the queue until it is empty (or maxFrames frames are taken),
+//  frames are released after accumulation
+//-----------------------------------------------------------------------------
+inline int TFrameAccum::addFrames(TMsgWrapperPoolQueue& queue, int maxFrames)
+{
+    int frameNum = 0;
+    TRawFramePtr framePtr;
+    while((!maxFrames || frameNum < maxFrames) && queue.get(framePtr)) {
+        if(addFrame(framePtr)) {
+            ++frameNum;
+        }
+        #if !defined(MSG_SELF_RELEASE)
+            TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(framePtr);
+        #endif
+        framePtr.reset();
+    }
+    return frameNum;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameAccum::getResult(TRawFramePtr dstPtr) const
+{
+    TBaseFrame* dst;
+    TPixel* dstBuf;
+    if(!mFrameNum || !dstPtr || !(dst = checkMsg<TBaseFrame>(dstPtr)) || !(dstBuf = dst->getPixelBuf<TRawFrame>()) ||
+       (dst->width() != mWidth) || (dst->height() != mHeight)) {
+        return false;
+    }
+
+    const int stripes = TStripeExec::stripeNum(mHeight,mWidth,mMaxThreads);
+    auto stripeFunc = [&](int, int rowBegin, int rowEnd) {
+        resultRows(dstBuf,static_cast<size_t>(rowBegin)*mWidth,static_cast<size_t>(rowEnd)*mWidth);
+    };
+    TStripeExec::run(mHeight,stripes,stripeFunc);
+
+    dstPtr->setMsgId(mMsgId);
+    dstPtr->setNetPoints(mNetSrc,mNetDst);
+    dst->metaInfo() = mMetaInfo;
+    return true;
+}
+
+#endif // FRAME_ACCUM_H
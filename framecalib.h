@@ -0,0 +1,320 @@
+#if !defined(FRAME_CALIB_H)
+#define FRAME_CALIB_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "SimdDefs.h"
+#include "framepar.h"
+#include "frameaccum.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Calibration maps are ordinary pooled frames:
+//      dark map   - TRawFrame, subtracted from raw pixels (saturated at 0)
+//      gain map   - TRawFrame, unsigned fixed point gain, GainOne == 1.0
+//      defect map - TScreenFrameGray, non-zero pixel marks a defect pixel
+//
+//  all corrections are done in one pass over the frame: dark and gain are
+//  applied to a block of rows and the defect pixels of the block are replaced
+//  while the block is still in cache
+//-----------------------------------------------------------------------------
+class TFrameCalib
+{
+    public:
+        typedef TRawFrame::TPixel TPixel;
+
+        static const int      GainShift   = 12;
+        static const uint32_t GainOne     = 1u << GainShift;
+        static const int      BlockPixels = 16*1024;        // cache block: ~32 KB per pixel stream
+
+        TFrameCalib() : mWidth(0), mHeight(0), mMaxThreads(0) {}
+
+        bool setDarkMap(TRawFramePtr darkMap)     { return setMap<TRawFrame>(darkMap,mDarkMap); }
+        bool setGainMap(TRawFramePtr gainMap)     { return setMap<TRawFrame>(gainMap,mGainMap); }
+        bool setDefectMap(TRawFramePtr defectMap);
+        void clearMaps()
+        {
+            mDarkMap.reset();
+            mGainMap.reset();
+            mDefectMap.reset();
+            mDefects.clear();
+            mWidth = mHeight = 0;
+        }
+        void setMaxThreads(int maxThreads) { mMaxThreads = maxThreads; }
+
+        TRawFramePtr darkMap() const   { return mDarkMap; }
+        TRawFramePtr gainMap() const   { return mGainMap; }
+        TRawFramePtr defectMap() const { return mDefectMap; }
+
+        //--- srcPtr and dstPtr may be the same frame (in place correction)
+        bool apply(TRawFramePtr srcPtr, TRawFramePtr dstPtr);
+        bool apply(TRawFramePtr framePtr) { return apply(framePtr,framePtr); }
+
+    private:
+        //---------------------------------------------------------------------
+        struct TDefect
+        {
+            uint32_t idx;       // pixel index in frame
+            int32_t  left;      // offsets to nearest good pixels in the same row, 0 - not exist
+            int32_t  right;
+        };
+
+        //---
+        template<typename TFrameType> bool setMap(TRawFramePtr mapPtr, TRawFramePtr& map)
+        {
+            TBaseFrame* frame;
+            if(!mapPtr) {
+                map.reset();
+                return true;
+            }
+            if(!(frame = checkMsg<TBaseFrame>(mapPtr)) || !frame->getPixelBuf<TFrameType>() || !checkSize(frame)) {
+                return false;
+            }
+            map = mapPtr;
+            return true;
+        }
+
+        //---
+        bool checkSize(TBaseFrame* frame)
+        {
+            if(!mDarkMap && !mGainMap && !mDefectMap) {
+                mWidth  = frame->width();
+                mHeight = frame->height();
+            }
+            return (frame->width() == mWidth) && (frame->height() == mHeight);
+        }
+
+        static TPixel* pixelBuf(TRawFramePtr framePtr) { return framePtr ? checkMsg<TBaseFrame>(framePtr)->getPixelBuf<TRawFrame>() : 0; }
+
+        //---
+        static TPixel correct(uint32_t pix, uint32_t dark, uint32_t gain)
+        {
+            pix = (pix > dark) ? pix - dark : 0;
+            pix = (pix*gain + (GainOne >> 1)) >> GainShift;
+            return static_cast<TPixel>(std::min<uint32_t>(pix,0xFFFF));
+        }
+
+        template<bool EnaDark, bool EnaGain> static void correctBlock(const TPixel* src, const TPixel* dark, const TPixel* gain, TPixel* dst, int len);
+        void correctDefects(TPixel* dst, uint32_t beginIdx, uint32_t endIdx) const;
+
+        int                  mWidth;
+        int                  mHeight;
+        int                  mMaxThreads;
+        TRawFramePtr         mDarkMap;
+        TRawFramePtr         mGainMap;
+        TRawFramePtr         mDefectMap;
+        std::vector<TDefect> mDefects;      // sorted by idx
+};
+
+//-----------------------------------------------------------------------------
+template<bool EnaDark, bool EnaGain> void TFrameCalib::correctBlock(const TPixel* src, const TPixel* dark, const TPixel* gain, TPixel* dst, int len)
+{
+    int x = 0;
+
+    #if defined(ENA_SIMD_AVX2)
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i ones     = _mm256_set1_epi16(-1);
+    const __m256i round    = _mm256_set1_epi16(static_cast<short>(GainOne >> 1));
+    const __m256i carryMin = _mm256_set1_epi16(static_cast<short>(0x10000 - (GainOne >> 1)));
+    for(; x + 16 <= len; x += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        if(EnaDark) {
+            v = _mm256_subs_epu16(v,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(dark + x)));
+        }
+        if(EnaGain) {
+            //--- 16x16 -> 32 bit product is split to hi/lo 16-bit halves, rounding carry is added to hi
+            const __m256i g     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gain + x));
+            const __m256i lo    = _mm256_mullo_epi16(v,g);
+            const __m256i carry = _mm256_cmpeq_epi16(_mm256_max_epu16(lo,carryMin),lo);
+            const __m256i hi    = _mm256_sub_epi16(_mm256_mulhi_epu16(v,g),carry);
+            const __m256i noOvf = _mm256_cmpeq_epi16(_mm256_srli_epi16(hi,GainShift),zero);
+            v = _mm256_or_si256(_mm256_slli_epi16(hi,16 - GainShift),_mm256_srli_epi16(_mm256_add_epi16(lo,round),GainShift));
+            v = _mm256_or_si256(v,_mm256_andnot_si256(noOvf,ones));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),v);
+    }
+    #endif
+
+    for(; x < len; ++x) {
+        dst[x] = correct(src[x],EnaDark ? dark[x] : 0,EnaGain ? gain[x] : GainOne);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameCalib::correctDefects(TPixel* dst, uint32_t beginIdx, uint32_t endIdx) const
+{
+    TDefect key = { beginIdx, 0, 0 };
+    std::vector<TDefect>::const_iterator defect = std::lower_bound(mDefects.begin(),mDefects.end(),key,
+                                                                    [](const TDefect& a, const TDefect& b) { return a.idx < b.idx; });
+    for(; defect != mDefects.end() && defect->idx < endIdx; ++defect) {
+        const TPixel* pix = dst + defect->idx;
+        if(defect->left && defect->right) {
+            dst[defect->idx] = static_cast<TPixel>((static_cast<uint32_t>(pix[defect->left]) + pix[defect->right] + 1) >> 1);
+        } else if(defect->left) {
+            dst[defect->idx] = pix[defect->left];
+        } else if(defect->right) {
+            dst[defect->idx] = pix[defect->right];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameCalib::setDefectMap(TRawFramePtr defectMap)
+{
+    if(!setMap<TScreenFrameGray>(defectMap,mDefectMap)) {
+        return false;
+    }
+    mDefects.clear();
+    if(!mDefectMap) {
+        return true;
+    }
+
+    const TScreenFrameGray::TPixel* mask = checkMsg<TBaseFrame>(mDefectMap)->getPixelBuf<TScreenFrameGray>();
+    for(int y = 0; y < mHeight; ++y) {
+        const TScreenFrameGray::TPixel* row = mask + static_cast<size_t>(y)*mWidth;
+        for(int x = 0; x < mWidth; ++x) {
+            if(!row[x]) {
+                continue;
+            }
+            TDefect defect = { static_cast<uint32_t>(y*mWidth + x), 0, 0 };
+            for(int n = x - 1; n >= 0; --n) {
+                if(!row[n]) {
+                    defect.left = n - x;
+                    break;
+                }
+            }
+            for(int n = x + 1; n < mWidth; ++n) {
+                if(!row[n]) {
+                    defect.right = n - x;
+                    break;
+                }
+            }
+            mDefects.push_back(defect);
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameCalib::apply(TRawFramePtr srcPtr, TRawFramePtr dstPtr)
+{
+    TBaseFrame* src;
+    TBaseFrame* dst;
+    if(!srcPtr || !dstPtr || !(src = checkMsg<TBaseFrame>(srcPtr)) || !(dst = checkMsg<TBaseFrame>(dstPtr))) {
+        return false;
+    }
+
+    const TPixel* srcBuf  = src->getPixelBuf<TRawFrame>();
+    TPixel*       dstBuf  = dst->getPixelBuf<TRawFrame>();
+    const TPixel* darkBuf = pixelBuf(mDarkMap);
+    const TPixel* gainBuf = pixelBuf(mGainMap);
+    if(!srcBuf || !dstBuf || (src->width() != dst->width()) || (src->height() != dst->height())) {
+        return false;
+    }
+    if((mDarkMap || mGainMap || mDefectMap) && ((src->width() != mWidth) || (src->height() != mHeight))) {
+        return false;
+    }
+
+    //---
+    void (*blockFunc)(const TPixel*, const TPixel*, const TPixel*, TPixel*, int);
+    if(darkBuf && gainBuf) {
+        blockFunc = correctBlock<true,true>;
+    } else if(darkBuf) {
+        blockFunc = correctBlock<true,false>;
+    } else if(gainBuf) {
+        blockFunc = correctBlock<false,true>;
+    } else {
+        blockFunc = (srcBuf != dstBuf) ? correctBlock<false,false> : 0;
+    }
+
+    const int width     = src->width();
+    const int blockRows = std::max(1,BlockPixels/std::max(1,width));
+    const int stripes   = TStripeExec::stripeNum(src->height(),width,mMaxThreads);
+
+    auto stripeFunc = [&](int, int rowBegin, int rowEnd) {
+        for(int row = rowBegin; row < rowEnd; row += blockRows) {
+            const size_t beginIdx = static_cast<size_t>(row)*width;
+            const size_t endIdx   = static_cast<size_t>(std::min(row + blockRows,rowEnd))*width;
+            if(blockFunc) {
+                blockFunc(srcBuf + beginIdx,darkBuf + beginIdx,gainBuf + beginIdx,dstBuf + beginIdx,static_cast<int>(endIdx - beginIdx));
+            }
+            if(!mDefects.empty()) {
+                correctDefects(dstBuf,static_cast<uint32_t>(beginIdx),static_cast<uint32_t>(endIdx));
+            }
+        }
+    };
+    TStripeExec::run(src->height(),stripes,stripeFunc);
+
+    //--- frame container data and metainfo follow the pixels
+    if(src != dst) {
+        dstPtr->setMsgId(srcPtr->msgId());
+        dstPtr->setNetPoints(srcPtr->netSrc(),srcPtr->netDst());
+        dst->metaInfo() = src->metaInfo();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class TCalibMapBuilder
+{
+    public:
+        TCalibMapBuilder() : mAccum(TFrameAccum::Average) {}
+
+        void reset() { mAccum.reset(); }
+        int frameNum() const { return mAccum.frameNum(); }
+
+        bool addFrame(TRawFramePtr framePtr) { return mAccum.addFrame(framePtr); }
+        int addFrames(TMsgWrapperPoolQueue& queue, int maxFrames = 0) { return mAccum.addFrames(queue,maxFrames); }
+        bool makeDarkMap(TRawFramePtr darkMap) const { return mAccum.getResult(darkMap); }
+        bool makeGainMap(TRawFramePtr gainMap, TRawFramePtr darkMap = TRawFramePtr()) const;
+
+    private:
+        TFrameAccum mAccum;
+};
+
+//-----------------------------------------------------------------------------
+//  gain = mean(flat - dark) / (flat - dark), i.e. flat field is normalized to its mean level
+//-----------------------------------------------------------------------------
+inline bool TCalibMapBuilder::makeGainMap(TRawFramePtr gainMap, TRawFramePtr darkMap) const
+{
+    const int width    = mAccum.width();
+    const int height   = mAccum.height();
+    const int frameNum = mAccum.frameNum();
+    const uint32_t* accum = mAccum.accumBuf();
+
+    TBaseFrame* frame;
+    TRawFrame::TPixel* gain;
+    const TRawFrame::TPixel* dark = 0;
+    if(!accum || !gainMap || !(frame = checkMsg<TBaseFrame>(gainMap)) || !(gain = frame->getPixelBuf<TRawFrame>()) ||
+       (frame->width() != width) || (frame->height() != height)) {
+        return false;
+    }
+    if(darkMap) {
+        TBaseFrame* darkFrame = checkMsg<TBaseFrame>(darkMap);
+        if(!darkFrame || !(dark = darkFrame->getPixelBuf<TRawFrame>()) || (darkFrame->width() != width) || (darkFrame->height() != height)) {
+            return false;
+        }
+    }
+
+    //--- flat levels scaled by frameNum
+    const size_t size = static_cast<size_t>(width)*height;
+    std::vector<uint32_t> flat(size);
+    uint64_t flatSum = 0;
+    for(size_t n = 0; n < size; ++n) {
+        const uint32_t darkLevel = dark ? dark[n]*static_cast<uint32_t>(frameNum) : 0;
+        flat[n]  = (accum[n] > darkLevel) ? accum[n] - darkLevel : 0;
+        flatSum += flat[n];
+    }
+
+    const double flatMean = static_cast<double>(flatSum)/size;
+    for(size_t n = 0; n < size; ++n) {
+        const double g = flat[n] ? (flatMean*TFrameCalib::GainOne)/flat[n] + 0.5 : 0;
+        gain[n] = static_cast<TRawFrame::TPixel>(std::min(g,65535.0));
+    }
+    return true;
+}
+
+#endif // FRAME_CALIB_H
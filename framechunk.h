@@ -0,0 +1,417 @@
+#if !defined(FRAME_CHUNK_H)
+#define FRAME_CHUNK_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Chunked frame stream: frames of any size (stitched mosaics, stacks above
+//  4 GB) are sent as a sequence of transfers of at most 'chunkSize' bytes,
+//  e.g. IP_QPIPE chunks (TPipeInfo::chunkSize)
+//
+//  frame stream has serializeFrame() layout - TFrameSerialHeader with
+//  FrameChunkFlag, metainfo, packed pixel lines - and 64-bit length. Each
+//  chunk is TFrameChunkHeader followed by a part of the stream; chunk 0 holds
+//  the whole header and metainfo. Chunks have own CRC32C, so they are made
+//  and assembled in any order
+//-----------------------------------------------------------------------------
+const uint32_t FrameChunkMagic = 0x31484346;   // 'FCH1'
+
+struct TFrameChunkHeader
+{
+    uint32_t magic;             // [offset:    0] FrameChunkMagic
+    uint32_t msgId;             // [offset:    1] frame msgId
+    uint32_t chunkIdx;          // [offset:    2]
+    uint32_t chunkNum;          // [offset:    3]
+    uint32_t offsetHi;          // [offset:    4] chunk data offset in the frame stream
+    uint32_t offsetLo;          // [offset:    5]
+    uint32_t streamLenHi;       // [offset:    6] frame stream length
+    uint32_t streamLenLo;       // [offset:    7]
+    uint32_t dataLen;           // [offset:    8] chunk data bytes after the header
+    uint32_t dataCrc;           // [offset:    9] CRC32C of chunk data
+    uint32_t reserved;          // [offset:   10]
+    uint32_t headerCrc;         // [offset:   11] CRC32C of the words above
+
+    uint64_t offset() const { return (static_cast<uint64_t>(offsetHi) << 32) | offsetLo; }
+    uint64_t streamLen() const { return (static_cast<uint64_t>(streamLenHi) << 32) | streamLenLo; }
+    uint32_t calcHeaderCrc() const { return TCrc32c::calc(this,offsetof(TFrameChunkHeader,headerCrc)); }
+};
+
+static_assert(sizeof(TFrameChunkHeader) == 12*sizeof(uint32_t),"TFrameChunkHeader layout");
+
+//-----------------------------------------------------------------------------
+//  frame stream offset to pixel memory: packed lines are addressed as one line
+//-----------------------------------------------------------------------------
+class TFrameChunkLayout
+{
+    public:
+        TFrameChunkLayout() : mPixels(0), mLineLen(0), mBytesPerLine(0), mStreamLen(0), mChunkDataLen(0), mChunkNum(0) {}
+
+        static uint32_t prefixLen() { return sizeof(TFrameSerialHeader) + TMetaInfo::serialSize(); }
+        static uint32_t minChunkSize() { return sizeof(TFrameChunkHeader) + prefixLen(); }
+
+        uint64_t streamLen() const { return mStreamLen; }
+        uint32_t chunkNum() const { return mChunkNum; }
+
+        //--- stream prefix (header with FrameChunkFlag and metainfo) of the frame
+        static bool writePrefix(TRawFramePtr framePtr, bool enaHash, std::vector<uint8_t>& prefix);
+
+        //--- stream prefix of the frame 'msgId' to the frame, false for bad prefix
+        static bool readPrefix(TRawFramePtr framePtr, const uint8_t* data, uint32_t msgId, TFrameSerialHeader& header);
+        static void setFrameData(TRawFramePtr framePtr, const TFrameSerialHeader& header);
+
+    protected:
+        bool init(TBaseFrame* frame, uint32_t chunkSize)
+        {
+            mChunkNum = 0;
+            if(!frame || (chunkSize < minChunkSize()) || !(mPixels = static_cast<uint8_t*>(frame->getPixelBuf()))) {
+                return false;
+            }
+            mBytesPerLine = frame->bytesPerLine();
+            mLineLen      = static_cast<uint64_t>(frame->width())*frame->pixelSize();
+            if(mBytesPerLine == mLineLen) {
+                mLineLen = mBytesPerLine = frame->byteSize();
+            }
+            mStreamLen    = prefixLen() + frame->byteSize();
+            mChunkDataLen = chunkSize - sizeof(TFrameChunkHeader);
+
+            const uint64_t chunkNum = (mStreamLen + mChunkDataLen - 1)/mChunkDataLen;
+            mChunkNum = (chunkNum <= 0xFFFFFFFF) ? static_cast<uint32_t>(chunkNum) : 0;
+            return mChunkNum != 0;
+        }
+
+        uint64_t chunkOffset(uint32_t chunkIdx) const { return static_cast<uint64_t>(chunkIdx)*mChunkDataLen; }
+        uint32_t chunkDataLen(uint32_t chunkIdx) const
+        {
+            const uint64_t offset = chunkOffset(chunkIdx);
+            return static_cast<uint32_t>((mStreamLen - offset < mChunkDataLen) ? mStreamLen - offset : mChunkDataLen);
+        }
+
+        //--- func(pixels, done, n): pixel memory of stream bytes [offset + done, offset + done + n), pieces of [offset, offset + len)
+        template<typename TFunc> void forPixels(uint64_t offset, uint32_t len, TFunc func) const
+        {
+            for(uint32_t done = 0; done < len; ) {
+                const uint64_t pixOffset = offset + done - prefixLen();
+                const uint64_t row       = pixOffset/mLineLen;
+                const uint64_t col       = pixOffset - row*mLineLen;
+                const uint32_t n         = static_cast<uint32_t>((mLineLen - col < len - done) ? mLineLen - col : len - done);
+                func(mPixels + row*mBytesPerLine + col,done,n);
+                done += n;
+            }
+        }
+
+        //--- stream bytes [offset, offset + len) of pixels to/from 'data', returns CRC32C of 'data' ('crc' when !Crc)
+        template<bool ToPixels, bool Crc = true> uint32_t copyPixels(uint64_t offset, uint8_t* data, uint32_t len, uint32_t crc) const
+        {
+            forPixels(offset,len,[data,&crc](uint8_t* pixels, uint32_t done, uint32_t n) {
+                if(Crc) {
+                    crc = ToPixels ? TCrc32c::copy(pixels,data + done,n,crc) : TCrc32c::copy(data + done,pixels,n,crc);
+                } else {
+                    std::memcpy(ToPixels ? pixels : data + done,ToPixels ? data + done : pixels,n);
+                }
+            });
+            return crc;
+        }
+
+        uint8_t* mPixels;
+        uint64_t mLineLen;
+        uint64_t mBytesPerLine;
+        uint64_t mStreamLen;
+        uint32_t mChunkDataLen;
+        uint32_t mChunkNum;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameChunkLayout::writePrefix(TRawFramePtr framePtr, bool enaHash, std::vector<uint8_t>& prefix)
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(framePtr);
+    const uint64_t hash = enaHash ? frameHash(frame) : 0;
+    prefix.resize(prefixLen());
+    TSerializer serializer(&prefix[0],prefix.size());
+    serialFrameHeader(serializer,framePtr,frame->pixelSize(),frame->width(),frame->height(),enaHash,hash);
+    frame->metaInfo().serialize(serializer);
+    if(!serializer.isOk()) {
+        return false;
+    }
+    if(enaHash) {
+        frame->setHash(hash);       // contents are accessed for reading only
+    }
+
+    TFrameSerialHeader header;
+    std::memcpy(&header,&prefix[0],sizeof(header));
+    header.flags    |= FrameChunkFlag;
+    header.headerCrc = header.calcHeaderCrc();
+    std::memcpy(&prefix[0],&header,sizeof(header));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  metainfo is written only after the header is validated
+//-----------------------------------------------------------------------------
+inline bool TFrameChunkLayout::readPrefix(TRawFramePtr framePtr, const uint8_t* data, uint32_t msgId, TFrameSerialHeader& header)
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(framePtr);
+    TDeserializer deserializer(data,prefixLen());
+    deserializer.read(header);
+    return (header.magic == FrameMagic2) && (header.versionSize == ((FrameVersion << 16) | FrameHeaderWords)) &&
+           (header.calcHeaderCrc() == header.headerCrc) && (header.flags & FrameChunkFlag) && (header.msgId == msgId) &&
+           (static_cast<uint32_t>(frame->pixelSize()) == header.pixelSize) && (static_cast<uint32_t>(frame->height()) == header.height) &&
+           (static_cast<uint32_t>(frame->width()) == header.width) && frame->metaInfo().deserialize(deserializer);
+}
+
+//-----------------------------------------------------------------------------
+//  frame container data of the assembled frame: net points, msgId, hash
+//-----------------------------------------------------------------------------
+inline void TFrameChunkLayout::setFrameData(TRawFramePtr framePtr, const TFrameSerialHeader& header)
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(framePtr);
+    framePtr->setNetSrc((static_cast<CfgDefs::TNetAddr>(header.netSrcHi) << 32) | header.netSrcLo);
+    framePtr->setNetDst((static_cast<CfgDefs::TNetAddr>(header.netDstHi) << 32) | header.netDstLo);
+    framePtr->setMsgId(header.msgId);
+    if(header.flags & FrameHashFlag) {
+        frame->setHash((static_cast<uint64_t>(header.hashHi) << 32) | header.hashLo);
+    } else {
+        frame->invalidateHash();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  the frame is held (and must not be modified) until the next begin() or
+//  end(); writeChunk() of different chunks may be called from several threads
+//
+//  txTransferFunc() is IP_QPIPE_LIB::TxTransferFunc: one sendDataFuncObj()
+//  call per chunk until finished()
+//-----------------------------------------------------------------------------
+class TFrameChunkWriter : public TFrameChunkLayout
+{
+    public:
+        explicit TFrameChunkWriter(uint32_t chunkSize) : mChunkSize(chunkSize), mMsgId(0), mNextChunk(0) {}
+
+        bool begin(TRawFramePtr framePtr, bool enaHash = false);
+        void end() { mFramePtr = TRawFramePtr(); mChunkNum = 0; }
+        bool finished() const { return mNextChunk >= mChunkNum; }
+
+        uint32_t writeChunk(uint32_t chunkIdx, uint8_t* dst, uint32_t maxLen) const;
+        uint32_t writeNext(uint8_t* dst, uint32_t maxLen);
+
+        static uint32_t txTransferFunc(void* obj, uint8_t* dst, uint32_t maxLen) { return static_cast<TFrameChunkWriter*>(obj)->writeNext(dst,maxLen); }
+
+    private:
+        const uint32_t       mChunkSize;
+        TRawFramePtr         mFramePtr;
+        std::vector<uint8_t> mPrefix;       // header and metainfo
+        uint32_t             mMsgId;
+        uint32_t             mNextChunk;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameChunkWriter::begin(TRawFramePtr framePtr, bool enaHash)
+{
+    end();
+    TBaseFrame* frame = framePtr ? checkMsg<TBaseFrame>(framePtr) : 0;
+    if(!init(frame,mChunkSize) || !writePrefix(framePtr,enaHash,mPrefix)) {
+        mChunkNum = 0;
+        return false;
+    }
+    mFramePtr  = framePtr;
+    mMsgId     = static_cast<uint32_t>(framePtr->msgId());
+    mNextChunk = 0;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  returns chunk length or 0 for bad index or short 'dst'
+//-----------------------------------------------------------------------------
+inline uint32_t TFrameChunkWriter::writeChunk(uint32_t chunkIdx, uint8_t* dst, uint32_t maxLen) const
+{
+    if(chunkIdx >= mChunkNum) {
+        return 0;
+    }
+    const uint64_t offset  = chunkOffset(chunkIdx);
+    const uint32_t dataLen = chunkDataLen(chunkIdx);
+    if((maxLen < sizeof(TFrameChunkHeader)) || (dataLen > maxLen - sizeof(TFrameChunkHeader))) {
+        return 0;
+    }
+
+    //--- chunk 0 starts with the whole prefix, see minChunkSize()
+    uint8_t* data = dst + sizeof(TFrameChunkHeader);
+    uint32_t crc  = 0;
+    uint32_t done = 0;
+    if(offset == 0) {
+        done = prefixLen();
+        crc  = TCrc32c::copy(data,&mPrefix[0],done);
+    }
+    crc = copyPixels<false>(offset + done,data + done,dataLen - done,crc);
+
+    TFrameChunkHeader header = {
+        FrameChunkMagic,
+        mMsgId,
+        chunkIdx,
+        mChunkNum,
+        static_cast<uint32_t>(offset >> 32),
+        static_cast<uint32_t>(offset),
+        static_cast<uint32_t>(mStreamLen >> 32),
+        static_cast<uint32_t>(mStreamLen),
+        dataLen,
+        crc,
+        0, 0
+    };
+    header.headerCrc = header.calcHeaderCrc();
+    std::memcpy(dst,&header,sizeof(header));
+    return sizeof(header) + dataLen;
+}
+
+//-----------------------------------------------------------------------------
+//  chunks in order, 0 after the last one
+//-----------------------------------------------------------------------------
+inline uint32_t TFrameChunkWriter::writeNext(uint8_t* dst, uint32_t maxLen)
+{
+    const uint32_t len = writeChunk(mNextChunk,dst,maxLen);
+    if(len) {
+        ++mNextChunk;
+    }
+    return len;
+}
+
+//-----------------------------------------------------------------------------
+//  Assembles chunks of TFrameChunkWriter into the frame of the same geometry;
+//  duplicated chunks are ignored, a chunk of another frame (msgId) drops the
+//  incomplete one and starts new assembly. The source may be untrusted, as
+//  for deserializeFrame(): pixels of a chunk are written only after its header,
+//  its place in the chunk sequence of the sender (offset == chunkIdx*chunkLen,
+//  full chunks but the last one) and its payload CRC are validated, the frame
+//  container data, metainfo and hash - only after chunk 0 payload is validated.
+//
+//  rxTransferFunc() is IP_QPIPE_LIB::RxTransferFunc
+//-----------------------------------------------------------------------------
+class TFrameChunkReader : public TFrameChunkLayout
+{
+    public:
+        TFrameChunkReader() : mMaxChunkNum(0), mMsgId(0), mChunkLen(0), mReceived(0), mStarted(false), mHeaderValid(false) {}
+
+        bool begin(TRawFramePtr framePtr);
+        void end() { mFramePtr = TRawFramePtr(); mChunkNum = 0; }
+        bool addChunk(const void* src, uint32_t len, TFrameSerialStat* stat = 0);
+        bool complete() const { return mChunkNum && (mReceived == mChunkNum) && mHeaderValid; }
+        uint32_t receivedNum() const { return mReceived; }
+
+        static bool rxTransferFunc(void* obj, uint8_t* src, uint32_t len) { return static_cast<TFrameChunkReader*>(obj)->addChunk(src,len); }
+
+    private:
+        void restart(uint32_t msgId);
+
+        TRawFramePtr       mFramePtr;
+        TFrameSerialHeader mHeader;
+        std::vector<bool>  mChunkReceived;
+        uint32_t           mMaxChunkNum;    // for chunks of minChunkSize()
+        uint32_t           mMsgId;
+        uint32_t           mChunkLen;       // chunk data length of the sender, 0 - not known yet
+        uint32_t           mReceived;
+        bool               mStarted;
+        bool               mHeaderValid;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameChunkReader::begin(TRawFramePtr framePtr)
+{
+    end();
+    TBaseFrame* frame = framePtr ? checkMsg<TBaseFrame>(framePtr) : 0;
+    if(!init(frame,minChunkSize())) {      // chunk size of the sender is taken from chunk headers
+        return false;
+    }
+    mFramePtr    = framePtr;
+    mMaxChunkNum = mChunkNum;
+    mStarted     = false;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameChunkReader::restart(uint32_t msgId)
+{
+    mChunkReceived.assign(mChunkNum,false);
+    mMsgId       = msgId;
+    mChunkLen    = 0;
+    mReceived    = 0;
+    mStarted     = true;
+    mHeaderValid = false;
+}
+
+//-----------------------------------------------------------------------------
+//  returns false for bad chunk
+//-----------------------------------------------------------------------------
+inline bool TFrameChunkReader::addChunk(const void* src, uint32_t len, TFrameSerialStat* stat)
+{
+    auto fail = [stat](uint64_t TFrameSerialStat::* counter) { if(stat) ++(stat->*counter); return false; };
+
+    if(!mFramePtr) {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
+
+    //--- header
+    TDeserializer deserializer(src,len);
+    TFrameChunkHeader header;
+    if(!deserializer.read(header)) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
+    if(header.magic != FrameChunkMagic) {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
+    if(header.calcHeaderCrc() != header.headerCrc) {
+        return fail(&TFrameSerialStat::headerCrcErrors);
+    }
+
+    //--- chunk geometry against the frame
+    const uint64_t offset = header.offset();
+    if((header.streamLen() != mStreamLen) || (header.chunkIdx >= header.chunkNum) || (header.chunkNum > mMaxChunkNum) ||
+       (deserializer.remaining() != header.dataLen) || (offset > mStreamLen) || (header.dataLen > mStreamLen - offset) ||
+       ((header.chunkIdx == 0) != (offset == 0)) || ((offset == 0) ? (header.dataLen < prefixLen()) : (offset < prefixLen()))) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
+
+    //--- chunk place in the sequence of the sender: chunks of chunkLen bytes at chunkIdx*chunkLen, the last one
+    //    up to the stream end; chunkLen is taken from a full chunk or from the offset of the last one
+    const bool     last     = header.chunkIdx == header.chunkNum - 1;
+    const uint64_t chunkLen = (last && header.chunkIdx) ? offset/header.chunkIdx : header.dataLen;
+    if((chunkLen == 0) || (offset != header.chunkIdx*chunkLen) || ((mStreamLen + chunkLen - 1)/chunkLen != header.chunkNum) ||
+       (last ? (offset + header.dataLen != mStreamLen) : (header.dataLen != chunkLen))) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
+    if(!mStarted || (header.msgId != mMsgId) || (header.chunkNum != mChunkNum)) {
+        mChunkNum = header.chunkNum;
+        restart(header.msgId);
+    }
+    if(mChunkLen && (chunkLen != mChunkLen)) {
+        return fail(&TFrameSerialStat::sizeErrors);
+    }
+    if(mChunkReceived[header.chunkIdx]) {
+        return true;
+    }
+
+    //--- payload: CRC is checked before anything is written
+    const uint8_t* data = deserializer.streamPtr();
+    if(TCrc32c::calc(data,header.dataLen) != header.dataCrc) {
+        return fail(&TFrameSerialStat::payloadCrcErrors);
+    }
+    if((offset == 0) && !(mHeaderValid = readPrefix(mFramePtr,data,mMsgId,mHeader))) {
+        return fail(&TFrameSerialStat::formatErrors);
+    }
+    const uint32_t done = (offset == 0) ? prefixLen() : 0;
+    copyPixels<true,false>(offset + done,const_cast<uint8_t*>(data) + done,header.dataLen - done,0);
+    mChunkLen = static_cast<uint32_t>(chunkLen);
+    mChunkReceived[header.chunkIdx] = true;
+    ++mReceived;
+
+    //--- frame container data
+    if(complete()) {
+        setFrameData(mFramePtr,mHeader);
+        if(stat) {
+            ++stat->frames;
+        }
+    }
+    return true;
+}
+
+#endif // FRAME_CHUNK_H
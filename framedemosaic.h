@@ -0,0 +1,462 @@
+#if !defined(FRAME_DEMOSAIC_H)
+#define FRAME_DEMOSAIC_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "SimdDefs.h"
+#include "framepar.h"
+#include "frameview.h"
+#include "frameqt.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Bayer CFA demosaic of TRawFrame into TScreenFrame (ARGB32); white balance
+//  and bit depth reduction are done in the same pass
+//
+//  Bilinear  - missing colours are means of the nearest pixels of the colour
+//  EdgeAware - green at red/blue pixels is interpolated along the smaller
+//              gradient, red/blue by colour differences (R - G, B - G) of the
+//              neighbours, so chroma edges follow luma edges; green rows are
+//              kept per stripe in a ring of 3 rows
+//
+//  frame borders are mirrored (CFA phase is kept); rows are processed in
+//  stripes, means are rounded as _mm_avg_epu16(), so SIMD and scalar paths
+//  give the same result
+//-----------------------------------------------------------------------------
+class TFrameDemosaic
+{
+    public:
+        typedef TRawFrame::TPixel           TSrcPixel;
+        typedef TScreenFrame::TPixel        TDstPixel;
+        typedef TFrameView<const TSrcPixel> TSrcView;
+        typedef TFrameView<TDstPixel>       TDstView;
+
+        static const int      GainShift = 12;
+        static const uint32_t GainOne   = 1u << GainShift;
+        static const uint32_t GainMax   = 0xFFFF;          // 16-bit SIMD multiply: gain < 16.0
+
+        enum TPattern       // colours of the top left 2x2 block
+        {
+            RGGB,
+            BGGR,
+            GRBG,
+            GBRG
+        };
+
+        enum TMethod
+        {
+            Bilinear,
+            EdgeAware
+        };
+
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : pattern(RGGB), method(Bilinear), bitDepth(16), gainR(GainOne), gainG(GainOne), gainB(GainOne), maxThreads(0) {}
+
+            TPattern pattern;
+            TMethod  method;
+            int      bitDepth;      // significant bits of raw pixels, 8..16
+            uint32_t gainR;         // white balance, GainOne == 1.0
+            uint32_t gainG;
+            uint32_t gainB;
+            int      maxThreads;
+        };
+
+        explicit TFrameDemosaic(const TParams& params = TParams()) { setParams(params); }
+
+        void setParams(const TParams& params);
+        const TParams& params() const { return mParams; }
+
+        //--- dst - TScreenFrame of src size, e.g. from ScreenFrame<Width,Height,Id> pool; frame container data and metainfo are copied
+        bool apply(TRawFramePtr srcPtr, TRawFramePtr dstPtr);
+        bool apply(const TSrcView& src, const TDstView& dst);
+
+    private:
+        //---------------------------------------------------------------------
+        struct TRowPhase
+        {
+            bool greenFirst;        // green at even x
+            bool redRow;            // the other colour of the row is red
+        };
+
+        static uint32_t avg(uint32_t a, uint32_t b) { return (a + b + 1) >> 1; }
+        static uint32_t absDiff(uint32_t a, uint32_t b) { return (a > b) ? a - b : b - a; }
+        static int mirror(int idx, int len) { return (idx < 0) ? -idx : (idx >= len) ? 2*(len - 1) - idx : idx; }
+        static uint32_t addDiff(uint32_t g, uint32_t a, uint32_t b) { return std::min(std::max(static_cast<int>(g + a) - static_cast<int>(b),0),0xFFFF); }
+
+        TRowPhase rowPhase(int y) const
+        {
+            const bool evenRow = (y & 1) == 0;
+            const TRowPhase phase = { evenRow == ((mParams.pattern == GRBG) || (mParams.pattern == GBRG)),
+                                      evenRow == ((mParams.pattern == RGGB) || (mParams.pattern == GRBG)) };
+            return phase;
+        }
+
+        //--- (value*gain) >> shift with rounding, saturated to 8 bits
+        uint32_t scale(uint32_t val, uint32_t gain) const { return std::min((((val*gain) >> (mShift - 1)) + 1) >> 1,255u); }
+        TDstPixel pack(uint32_t r, uint32_t g, uint32_t b) const
+        {
+            return 0xFF000000u | (scale(r,mParams.gainR) << 16) | (scale(g,mParams.gainG) << 8) | scale(b,mParams.gainB);
+        }
+        TDstPixel packRow(uint32_t c, uint32_t g, uint32_t c2, TRowPhase phase) const { return phase.redRow ? pack(c,g,c2) : pack(c2,g,c); }
+
+        void bilinearPixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, TDstPixel* dst, int xBegin, int xEnd, int width, TRowPhase phase) const;
+        void bilinearRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, TDstPixel* dst, int width, TRowPhase phase) const;
+        void greenPixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, uint16_t* green, int xBegin, int xEnd, int width, TRowPhase phase) const;
+        void greenRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, uint16_t* green, int width, TRowPhase phase) const;
+        void edgePixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, const uint16_t* greenUp, const uint16_t* green, const uint16_t* greenDown,
+                        TDstPixel* dst, int xBegin, int xEnd, int width, TRowPhase phase) const;
+        void edgeRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, const uint16_t* greenUp, const uint16_t* green, const uint16_t* greenDown,
+                     TDstPixel* dst, int width, TRowPhase phase) const;
+
+        #if defined(ENA_SIMD_AVX2)
+        __m256i scale(__m256i val, uint32_t gain) const;
+        void storeArgb(TDstPixel* dst, __m256i c, __m256i g, __m256i c2, TRowPhase phase) const;
+        #endif
+        #if defined(ENA_SIMD_AVX512)
+        __m512i scale(__m512i val, uint32_t gain) const;
+        void storeArgb(TDstPixel* dst, __m512i c, __m512i g, __m512i c2, TRowPhase phase) const;
+        #endif
+
+        TParams                             mParams;
+        int                                 mShift;
+        std::vector<std::vector<uint16_t>>  mScratch;      // per stripe green rows, EdgeAware
+};
+
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::setParams(const TParams& params)
+{
+    const uint32_t gainMax = GainMax;
+    mParams          = params;
+    mParams.bitDepth = std::min(16,std::max(8,params.bitDepth));
+    mParams.gainR    = std::min(params.gainR,gainMax);
+    mParams.gainG    = std::min(params.gainG,gainMax);
+    mParams.gainB    = std::min(params.gainB,gainMax);
+    mShift           = GainShift + mParams.bitDepth - 8;
+}
+
+#if defined(ENA_SIMD_AVX2)
+//-----------------------------------------------------------------------------
+inline __m256i TFrameDemosaic::scale(__m256i val, uint32_t gain) const
+{
+    const __m256i g     = _mm256_set1_epi16(static_cast<short>(gain));
+    const __m256i one   = _mm256_set1_epi32(1);
+    const __m128i shift = _mm_cvtsi32_si128(mShift - 1);
+    const __m256i lo    = _mm256_mullo_epi16(val,g);
+    const __m256i hi    = _mm256_mulhi_epu16(val,g);
+    const __m256i p0    = _mm256_srli_epi32(_mm256_add_epi32(_mm256_srl_epi32(_mm256_unpacklo_epi16(lo,hi),shift),one),1);
+    const __m256i p1    = _mm256_srli_epi32(_mm256_add_epi32(_mm256_srl_epi32(_mm256_unpackhi_epi16(lo,hi),shift),one),1);
+    return _mm256_min_epu16(_mm256_packus_epi32(p0,p1),_mm256_set1_epi16(0xFF));
+}
+
+//-----------------------------------------------------------------------------
+//  16 pixels: B | G << 8 and R | A << 8 words are interleaved to ARGB32
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::storeArgb(TDstPixel* dst, __m256i c, __m256i g, __m256i c2, TRowPhase phase) const
+{
+    const __m256i r  = scale(phase.redRow ? c : c2,mParams.gainR);
+    const __m256i b  = scale(phase.redRow ? c2 : c,mParams.gainB);
+    const __m256i bg = _mm256_or_si256(b,_mm256_slli_epi16(scale(g,mParams.gainG),8));
+    const __m256i ra = _mm256_or_si256(r,_mm256_set1_epi16(static_cast<short>(0xFF00)));
+    const __m256i lo = _mm256_unpacklo_epi16(bg,ra);     // pixels 0..3, 8..11
+    const __m256i hi = _mm256_unpackhi_epi16(bg,ra);     // pixels 4..7, 12..15
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),_mm256_permute2x128_si256(lo,hi,0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8),_mm256_permute2x128_si256(lo,hi,0x31));
+}
+#endif
+
+#if defined(ENA_SIMD_AVX512)
+//-----------------------------------------------------------------------------
+inline __m512i TFrameDemosaic::scale(__m512i val, uint32_t gain) const
+{
+    const __m512i g     = _mm512_set1_epi16(static_cast<short>(gain));
+    const __m512i one   = _mm512_set1_epi32(1);
+    const __m128i shift = _mm_cvtsi32_si128(mShift - 1);
+    const __m512i lo    = _mm512_mullo_epi16(val,g);
+    const __m512i hi    = _mm512_mulhi_epu16(val,g);
+    const __m512i p0    = _mm512_srli_epi32(_mm512_add_epi32(_mm512_srl_epi32(_mm512_unpacklo_epi16(lo,hi),shift),one),1);
+    const __m512i p1    = _mm512_srli_epi32(_mm512_add_epi32(_mm512_srl_epi32(_mm512_unpackhi_epi16(lo,hi),shift),one),1);
+    return _mm512_min_epu16(_mm512_packus_epi32(p0,p1),_mm512_set1_epi16(0xFF));
+}
+
+//-----------------------------------------------------------------------------
+//  32 pixels, see AVX2 version
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::storeArgb(TDstPixel* dst, __m512i c, __m512i g, __m512i c2, TRowPhase phase) const
+{
+    const __m512i r  = scale(phase.redRow ? c : c2,mParams.gainR);
+    const __m512i b  = scale(phase.redRow ? c2 : c,mParams.gainB);
+    const __m512i bg = _mm512_or_si512(b,_mm512_slli_epi16(scale(g,mParams.gainG),8));
+    const __m512i ra = _mm512_or_si512(r,_mm512_set1_epi16(static_cast<short>(0xFF00)));
+    const __m512i lo = _mm512_unpacklo_epi16(bg,ra);     // pixels 0..3, 8..11, 16..19, 24..27
+    const __m512i hi = _mm512_unpackhi_epi16(bg,ra);
+    _mm512_storeu_si512(dst,_mm512_permutex2var_epi64(lo,_mm512_setr_epi64(0,1,8,9,2,3,10,11),hi));
+    _mm512_storeu_si512(dst + 16,_mm512_permutex2var_epi64(lo,_mm512_setr_epi64(4,5,12,13,6,7,14,15),hi));
+}
+#endif
+
+//-----------------------------------------------------------------------------
+//  row with colour C and green: C site - C = p, G = cross mean, C' = diagonal mean
+//                               G site - C = horizontal mean, G = p, C' = vertical mean
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::bilinearPixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, TDstPixel* dst, int xBegin, int xEnd, int width, TRowPhase phase) const
+{
+    for(int x = xBegin; x < xEnd; ++x) {
+        const int      xl = mirror(x - 1,width);
+        const int      xr = mirror(x + 1,width);
+        const uint32_t h  = avg(row[xl],row[xr]);
+        const uint32_t v  = avg(up[x],down[x]);
+        if(((x & 1) == 0) == phase.greenFirst) {
+            dst[x] = packRow(h,row[x],v,phase);
+        } else {
+            dst[x] = packRow(row[x],avg(h,v),avg(avg(up[xl],up[xr]),avg(down[xl],down[xr])),phase);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  SIMD blocks start at even x, odd lanes are taken from the second operand of blend
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::bilinearRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, TDstPixel* dst, int width, TRowPhase phase) const
+{
+    int x = std::min(2,width);
+    bilinearPixels(up,row,down,dst,0,x,width,phase);
+
+    #if defined(ENA_SIMD_AVX512)
+    for(; x + 32 < width; x += 32) {
+        const __m512i p     = _mm512_loadu_si512(row + x);
+        const __m512i h     = _mm512_avg_epu16(_mm512_loadu_si512(row + x - 1),_mm512_loadu_si512(row + x + 1));
+        const __m512i v     = _mm512_avg_epu16(_mm512_loadu_si512(up + x),_mm512_loadu_si512(down + x));
+        const __m512i cross = _mm512_avg_epu16(h,v);
+        const __m512i diag  = _mm512_avg_epu16(_mm512_avg_epu16(_mm512_loadu_si512(up + x - 1),_mm512_loadu_si512(up + x + 1)),
+                                               _mm512_avg_epu16(_mm512_loadu_si512(down + x - 1),_mm512_loadu_si512(down + x + 1)));
+        const __mmask32 odd = 0xAAAAAAAA;
+        if(phase.greenFirst) {
+            storeArgb(dst + x,_mm512_mask_blend_epi16(odd,h,p),_mm512_mask_blend_epi16(odd,p,cross),_mm512_mask_blend_epi16(odd,v,diag),phase);
+        } else {
+            storeArgb(dst + x,_mm512_mask_blend_epi16(odd,p,h),_mm512_mask_blend_epi16(odd,cross,p),_mm512_mask_blend_epi16(odd,diag,v),phase);
+        }
+    }
+    #endif
+
+    #if defined(ENA_SIMD_AVX2)
+    for(; x + 16 < width; x += 16) {
+        const __m256i p     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        const __m256i h     = _mm256_avg_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1)),_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1)));
+        const __m256i v     = _mm256_avg_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x)),_mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x)));
+        const __m256i cross = _mm256_avg_epu16(h,v);
+        const __m256i diag  = _mm256_avg_epu16(_mm256_avg_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x - 1)),_mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x + 1))),
+                                               _mm256_avg_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x - 1)),_mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x + 1))));
+        if(phase.greenFirst) {
+            storeArgb(dst + x,_mm256_blend_epi16(h,p,0xAA),_mm256_blend_epi16(p,cross,0xAA),_mm256_blend_epi16(v,diag,0xAA),phase);
+        } else {
+            storeArgb(dst + x,_mm256_blend_epi16(p,h,0xAA),_mm256_blend_epi16(cross,p,0xAA),_mm256_blend_epi16(diag,v,0xAA),phase);
+        }
+    }
+    #endif
+
+    bilinearPixels(up,row,down,dst,x,width,width,phase);
+}
+
+//-----------------------------------------------------------------------------
+//  green at C sites along the smaller gradient, cross mean for equal ones
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::greenPixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, uint16_t* green, int xBegin, int xEnd, int width, TRowPhase phase) const
+{
+    for(int x = xBegin; x < xEnd; ++x) {
+        if(((x & 1) == 0) == phase.greenFirst) {
+            green[x] = row[x];
+            continue;
+        }
+        const int      xl = mirror(x - 1,width);
+        const int      xr = mirror(x + 1,width);
+        const uint32_t h  = avg(row[xl],row[xr]);
+        const uint32_t v  = avg(up[x],down[x]);
+        const uint32_t dH = absDiff(row[xl],row[xr]);
+        const uint32_t dV = absDiff(up[x],down[x]);
+        green[x] = static_cast<uint16_t>((dH < dV) ? h : (dV < dH) ? v : avg(h,v));
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::greenRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down, uint16_t* green, int width, TRowPhase phase) const
+{
+    int x = std::min(2,width);
+    greenPixels(up,row,down,green,0,x,width,phase);
+
+    #if defined(ENA_SIMD_AVX512)
+    const __mmask32 greenMask = phase.greenFirst ? 0x55555555 : 0xAAAAAAAA;
+    for(; x + 32 < width; x += 32) {
+        const __m512i l    = _mm512_loadu_si512(row + x - 1);
+        const __m512i r    = _mm512_loadu_si512(row + x + 1);
+        const __m512i u    = _mm512_loadu_si512(up + x);
+        const __m512i d    = _mm512_loadu_si512(down + x);
+        const __m512i h    = _mm512_avg_epu16(l,r);
+        const __m512i v    = _mm512_avg_epu16(u,d);
+        const __m512i dH   = _mm512_or_si512(_mm512_subs_epu16(l,r),_mm512_subs_epu16(r,l));
+        const __m512i dV   = _mm512_or_si512(_mm512_subs_epu16(u,d),_mm512_subs_epu16(d,u));
+        __m512i g = _mm512_avg_epu16(h,v);
+        g = _mm512_mask_blend_epi16(_mm512_cmplt_epu16_mask(dH,dV),g,h);
+        g = _mm512_mask_blend_epi16(_mm512_cmplt_epu16_mask(dV,dH),g,v);
+        _mm512_storeu_si512(green + x,_mm512_mask_blend_epi16(greenMask,g,_mm512_loadu_si512(row + x)));
+    }
+    #endif
+
+    #if defined(ENA_SIMD_AVX2)
+    for(; x + 16 < width; x += 16) {
+        const __m256i l    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+        const __m256i r    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+        const __m256i u    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+        const __m256i d    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x));
+        const __m256i p    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        const __m256i h    = _mm256_avg_epu16(l,r);
+        const __m256i v    = _mm256_avg_epu16(u,d);
+        const __m256i dH   = _mm256_or_si256(_mm256_subs_epu16(l,r),_mm256_subs_epu16(r,l));
+        const __m256i dV   = _mm256_or_si256(_mm256_subs_epu16(u,d),_mm256_subs_epu16(d,u));
+        const __m256i dMin = _mm256_min_epu16(dH,dV);
+        const __m256i dEq  = _mm256_cmpeq_epi16(dH,dV);
+        __m256i g = _mm256_avg_epu16(h,v);
+        g = _mm256_blendv_epi8(g,h,_mm256_andnot_si256(dEq,_mm256_cmpeq_epi16(dMin,dH)));
+        g = _mm256_blendv_epi8(g,v,_mm256_andnot_si256(dEq,_mm256_cmpeq_epi16(dMin,dV)));
+        g = phase.greenFirst ? _mm256_blend_epi16(p,g,0xAA) : _mm256_blend_epi16(g,p,0xAA);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(green + x),g);
+    }
+    #endif
+
+    greenPixels(up,row,down,green,x,width,width,phase);
+}
+
+//-----------------------------------------------------------------------------
+//  C site - C' = G + diagonal mean of C' - diagonal mean of G
+//  G site - C = G + horizontal mean of C - horizontal mean of G,
+//           C' = G + vertical mean of C' - vertical mean of G
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::edgePixels(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down,
+                                       const uint16_t* greenUp, const uint16_t* green, const uint16_t* greenDown,
+                                       TDstPixel* dst, int xBegin, int xEnd, int width, TRowPhase phase) const
+{
+    for(int x = xBegin; x < xEnd; ++x) {
+        const int      xl = mirror(x - 1,width);
+        const int      xr = mirror(x + 1,width);
+        const uint32_t g  = green[x];
+        if(((x & 1) == 0) == phase.greenFirst) {
+            dst[x] = packRow(addDiff(g,avg(row[xl],row[xr]),avg(green[xl],green[xr])),g,addDiff(g,avg(up[x],down[x]),avg(greenUp[x],greenDown[x])),phase);
+        } else {
+            dst[x] = packRow(row[x],g,addDiff(g,avg(avg(up[xl],up[xr]),avg(down[xl],down[xr])),avg(avg(greenUp[xl],greenUp[xr]),avg(greenDown[xl],greenDown[xr]))),phase);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  g + a - b saturated: one of (a - b), (b - a) is 0 in unsigned saturated arithmetic
+//-----------------------------------------------------------------------------
+inline void TFrameDemosaic::edgeRow(const TSrcPixel* up, const TSrcPixel* row, const TSrcPixel* down,
+                                    const uint16_t* greenUp, const uint16_t* green, const uint16_t* greenDown,
+                                    TDstPixel* dst, int width, TRowPhase phase) const
+{
+    int x = std::min(2,width);
+    edgePixels(up,row,down,greenUp,green,greenDown,dst,0,x,width,phase);
+
+    #if defined(ENA_SIMD_AVX512)
+    auto load512 = [](const uint16_t* ptr) { return _mm512_loadu_si512(ptr); };
+    auto mean512 = [&load512](const uint16_t* ptr) { return _mm512_avg_epu16(load512(ptr - 1),load512(ptr + 1)); };
+    auto addDiff512 = [](__m512i g, __m512i a, __m512i b) { return _mm512_subs_epu16(_mm512_adds_epu16(g,_mm512_subs_epu16(a,b)),_mm512_subs_epu16(b,a)); };
+    const __mmask32 odd = 0xAAAAAAAA;
+    for(; x + 32 < width; x += 32) {
+        const __m512i g     = load512(green + x);
+        const __m512i cG    = addDiff512(g,mean512(row + x),mean512(green + x));
+        const __m512i c2G   = addDiff512(g,_mm512_avg_epu16(load512(up + x),load512(down + x)),_mm512_avg_epu16(load512(greenUp + x),load512(greenDown + x)));
+        const __m512i c2C   = addDiff512(g,_mm512_avg_epu16(mean512(up + x),mean512(down + x)),_mm512_avg_epu16(mean512(greenUp + x),mean512(greenDown + x)));
+        const __m512i p     = load512(row + x);
+        if(phase.greenFirst) {
+            storeArgb(dst + x,_mm512_mask_blend_epi16(odd,cG,p),g,_mm512_mask_blend_epi16(odd,c2G,c2C),phase);
+        } else {
+            storeArgb(dst + x,_mm512_mask_blend_epi16(odd,p,cG),g,_mm512_mask_blend_epi16(odd,c2C,c2G),phase);
+        }
+    }
+    #endif
+
+    #if defined(ENA_SIMD_AVX2)
+    auto load256 = [](const uint16_t* ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); };
+    auto mean256 = [&load256](const uint16_t* ptr) { return _mm256_avg_epu16(load256(ptr - 1),load256(ptr + 1)); };
+    auto addDiff256 = [](__m256i g, __m256i a, __m256i b) { return _mm256_subs_epu16(_mm256_adds_epu16(g,_mm256_subs_epu16(a,b)),_mm256_subs_epu16(b,a)); };
+    for(; x + 16 < width; x += 16) {
+        const __m256i g     = load256(green + x);
+        const __m256i cG    = addDiff256(g,mean256(row + x),mean256(green + x));
+        const __m256i c2G   = addDiff256(g,_mm256_avg_epu16(load256(up + x),load256(down + x)),_mm256_avg_epu16(load256(greenUp + x),load256(greenDown + x)));
+        const __m256i c2C   = addDiff256(g,_mm256_avg_epu16(mean256(up + x),mean256(down + x)),_mm256_avg_epu16(mean256(greenUp + x),mean256(greenDown + x)));
+        const __m256i p     = load256(row + x);
+        if(phase.greenFirst) {
+            storeArgb(dst + x,_mm256_blend_epi16(cG,p,0xAA),g,_mm256_blend_epi16(c2G,c2C,0xAA),phase);
+        } else {
+            storeArgb(dst + x,_mm256_blend_epi16(p,cG,0xAA),g,_mm256_blend_epi16(c2C,c2G,0xAA),phase);
+        }
+    }
+    #endif
+
+    edgePixels(up,row,down,greenUp,green,greenDown,dst,x,width,width,phase);
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameDemosaic::apply(const TSrcView& src, const TDstView& dst)
+{
+    if(!src.isValid() || !dst.isValid() || (src.width() != dst.width()) || (src.height() != dst.height()) || (src.width() < 2) || (src.height() < 2)) {
+        return false;
+    }
+
+    const int width   = src.width();
+    const int height  = src.height();
+    const int stripes = TStripeExec::stripeNum(height,width,mParams.maxThreads);
+    if((mParams.method == EdgeAware) && (mScratch.size() < static_cast<size_t>(stripes))) {
+        mScratch.resize(stripes);
+    }
+
+    auto stripeFunc = [&](int stripeIdx, int rowBegin, int rowEnd) {
+        if(mParams.method == Bilinear) {
+            for(int y = rowBegin; y < rowEnd; ++y) {
+                bilinearRow(src.row(mirror(y - 1,height)),src.row(y),src.row(mirror(y + 1,height)),dst.row(y),width,rowPhase(y));
+            }
+            return;
+        }
+
+        //--- green rows y - 1, y, y + 1 in a ring of 3 rows
+        std::vector<uint16_t>& scratch = mScratch[stripeIdx];
+        scratch.resize(3*static_cast<size_t>(width));
+        auto greenBuf = [&](int y) { return &scratch[((y + 3) % 3)*static_cast<size_t>(width)]; };
+        auto makeGreen = [&](int y) {
+            const int srcY = mirror(y,height);
+            greenRow(src.row(mirror(srcY - 1,height)),src.row(srcY),src.row(mirror(srcY + 1,height)),greenBuf(y),width,rowPhase(srcY));
+        };
+
+        makeGreen(rowBegin - 1);
+        makeGreen(rowBegin);
+        for(int y = rowBegin; y < rowEnd; ++y) {
+            makeGreen(y + 1);
+            edgeRow(src.row(mirror(y - 1,height)),src.row(y),src.row(mirror(y + 1,height)),greenBuf(y - 1),greenBuf(y),greenBuf(y + 1),dst.row(y),width,rowPhase(y));
+        }
+    };
+    TStripeExec::run(height,stripes,stripeFunc);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameDemosaic::apply(TRawFramePtr srcPtr, TRawFramePtr dstPtr)
+{
+    TBaseFrame* src;
+    TBaseFrame* dst;
+    if(!srcPtr || !dstPtr || !(src = checkMsg<TBaseFrame>(srcPtr)) || !(dst = checkMsg<TBaseFrame>(dstPtr))) {
+        return false;
+    }
+    if(!apply(checkFrameView<TSrcView>(src),checkFrameView<TDstView>(dst))) {
+        return false;
+    }
+    dstPtr->setMsgId(srcPtr->msgId());
+    dstPtr->setNetPoints(srcPtr->netSrc(),srcPtr->netDst());
+    dst->metaInfo() = src->metaInfo();
+    return true;
+}
+
+#endif // FRAME_DEMOSAIC_H
@@ -0,0 +1,250 @@
+#if !defined(FRAME_HASH_H)
+#define FRAME_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "SimdDefs.h"
+
+//-----------------------------------------------------------------------------
+//  Streaming 64/128-bit content hash of XXH3 construction: 8 x 64-bit lanes,
+//  64-byte stripes, each lane accumulates lo32*hi32 of (data ^ key) plus data of
+//  the neighbour lane, lanes are scrambled every 16 stripes.
+//
+//  the result does not depend on how data are split between update() calls
+//  and is the same for AVX2 and scalar paths; it is not XXH3 compatible and
+//  not a cryptographic hash
+//-----------------------------------------------------------------------------
+class THash64
+{
+    public:
+        explicit THash64(uint64_t seed = 0) { reset(seed); }
+
+        void reset(uint64_t seed = 0);
+        void update(const void* data, size_t len);
+        uint64_t digest() const;
+        void digest128(uint64_t& lo, uint64_t& hi) const;
+
+        static uint64_t hash(const void* data, size_t len, uint64_t seed = 0)
+        {
+            THash64 hasher(seed);
+            hasher.update(data,len);
+            return hasher.digest();
+        }
+
+    private:
+        static const unsigned LaneNum         = 8;
+        static const unsigned StripeLen       = 64;
+        static const unsigned StripesPerBlock = 16;
+        static const unsigned SecretLen       = StripesPerBlock + 4*LaneNum;   // stripe keys, scramble, merge lo/hi keys, in uint64_t
+
+        static const uint64_t Prime32_1 = 0x9E3779B1u;
+        static const uint64_t Prime64_1 = 0x9E3779B185EBCA87ull;
+        static const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4Full;
+
+        static const uint64_t* secret();
+        static uint64_t read64(const uint8_t* ptr) { uint64_t val; std::memcpy(&val,ptr,sizeof(val)); return val; }
+        static uint64_t mulFold64(uint64_t a, uint64_t b);
+        static uint64_t avalanche(uint64_t h);
+        static void accumulate(uint64_t* acc, const uint8_t* data, size_t stripeNum, unsigned& stripeIdx);
+        uint64_t merge(const uint64_t* acc, const uint64_t* key, uint64_t start) const;
+        void finalAcc(uint64_t* acc) const;
+
+        uint64_t mAcc[LaneNum];
+        uint8_t  mBuf[StripeLen];
+        unsigned mBufLen;
+        unsigned mStripeIdx;        // stripe in the current block
+        uint64_t mTotalLen;
+        uint64_t mSeed;
+};
+
+//-----------------------------------------------------------------------------
+//  key material: splitmix64 sequence, made once
+//-----------------------------------------------------------------------------
+inline const uint64_t* THash64::secret()
+{
+    struct TSecret
+    {
+        uint64_t key[SecretLen];
+        TSecret()
+        {
+            uint64_t state = 0x243F6A8885A308D3ull;
+            for(unsigned n = 0; n < SecretLen; ++n) {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+                key[n] = z ^ (z >> 31);
+            }
+        }
+    };
+    static const TSecret secret;
+    return secret.key;
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t THash64::mulFold64(uint64_t a, uint64_t b)
+{
+    #if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = static_cast<unsigned __int128>(a)*b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+    #else
+    const uint64_t lolo = (a & 0xFFFFFFFF)*(b & 0xFFFFFFFF);
+    const uint64_t hilo = (a >> 32)*(b & 0xFFFFFFFF);
+    const uint64_t lohi = (a & 0xFFFFFFFF)*(b >> 32);
+    const uint64_t hihi = (a >> 32)*(b >> 32);
+    const uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+    const uint64_t hi = (hilo >> 32) + (cross >> 32) + hihi;
+    const uint64_t lo = (cross << 32) | (lolo & 0xFFFFFFFF);
+    return lo ^ hi;
+    #endif
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t THash64::avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+inline void THash64::reset(uint64_t seed)
+{
+    static const uint64_t InitAcc[LaneNum] = { 0xC2B2AE3Du, Prime64_1, Prime64_2, 0x165667B19E3779F9ull,
+                                               0x85EBCA77C2B2AE63ull, 0x85EBCA77u, 0x27D4EB2F165667C5ull, Prime32_1 };
+    for(unsigned lane = 0; lane < LaneNum; ++lane) {
+        mAcc[lane] = InitAcc[lane] + ((lane & 1) ? 0 - seed : seed);
+    }
+    mBufLen    = 0;
+    mStripeIdx = 0;
+    mTotalLen  = 0;
+    mSeed      = seed;
+}
+
+//-----------------------------------------------------------------------------
+inline void THash64::accumulate(uint64_t* acc, const uint8_t* data, size_t stripeNum, unsigned& stripeIdx)
+{
+    const uint64_t* key = secret();
+
+    #if defined(ENA_SIMD_AVX2)
+    __m256i acc0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i acc1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(Prime32_1));
+    for(size_t stripe = 0; stripe < stripeNum; ++stripe, data += StripeLen) {
+        const __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        const __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+        const __m256i k0 = _mm256_xor_si256(d0,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + stripeIdx)));
+        const __m256i k1 = _mm256_xor_si256(d1,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + stripeIdx + 4)));
+        acc0 = _mm256_add_epi64(acc0,_mm256_add_epi64(_mm256_mul_epu32(k0,_mm256_srli_epi64(k0,32)),_mm256_shuffle_epi32(d0,_MM_SHUFFLE(1,0,3,2))));
+        acc1 = _mm256_add_epi64(acc1,_mm256_add_epi64(_mm256_mul_epu32(k1,_mm256_srli_epi64(k1,32)),_mm256_shuffle_epi32(d1,_MM_SHUFFLE(1,0,3,2))));
+
+        if(++stripeIdx == StripesPerBlock) {
+            stripeIdx = 0;
+            __m256i* accPtr[2] = { &acc0, &acc1 };
+            for(int n = 0; n < 2; ++n) {
+                __m256i a = *accPtr[n];
+                a = _mm256_xor_si256(a,_mm256_srli_epi64(a,47));
+                a = _mm256_xor_si256(a,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + StripesPerBlock + 4*n)));
+                const __m256i lo = _mm256_mul_epu32(a,prime);
+                const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a,32),prime);
+                *accPtr[n] = _mm256_add_epi64(lo,_mm256_slli_epi64(hi,32));
+            }
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc),acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4),acc1);
+    #else
+    for(size_t stripe = 0; stripe < stripeNum; ++stripe, data += StripeLen) {
+        for(unsigned lane = 0; lane < LaneNum; ++lane) {
+            const uint64_t d = read64(data + 8*lane);
+            const uint64_t k = d ^ key[stripeIdx + lane];
+            acc[lane ^ 1] += d;
+            acc[lane]     += (k & 0xFFFFFFFF)*(k >> 32);
+        }
+        if(++stripeIdx == StripesPerBlock) {
+            stripeIdx = 0;
+            for(unsigned lane = 0; lane < LaneNum; ++lane) {
+                uint64_t a = acc[lane];
+                a ^= a >> 47;
+                a ^= key[StripesPerBlock + lane];
+                acc[lane] = a*Prime32_1;
+            }
+        }
+    }
+    #endif
+}
+
+//-----------------------------------------------------------------------------
+inline void THash64::update(const void* data, size_t len)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    mTotalLen += len;
+
+    //--- complete buffered stripe
+    if(mBufLen) {
+        const size_t chunk = (len < StripeLen - mBufLen) ? len : StripeLen - mBufLen;
+        std::memcpy(mBuf + mBufLen,src,chunk);
+        mBufLen += static_cast<unsigned>(chunk);
+        src     += chunk;
+        len     -= chunk;
+        if(mBufLen < StripeLen) {
+            return;
+        }
+        accumulate(mAcc,mBuf,1,mStripeIdx);
+        mBufLen = 0;
+    }
+
+    //--- whole stripes directly from the source
+    const size_t stripeNum = len/StripeLen;
+    accumulate(mAcc,src,stripeNum,mStripeIdx);
+    src += stripeNum*StripeLen;
+    len -= stripeNum*StripeLen;
+
+    std::memcpy(mBuf,src,len);
+    mBufLen = static_cast<unsigned>(len);
+}
+
+//-----------------------------------------------------------------------------
+//  the tail is zero padded, total length is merged into the result
+//-----------------------------------------------------------------------------
+inline void THash64::finalAcc(uint64_t* acc) const
+{
+    std::memcpy(acc,mAcc,sizeof(mAcc));
+    if(mBufLen) {
+        uint8_t  stripe[StripeLen] = { 0 };
+        unsigned stripeIdx = mStripeIdx;
+        std::memcpy(stripe,mBuf,mBufLen);
+        accumulate(acc,stripe,1,stripeIdx);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t THash64::merge(const uint64_t* acc, const uint64_t* key, uint64_t start) const
+{
+    uint64_t h = start;
+    for(unsigned n = 0; n < LaneNum/2; ++n) {
+        h += mulFold64(acc[2*n] ^ key[2*n],acc[2*n + 1] ^ key[2*n + 1]);
+    }
+    return avalanche(h);
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t THash64::digest() const
+{
+    uint64_t acc[LaneNum];
+    finalAcc(acc);
+    return merge(acc,secret() + StripesPerBlock + LaneNum,mTotalLen*Prime64_1 ^ mSeed);
+}
+
+//-----------------------------------------------------------------------------
+inline void THash64::digest128(uint64_t& lo, uint64_t& hi) const
+{
+    uint64_t acc[LaneNum];
+    finalAcc(acc);
+    lo = merge(acc,secret() + StripesPerBlock + LaneNum,mTotalLen*Prime64_1 ^ mSeed);
+    hi = merge(acc,secret() + StripesPerBlock + 2*LaneNum,~(mTotalLen*Prime64_2) ^ mSeed);
+}
+
+#endif // FRAME_HASH_H
@@ -0,0 +1,248 @@
+#if !defined(FRAME_PAR_H)
+#define FRAME_PAR_H
+
+#include <thread>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+//  Shared worker pool: a job is 'taskNum' independent tasks func(taskIdx);
+//  tasks are claimed by atomic index, so any number of jobs (frames) of any
+//  number of threads are spread over the same workers. The thread which
+//  calls run() executes tasks of its own job too, so nested run() from a task
+//  does not deadlock.
+//
+//  instance() is created on first use with threadNum() - 1 workers
+//-----------------------------------------------------------------------------
+class TWorkerPool
+{
+    public:
+        typedef std::function<void(int taskIdx)> TTaskFunc;
+        typedef std::function<void()>            TDoneFunc;
+
+        static int threadNum()
+        {
+            static const int threadNum = std::max(1u,std::thread::hardware_concurrency());
+            return threadNum;
+        }
+
+        static TWorkerPool& instance()
+        {
+            static TWorkerPool pool(threadNum() - 1);
+            return pool;
+        }
+
+        explicit TWorkerPool(int workerNum);
+        ~TWorkerPool();
+
+        int workerNum() const { return static_cast<int>(mWorkers.size()); }
+
+        //--- returns when all tasks are done
+        void run(int taskNum, const TTaskFunc& func);
+
+        //--- returns at once, done() is called by the thread which completes the last task
+        void submit(int taskNum, const TTaskFunc& func, const TDoneFunc& done);
+
+    private:
+        struct TJob
+        {
+            TJob(int num, const TTaskFunc& taskFunc, const TDoneFunc& doneFunc) : func(taskFunc), done(doneFunc), taskNum(num), next(0), remaining(num) {}
+
+            TTaskFunc        func;
+            TDoneFunc        done;
+            const int        taskNum;
+            std::atomic<int> next;          // next task to claim
+            std::atomic<int> remaining;     // tasks not completed
+        };
+        typedef std::shared_ptr<TJob> TJobPtr;
+
+        TWorkerPool(const TWorkerPool&);
+        TWorkerPool& operator=(const TWorkerPool&);
+
+        void enqueue(const TJobPtr& job);
+        bool execTask(const TJobPtr& job);
+        void retire(const TJobPtr& job);
+        void workerLoop();
+
+        std::mutex               mMutex;
+        std::condition_variable  mJobCond;
+        std::condition_variable  mDoneCond;
+        std::deque<TJobPtr>      mJobs;     // jobs with unclaimed tasks
+        std::vector<std::thread> mWorkers;
+        bool                     mExit;
+};
+
+//-----------------------------------------------------------------------------
+inline TWorkerPool::TWorkerPool(int workerNum) : mExit(false)
+{
+    mWorkers.reserve(std::max(0,workerNum));
+    for(int n = 0; n < workerNum; ++n) {
+        mWorkers.push_back(std::thread(&TWorkerPool::workerLoop,this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline TWorkerPool::~TWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mJobCond.notify_all();
+    for(size_t n = 0; n < mWorkers.size(); ++n) {
+        mWorkers[n].join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TWorkerPool::enqueue(const TJobPtr& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(job);
+    }
+    if(job->taskNum > 1) {
+        mJobCond.notify_all();
+    } else {
+        mJobCond.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  claims and executes one task, false when all tasks of the job are claimed
+//-----------------------------------------------------------------------------
+inline bool TWorkerPool::execTask(const TJobPtr& job)
+{
+    const int taskIdx = job->next.fetch_add(1);
+    if(taskIdx >= job->taskNum) {
+        return false;
+    }
+    job->func(taskIdx);
+    if(job->remaining.fetch_sub(1) == 1 && job->done) {
+        job->done();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline void TWorkerPool::retire(const TJobPtr& job)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    const std::deque<TJobPtr>::iterator it = std::find(mJobs.begin(),mJobs.end(),job);
+    if(it != mJobs.end()) {
+        mJobs.erase(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TWorkerPool::workerLoop()
+{
+    for(;;) {
+        TJobPtr job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobCond.wait(lock,[this]() { return mExit || !mJobs.empty(); });
+            if(mJobs.empty()) {
+                return;
+            }
+            job = mJobs.front();
+        }
+        while(execTask(job)) {}
+        retire(job);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TWorkerPool::run(int taskNum, const TTaskFunc& func)
+{
+    if(taskNum <= 0) {
+        return;
+    }
+    if(taskNum == 1 || mWorkers.empty()) {
+        for(int taskIdx = 0; taskIdx < taskNum; ++taskIdx) {
+            func(taskIdx);
+        }
+        return;
+    }
+
+    //--- the last task wakes the caller; notify under the mutex: the job may be gone right after the wait
+    TJobPtr job = std::make_shared<TJob>(taskNum,func,TDoneFunc());
+    job->done = [this]() { std::lock_guard<std::mutex> lock(mMutex); mDoneCond.notify_all(); };
+    enqueue(job);
+    while(execTask(job)) {}
+    retire(job);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCond.wait(lock,[&job]() { return job->remaining == 0; });
+}
+
+//-----------------------------------------------------------------------------
+inline void TWorkerPool::submit(int taskNum, const TTaskFunc& func, const TDoneFunc& done)
+{
+    if(taskNum <= 0) {
+        if(done) {
+            done();
+        }
+        return;
+    }
+    if(mWorkers.empty()) {
+        for(int taskIdx = 0; taskIdx < taskNum; ++taskIdx) {
+            func(taskIdx);
+        }
+        if(done) {
+            done();
+        }
+        return;
+    }
+    enqueue(std::make_shared<TJob>(taskNum,func,done));
+}
+
+//-----------------------------------------------------------------------------
+//  row stripes of frame region over TWorkerPool::instance()
+//-----------------------------------------------------------------------------
+class TStripeExec
+{
+    public:
+        static const int MinStripePixels = 256*1024;   // stripe work below this size is not worth a thread
+
+        static int threadNum() { return TWorkerPool::threadNum(); }
+
+        //--- number of horizontal stripes for frame region 'rows' x 'rowPixels'
+        static int stripeNum(int rows, int rowPixels, int maxThreads = 0)
+        {
+            const int threads = (maxThreads > 0) ? std::min(maxThreads,threadNum()) : threadNum();
+            const long long work = static_cast<long long>(rows)*rowPixels;
+            const int num = static_cast<int>(std::min<long long>(work/MinStripePixels,threads));
+            return std::max(1,std::min(num,rows));
+        }
+
+        //--- stripe bounds: stripe 'idx' from 'num' stripes covers rows [rowBegin,rowEnd)
+        static void stripeBounds(int rows, int num, int idx, int& rowBegin, int& rowEnd)
+        {
+            rowBegin = static_cast<int>((static_cast<long long>(rows)*idx)/num);
+            rowEnd   = static_cast<int>((static_cast<long long>(rows)*(idx + 1))/num);
+        }
+
+        //--- func(stripeIdx, rowBegin, rowEnd); the calling thread executes stripes too
+        template<typename TFunc> static void run(int rows, int num, TFunc& func)
+        {
+            if(num <= 1) {
+                func(0,0,rows);
+                return;
+            }
+
+            TWorkerPool::instance().run(num,[rows,num,&func](int idx) {
+                int rowBegin, rowEnd;
+                stripeBounds(rows,num,idx,rowBegin,rowEnd);
+                func(idx,rowBegin,rowEnd);
+            });
+        }
+};
+
+#endif // FRAME_PAR_H
@@ -0,0 +1,224 @@
+#if !defined(FRAME_PYRAMID_H)
+#define FRAME_PYRAMID_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "SimdDefs.h"
+#include "framepar.h"
+#include "frameview.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Preview pyramid of TRawFrame: levels 1, 2, 3 are 2x, 4x, 8x downscaled
+//  frames (TRawFrame or TScreenFrameGray) taken from the level pools.
+//
+//  the source is read once: it is processed in bands of 8 rows, 2x2 sums of
+//  level N are made from 2x2 sums of level N-1 while the band is in cache,
+//  so the levels are not affected by rounding of the upper levels
+//-----------------------------------------------------------------------------
+template<typename TLevelFrame = TRawFrame> class TFramePyramid
+{
+    public:
+        typedef TRawFrame::TPixel               TSrcPixel;
+        typedef typename TLevelFrame::TPixel    TLevelPixel;
+        typedef TFrameView<const TSrcPixel>     TSrcView;
+        typedef TFrameView<TLevelPixel>         TLevelView;
+
+        static const int LevelNum = 3;
+
+        enum TMode
+        {
+            Average,        // mean of 2^N x 2^N source pixels
+            Bin             // sum of 2^N x 2^N source pixels, saturated
+        };
+
+        //--- levelShift - bit depth reduction of level pixels, e.g. 8 for TRawFrame -> TScreenFrameGray
+        explicit TFramePyramid(TMode mode = Average, int levelShift = 0) : mMode(mode), mLevelShift(levelShift), mMaxThreads(0)
+        {
+            for(int level = 0; level < LevelNum; ++level) {
+                mLevelPool[level] = 0;
+            }
+        }
+
+        //--- level: 1 - 2x, 2 - 4x, 3 - 8x; pool 0 - the level is not produced
+        void setLevelPool(int level, TMsgWrapperPoolQueue* pool) { if(level >= 1 && level <= LevelNum) mLevelPool[level - 1] = pool; }
+        void setMaxThreads(int maxThreads) { mMaxThreads = maxThreads; }
+
+        static int levelWidth(int srcWidth, int level) { return srcWidth >> level; }
+        static int levelHeight(int srcHeight, int level) { return srcHeight >> level; }
+
+        //--- levels[level - 1] receives the level frame or empty pointer when the level is not produced
+        bool build(TRawFramePtr srcPtr, TRawFramePtr levels[LevelNum]);
+
+    private:
+        //---------------------------------------------------------------------
+        struct TLevel
+        {
+            TLevelView view;
+            int        width;
+            int        height;
+        };
+
+        //---
+        static void sumRowPairs(const TSrcPixel* row0, const TSrcPixel* row1, uint32_t* dst, int dstWidth);
+        static void sumRowPairs(const uint32_t* row0, const uint32_t* row1, uint32_t* dst, int dstWidth);
+        void storeRow(const uint32_t* sums, TLevelPixel* dst, int width, int level) const;
+
+        TMode                               mMode;
+        int                                 mLevelShift;
+        int                                 mMaxThreads;
+        TMsgWrapperPoolQueue*               mLevelPool[LevelNum];
+        std::vector<std::vector<uint32_t>>  mScratch;      // per stripe band sums
+};
+
+//-----------------------------------------------------------------------------
+template<typename TLevelFrame> void TFramePyramid<TLevelFrame>::sumRowPairs(const TSrcPixel* row0, const TSrcPixel* row1, uint32_t* dst, int dstWidth)
+{
+    int x = 0;
+
+    #if defined(ENA_SIMD_AVX2)
+    //--- each 32-bit lane holds a horizontal pixel pair
+    const __m256i loMask = _mm256_set1_epi32(0xFFFF);
+    for(; x + 8 <= dstWidth; x += 8) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2*x));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2*x));
+        const __m256i sa = _mm256_add_epi32(_mm256_and_si256(a,loMask),_mm256_srli_epi32(a,16));
+        const __m256i sb = _mm256_add_epi32(_mm256_and_si256(b,loMask),_mm256_srli_epi32(b,16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),_mm256_add_epi32(sa,sb));
+    }
+    #endif
+
+    for(; x < dstWidth; ++x) {
+        dst[x] = static_cast<uint32_t>(row0[2*x]) + row0[2*x + 1] + row1[2*x] + row1[2*x + 1];
+    }
+}
+
+//-----------------------------------------------------------------------------
+template<typename TLevelFrame> void TFramePyramid<TLevelFrame>::sumRowPairs(const uint32_t* row0, const uint32_t* row1, uint32_t* dst, int dstWidth)
+{
+    int x = 0;
+
+    #if defined(ENA_SIMD_AVX2)
+    for(; x + 8 <= dstWidth; x += 8) {
+        const __m256i a = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2*x)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2*x)));
+        const __m256i b = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2*x + 8)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2*x + 8)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),_mm256_permute4x64_epi64(_mm256_hadd_epi32(a,b),0xD8));
+    }
+    #endif
+
+    for(; x < dstWidth; ++x) {
+        dst[x] = row0[2*x] + row0[2*x + 1] + row1[2*x] + row1[2*x + 1];
+    }
+}
+
+//-----------------------------------------------------------------------------
+template<typename TLevelFrame> void TFramePyramid<TLevelFrame>::storeRow(const uint32_t* sums, TLevelPixel* dst, int width, int level) const
+{
+    const uint32_t maxPix = (1u << (8*sizeof(TLevelPixel))) - 1;
+    const int      shift  = ((mMode == Average) ? 2*level : 0) + mLevelShift;
+    const uint32_t round  = shift ? (1u << (shift - 1)) : 0;
+
+    for(int x = 0; x < width; ++x) {
+        dst[x] = static_cast<TLevelPixel>(std::min((sums[x] + round) >> shift,maxPix));
+    }
+}
+
+//-----------------------------------------------------------------------------
+template<typename TLevelFrame> bool TFramePyramid<TLevelFrame>::build(TRawFramePtr srcPtr, TRawFramePtr levels[LevelNum])
+{
+    TBaseFrame* src;
+    if(!srcPtr || !(src = checkMsg<TBaseFrame>(srcPtr))) {
+        return false;
+    }
+    const TSrcView srcView = checkFrameView<TSrcView>(src);
+    if(!srcView.isValid()) {
+        return false;
+    }
+
+    //--- level frames
+    const int srcWidth = srcView.width();
+    TLevel level[LevelNum];
+    bool   status = true;
+    for(int n = 0; n < LevelNum; ++n) {
+        levels[n].reset();
+        level[n].view   = TLevelView();
+        level[n].width  = levelWidth(srcWidth,n + 1);
+        level[n].height = levelHeight(srcView.height(),n + 1);
+        if(!mLevelPool[n] || !level[n].width || !level[n].height) {
+            continue;
+        }
+
+        TBaseFrame* frame;
+        if(!mLevelPool[n]->get(levels[n])) {
+            status = false;
+            continue;
+        }
+        if(!(frame = checkMsg<TBaseFrame>(levels[n])) || !(level[n].view = checkFrameView<TLevelView>(frame)).isValid() ||
+           (frame->width() != level[n].width) || (frame->height() != level[n].height)) {
+            #if !defined(MSG_SELF_RELEASE)
+                TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(levels[n]);
+            #endif
+            levels[n].reset();
+            level[n].view = TLevelView();
+            status = false;
+            continue;
+        }
+        levels[n]->setMsgId(srcPtr->msgId());
+        levels[n]->setNetPoints(srcPtr->netSrc(),srcPtr->netDst());
+        frame->metaInfo() = src->metaInfo();
+    }
+    if(!level[0].height) {
+        return false;
+    }
+
+    //--- band: 8 source rows -> 4 + 2 + 1 level rows
+    const int bandNum = (level[0].height + 3)/4;
+    const int stripes = TStripeExec::stripeNum(bandNum,8*srcWidth,mMaxThreads);
+    const size_t scratchSize = 4*level[0].width + 2*level[1].width + level[2].width;
+    if(mScratch.size() < static_cast<size_t>(stripes)) {
+        mScratch.resize(stripes);
+    }
+
+    auto stripeFunc = [&](int stripeIdx, int bandBegin, int bandEnd) {
+        std::vector<uint32_t>& scratch = mScratch[stripeIdx];
+        if(scratch.size() < scratchSize) {
+            scratch.resize(scratchSize);
+        }
+        uint32_t* sum1 = &scratch[0];
+        uint32_t* sum2 = sum1 + 4*level[0].width;
+        uint32_t* sum3 = sum2 + 2*level[1].width;
+
+        for(int band = bandBegin; band < bandEnd; ++band) {
+            const int rows1 = std::min(4,level[0].height - 4*band);
+            const int rows2 = std::min(2,level[1].height - 2*band);
+            const int rows3 = std::min(1,level[2].height - band);
+
+            for(int row = 0; row < rows1; ++row) {
+                sumRowPairs(srcView.row(8*band + 2*row),srcView.row(8*band + 2*row + 1),sum1 + row*level[0].width,level[0].width);
+                if(level[0].view.isValid()) {
+                    storeRow(sum1 + row*level[0].width,level[0].view.row(4*band + row),level[0].width,1);
+                }
+            }
+            for(int row = 0; row < rows2; ++row) {
+                sumRowPairs(sum1 + 2*row*level[0].width,sum1 + (2*row + 1)*level[0].width,sum2 + row*level[1].width,level[1].width);
+                if(level[1].view.isValid()) {
+                    storeRow(sum2 + row*level[1].width,level[1].view.row(2*band + row),level[1].width,2);
+                }
+            }
+            for(int row = 0; row < rows3; ++row) {
+                sumRowPairs(sum2,sum2 + level[1].width,sum3,level[2].width);
+                if(level[2].view.isValid()) {
+                    storeRow(sum3,level[2].view.row(band),level[2].width,3);
+                }
+            }
+        }
+    };
+    TStripeExec::run(bandNum,stripes,stripeFunc);
+    return status;
+}
+
+#endif // FRAME_PYRAMID_H
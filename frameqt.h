@@ -1,6 +1,8 @@
 #if !defined(FRAME_QT_H)
 #define FRAME_QT_H
 
+#include <cstring>
+
 #include <QtGui/QImage>
 
 #include "frame.h"
@@ -46,8 +48,14 @@ template <> class TQtImageFormat<QImage::Format_ARGB32>
 
 
 //-----------------------------------------------------------------------------
+//  QImage is a view of TRawBuf aligned pixel memory: lines are padded to
+//  LineAlignment and the buffer is reallocated only when the frame grows.
+//  getImage() result is to be drawn in place: a copy of it kept (QImage
+//  assignment shares the pixels, use QImage::copy()) makes the next write
+//  through the frame image (bits(), QPainter) detach it from the buffer. The
+//  view is restored, with the written pixels, on getImage()/getPixelBuf()
 //-----------------------------------------------------------------------------
-template <QImage::Format Format, typename T2 = uint16_t> class TQtFrameImpl
+template <QImage::Format Format, typename T2 = uint16_t> class TQtFrameImpl : public TRawBuf
 {
 	friend class TFrame<TQtFrameImpl>;
 
@@ -55,7 +63,9 @@ template <QImage::Format Format, typename T2 = uint16_t> class TQtFrameImpl
 		typedef typename TQtImageFormat<Format>::TPixel TPixel;
         typedef          T2                             TMetaDataElem;
 
-        bool operator==(const TQtFrameImpl<Format>& right) { return *mImage == *(right.mImage); }
+        static const int LineAlignment = 64;
+
+        bool operator==(const TQtFrameImpl<Format>& right) { return mImage == right.mImage; }
 
 	private:
 		//---------------------------------------------------------------------
@@ -71,29 +81,48 @@ template <QImage::Format Format, typename T2 = uint16_t> class TQtFrameImpl
 		};
 
 		//---------------------------------------------------------------------
-		static void frameCleanUp(void* info) { delete [] reinterpret_cast<uchar*>(info); /* qDebug() << "frame cleanup"; */}
+        static int lineSize(int width) { return ((width*sizeof(TPixel) + LineAlignment - 1)/LineAlignment)*LineAlignment; }
 
-		int width() const { return mImage->width(); }
-		int height() const { return mImage->height(); }
+		int width() const { return mImage.width(); }
+		int height() const { return mImage.height(); }
                 int pixelSize() const { return sizeof(TPixel); }
-                int colorCount() const { return mImage->colorCount(); }
+                int colorCount() const { return mImage.colorCount(); }
+                int bytesPerLine() const { return mImage.bytesPerLine(); }
 		bool resizeImg(int width, int height)
 		{
-			delete mImage;
-			uchar* dataBuf = new uchar [width*height*sizeof(TPixel)];
-			mImage = new QImage(dataBuf,width,height,Format,frameCleanUp,dataBuf);
-			TQtImageFormat<Format>::initImage(mImage);
+			const size_t byteSize = static_cast<size_t>(lineSize(width))*height;
+			if(byteSize > byteBufSize()) {
+				TRawBuf::resizeBuf(byteSize,1);
+			}
+			mImage = QImage(TRawBuf::getDataBuf<uchar>(),width,height,lineSize(width),Format);
+			TQtImageFormat<Format>::initImage(&mImage);
 			return true;
 		}
-		QImage* getImage() { return mImage; }
-        void* getPixelBuf(int pixelSize) { return (pixelSize == sizeof(typename TQtImageFormat<Format>::TPixel)) ? mImage->bits() : 0; }
+		QImage* getImage() { attachImage(); return &mImage; }
+        void* getPixelBuf(int pixelSize) { attachImage(); return (pixelSize == sizeof(typename TQtImageFormat<Format>::TPixel)) ? TRawBuf::getDataBuf<uchar>() : 0; }
+
+		//--- the image detached from the buffer by a write while shared: pixels are taken back into the buffer
+		void attachImage()
+		{
+			uchar* buf = TRawBuf::getDataBuf<uchar>();
+			if(mImage.constBits() == buf) {
+				return;
+			}
+			const QImage detached = mImage;
+			mImage = QImage(buf,detached.width(),detached.height(),lineSize(detached.width()),Format);
+			TQtImageFormat<Format>::initImage(&mImage);
+			const size_t lineLen = static_cast<size_t>(detached.width())*sizeof(TPixel);
+			for(int i = 0; i < detached.height(); ++i) {
+				std::memcpy(mImage.scanLine(i),detached.constScanLine(i),lineLen);
+			}
+		}
 
 		//---
-		TQtFrameImpl(int width, int height) : mImage(0) { resizeImg(width, height); }
-		~TQtFrameImpl() { delete mImage; /*qDebug() << "~TQtFrameImpl"; */}
+		TQtFrameImpl(int width, int height) : TRawBuf(static_cast<size_t>(lineSize(width))*height,1) { resizeImg(width, height); }
+		~TQtFrameImpl() { /*qDebug() << "~TQtFrameImpl"; */}
 		TQtFrameImpl<Format>& operator=(const TQtFrameImpl<Format>&) { qDebug() << "TQtFrameImpl<Format>& operator="; return *this; }
 
-		QImage* mImage;
+		QImage mImage;
 };
 
 
@@ -0,0 +1,619 @@
+#if !defined(FRAME_REC_H)
+#define FRAME_REC_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tthread.h"
+#include "frameview.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Frame record container (Linux)
+//
+//  segment file "<baseName>.NNNN.frec":
+//      [TFileHeader][TRecordHeader][serialized frame]...[TRecordHeader][serialized frame]
+//      records start at RecordAlignment, serialized frame is serializeFrame() layout
+//
+//  side index file "<baseName>.NNNN.fidx":
+//      [TFileHeader][TIndexEntry]...[TIndexEntry]
+//      written when the segment is closed; if it is missing (writer crash) the
+//      reader rebuilds the index by record headers
+//-----------------------------------------------------------------------------
+class TFrameRecFormat
+{
+    public:
+        static const uint32_t SegmentMagic    = 0x43455246;   // 'FREC'
+        static const uint32_t IndexMagic      = 0x58444946;   // 'FIDX'
+        static const uint32_t RecordMagic     = 0x304D5246;   // 'FRM0'
+        static const uint32_t Version         = 1;
+        static const uint32_t RecordAlignment = 64;
+        static const uint32_t IoBlockSize     = 4096;         // O_DIRECT granularity
+
+        //---
+        struct TFileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t segmentIdx;
+            uint32_t headerSize;        // offset of the first record (segment) or entry (index)
+        };
+
+        //---
+        struct TRecordHeader
+        {
+            uint32_t magic;
+            uint32_t frameLen;          // serialized frame length
+            uint32_t frameNum;          // msgId
+            uint32_t reserved;
+            uint64_t timestamp;         // ns, system clock at write, non-decreasing (see TFrameRecorder::writeFrame())
+            uint64_t reserved2;
+        };
+
+        //---
+        struct TIndexEntry
+        {
+            uint64_t timestamp;
+            uint64_t offset;            // TRecordHeader offset in segment
+            uint32_t frameLen;
+            uint32_t frameNum;
+        };
+
+        static uint64_t alignUp(uint64_t val, uint64_t alignment) { return (val + alignment - 1) & ~(alignment - 1); }
+        static uint64_t timestampNow() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); }
+
+        static std::string segmentName(const std::string& baseName, int segmentIdx) { return fileName(baseName,segmentIdx,"frec"); }
+        static std::string indexName(const std::string& baseName, int segmentIdx) { return fileName(baseName,segmentIdx,"fidx"); }
+
+
+    private:
+        static std::string fileName(const std::string& baseName, int segmentIdx, const char* ext)
+        {
+            char suffix[32];
+            std::snprintf(suffix,sizeof(suffix),".%04d.%s",segmentIdx,ext);
+            return baseName + suffix;
+        }
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class TFrameRecorder : public TThread
+{
+    public:
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : segmentSize(4ull << 30), stagingSize(16 << 20), queueDepth(64), directIo(true), enaHash(false) {}
+
+            std::string baseName;       // segment files: baseName.NNNN.frec
+            uint64_t    segmentSize;    // preallocated segment size, next segment is opened when it is full
+            uint32_t    stagingSize;    // aligned write buffer, one write() per filled buffer; grows up to MaxStagingFactor times for large records
+            int         queueDepth;     // frames waiting for writer thread, record() drops frames above it
+            bool        directIo;       // O_DIRECT (falls back to buffered io when not supported)
+            bool        enaHash;        // frames are stored with content hash (see frameHash())
+        };
+
+        //---------------------------------------------------------------------
+        struct TStat
+        {
+            uint64_t frames;
+            uint64_t dropped;
+            uint64_t bytes;
+            uint32_t segments;
+            uint32_t writeErrors;
+        };
+
+        explicit TFrameRecorder(const TParams& params) : TThread(L"FrameRecorder"), mParams(params), mFd(-1), mDirectIo(false), mSegmentIdx(-1),
+                                                         mFileLen(0), mFlushedLen(0), mStaging(0), mStagingSize(0), mLastTimestamp(0), mOpen(false),
+                                                         mFrames(0), mDropped(0), mBytes(0), mSegments(0), mWriteErrors(0)
+        {
+        }
+        ~TFrameRecorder() { if(!stop()) { wait(); stop(); } free(mStaging); }
+
+        //--- once: a stopped recorder is not opened again (the thread exit flag is not reset)
+        bool open();
+        bool stop();
+        bool record(TRawFramePtr framePtr);
+        TStat stat() const;
+
+    private:
+        virtual bool onExec();
+        void writeFrame(TRawFramePtr framePtr);
+        bool openSegment();
+        void closeSegment();
+        bool flush(bool final);
+        bool reserveStaging(uint64_t len);
+
+        static const unsigned IdleSleepUs      = 200;
+        static const uint64_t MaxStagingFactor = 4;
+
+        TParams                                 mParams;
+        TMsgWrapperPoolQueue                    mQueue;
+        int                                     mFd;
+        bool                                    mDirectIo;
+        int                                     mSegmentIdx;
+        uint64_t                                mFileLen;       // logical segment length
+        uint64_t                                mFlushedLen;    // segment bytes written to file, staging holds [mFlushedLen,mFileLen)
+        uint8_t*                                mStaging;
+        uint64_t                                mStagingSize;
+        std::vector<TFrameRecFormat::TIndexEntry> mIndex;
+        uint64_t                                mLastTimestamp;
+
+        //--- shared with record()/stat() of the producer thread
+        std::atomic<bool>                       mOpen;          // segment is open
+        std::atomic<uint64_t>                   mFrames;
+        std::atomic<uint64_t>                   mDropped;
+        std::atomic<uint64_t>                   mBytes;
+        std::atomic<uint32_t>                   mSegments;
+        std::atomic<uint32_t>                   mWriteErrors;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::open()
+{
+    if(mOpen) {
+        return true;
+    }
+    if(threadExit()) {
+        return false;
+    }
+    if(!reserveStaging(mParams.stagingSize) || !openSegment()) {
+        return false;
+    }
+    start(QThread::HighPriority);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  the writer thread is finished also when the segment is lost (failed
+//  rollover); the segment is closed after the thread exit only: false - the
+//  thread is still writing after the wait, stop() may be called again
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::stop()
+{
+    if(!threadExit()) {
+        threadFinish();     // writer thread exits when the queue is empty
+    }
+    if(isRunning()) {
+        qDebug() << "[ERROR] TFrameRecorder: writer thread is busy, segment is not closed";
+        return false;
+    }
+    closeSegment();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::record(TRawFramePtr framePtr)
+{
+    if(!framePtr || !mOpen || threadExit() || (static_cast<int>(mQueue.size()) >= mParams.queueDepth)) {
+        ++mDropped;
+        return false;
+    }
+    mQueue.put(framePtr);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline TFrameRecorder::TStat TFrameRecorder::stat() const
+{
+    TStat stat;
+    stat.frames      = mFrames;
+    stat.dropped     = mDropped;
+    stat.bytes       = mBytes;
+    stat.segments    = mSegments;
+    stat.writeErrors = mWriteErrors;
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::onExec()
+{
+    TRawFramePtr framePtr;
+    if(!mQueue.get(framePtr)) {
+        if(threadExit()) {
+            return true;
+        }
+        QThread::usleep(IdleSleepUs);
+        return false;
+    }
+    writeFrame(framePtr);
+    #if !defined(MSG_SELF_RELEASE)
+        TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(framePtr);
+    #endif
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameRecorder::writeFrame(TRawFramePtr framePtr)
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(framePtr);
+    if(!frame) {
+        return;
+    }
+    if(!mOpen) {
+        ++mDropped;         // queued before a failed rollover
+        return;
+    }
+
+    const uint64_t recordLen = TFrameRecFormat::alignUp(sizeof(TFrameRecFormat::TRecordHeader) + serialFrameMaxSize(frame),
+                                                        TFrameRecFormat::RecordAlignment);
+    if((mFileLen > TFrameRecFormat::IoBlockSize) && (mFileLen + recordLen > mParams.segmentSize)) {
+        closeSegment();
+        if(!openSegment()) {
+            ++mWriteErrors;
+            return;
+        }
+    }
+    if((mFileLen - mFlushedLen + recordLen > mStagingSize) && !flush(false)) {
+        return;
+    }
+    if(!reserveStaging(mFileLen - mFlushedLen + recordLen)) {
+        ++mWriteErrors;
+        return;
+    }
+
+    //--- record is serialized directly into the write buffer
+    uint8_t* dst = mStaging + (mFileLen - mFlushedLen);
+    TFrameRecFormat::TRecordHeader* header = reinterpret_cast<TFrameRecFormat::TRecordHeader*>(dst);
+    const uint32_t frameLen = serializeFrame<TBaseFrame>(framePtr,dst + sizeof(*header),static_cast<uint32_t>(recordLen - sizeof(*header)),
+                                                         mParams.enaHash);
+    if(!frameLen) {
+        ++mWriteErrors;
+        return;
+    }
+
+    //--- the reader searches timestamps by binary search: a step back of the system clock is clamped
+    mLastTimestamp = std::max(TFrameRecFormat::timestampNow(),mLastTimestamp);
+    std::memset(header,0,sizeof(*header));
+    header->magic     = TFrameRecFormat::RecordMagic;
+    header->frameLen  = frameLen;
+    header->frameNum  = framePtr->msgId();
+    header->timestamp = mLastTimestamp;
+    std::memset(dst + sizeof(*header) + frameLen,0,recordLen - sizeof(*header) - frameLen);
+
+    TFrameRecFormat::TIndexEntry entry = { header->timestamp, mFileLen, frameLen, header->frameNum };
+    mIndex.push_back(entry);
+    mFileLen += recordLen;
+    ++mFrames;
+}
+
+//-----------------------------------------------------------------------------
+//  false above MaxStagingFactor*stagingSize: the record is dropped
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::reserveStaging(uint64_t len)
+{
+    len = TFrameRecFormat::alignUp(len,TFrameRecFormat::IoBlockSize);
+    if(len <= mStagingSize) {
+        return true;
+    }
+    const uint64_t maxSize = TFrameRecFormat::alignUp(std::max<uint64_t>(mParams.stagingSize,TFrameRecFormat::IoBlockSize),TFrameRecFormat::IoBlockSize);
+    if(len > MaxStagingFactor*maxSize) {
+        return false;
+    }
+
+    void* buf = 0;
+    if(posix_memalign(&buf,TFrameRecFormat::IoBlockSize,len)) {
+        return false;
+    }
+    if(mStaging) {
+        std::memcpy(buf,mStaging,mFileLen - mFlushedLen);
+        free(mStaging);
+    }
+    mStaging     = static_cast<uint8_t*>(buf);
+    mStagingSize = len;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  writes whole io blocks of the write buffer, the tail is kept; final flush
+//  pads the tail to io block and restores logical file length
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::flush(bool final)
+{
+    const uint64_t stagedLen = mFileLen - mFlushedLen;
+    const uint64_t writeLen  = final ? TFrameRecFormat::alignUp(stagedLen,TFrameRecFormat::IoBlockSize)
+                                     : stagedLen & ~static_cast<uint64_t>(TFrameRecFormat::IoBlockSize - 1);
+    if(!writeLen) {
+        return true;
+    }
+    std::memset(mStaging + stagedLen,0,writeLen > stagedLen ? writeLen - stagedLen : 0);
+
+    for(uint64_t written = 0; written < writeLen; ) {
+        const ssize_t res = pwrite(mFd,mStaging + written,writeLen - written,mFlushedLen + written);
+        if(res <= 0) {
+            ++mWriteErrors;
+            return false;
+        }
+        written += res;
+    }
+    mBytes += writeLen;
+
+    if(final) {
+        mFlushedLen = mFileLen;
+        if(ftruncate(mFd,mFileLen)) {
+            ++mWriteErrors;
+        }
+    } else {
+        mFlushedLen += writeLen;
+        std::memmove(mStaging,mStaging + writeLen,stagedLen - writeLen);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecorder::openSegment()
+{
+    const std::string name = TFrameRecFormat::segmentName(mParams.baseName,++mSegmentIdx);
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    #if defined(O_DIRECT)
+    mDirectIo = mParams.directIo;
+    mFd = mDirectIo ? ::open(name.c_str(),flags | O_DIRECT,0644) : -1;
+    #endif
+    if(mFd < 0) {
+        mDirectIo = false;
+        mFd = ::open(name.c_str(),flags,0644);
+    }
+    if(mFd < 0) {
+        qDebug() << "[ERROR] TFrameRecorder: unable to open" << name.c_str();
+        return false;
+    }
+
+    #if defined(FALLOC_FL_KEEP_SIZE)
+    fallocate(mFd,FALLOC_FL_KEEP_SIZE,0,mParams.segmentSize);   // not supported by some file systems: not an error
+    #endif
+
+    //--- segment header occupies the first io block
+    mFileLen = mFlushedLen = 0;
+    mIndex.clear();
+    std::memset(mStaging,0,TFrameRecFormat::IoBlockSize);
+    TFrameRecFormat::TFileHeader* header = reinterpret_cast<TFrameRecFormat::TFileHeader*>(mStaging);
+    header->magic      = TFrameRecFormat::SegmentMagic;
+    header->version    = TFrameRecFormat::Version;
+    header->segmentIdx = mSegmentIdx;
+    header->headerSize = TFrameRecFormat::IoBlockSize;
+    mFileLen = TFrameRecFormat::IoBlockSize;
+    ++mSegments;
+    mOpen = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameRecorder::closeSegment()
+{
+    if(mFd < 0) {
+        return;
+    }
+    mOpen = false;
+    flush(true);
+    ::close(mFd);
+    mFd = -1;
+
+    //--- side index
+    const std::string name = TFrameRecFormat::indexName(mParams.baseName,mSegmentIdx);
+    FILE* file = std::fopen(name.c_str(),"wb");
+    if(!file) {
+        ++mWriteErrors;
+        return;
+    }
+    TFrameRecFormat::TFileHeader header = { TFrameRecFormat::IndexMagic, TFrameRecFormat::Version, static_cast<uint32_t>(mSegmentIdx), sizeof(header) };
+    bool ok = std::fwrite(&header,sizeof(header),1,file) == 1;
+    if(!mIndex.empty()) {
+        ok = ok && (std::fwrite(&mIndex[0],sizeof(mIndex[0]),mIndex.size(),file) == mIndex.size());
+    }
+    if((std::fclose(file) != 0) || !ok) {
+        ++mWriteErrors;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  zero-copy view of a recorded frame, valid while TFrameRecReader is open
+//-----------------------------------------------------------------------------
+struct TFrameRecView
+{
+    const uint8_t* data;        // serialized frame (serializeFrame() layout)
+    uint32_t       len;
+    uint32_t       frameNum;
+    uint64_t       timestamp;
+    int            width;
+    int            height;
+    int            pixelSize;
+    const uint8_t* pixels;
+
+    template<typename T> TFrameView<const T> pixelView() const
+    {
+        return (sizeof(T) == static_cast<size_t>(pixelSize)) ? TFrameView<const T>(reinterpret_cast<const T*>(pixels),width,height) : TFrameView<const T>();
+    }
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class TFrameRecReader
+{
+    public:
+        TFrameRecReader() {}
+        ~TFrameRecReader() { close(); }
+
+        bool open(const std::string& baseName);
+        void close();
+
+        int frameCount() const { return static_cast<int>(mIndex.size()); }
+        int findFrameNum(uint32_t frameNum) const;
+        int findTimestamp(uint64_t timestamp) const;        // first frame with timestamp >= 'timestamp'
+        uint64_t timestamp(int idx) const { return mIndex[idx].entry.timestamp; }
+        bool frameView(int idx, TFrameRecView& view) const;
+        bool readFrame(int idx, TRawFramePtr framePtr, TFrameSerialStat* stat = 0) const;
+
+    private:
+        //---------------------------------------------------------------------
+        struct TSegment
+        {
+            const uint8_t* data;
+            uint64_t       len;
+        };
+
+        struct TEntry
+        {
+            TFrameRecFormat::TIndexEntry entry;
+            int                          segmentIdx;
+        };
+
+        bool loadIndex(const std::string& baseName, int segmentIdx);
+        void scanIndex(int segmentIdx);
+
+        std::vector<TSegment>    mSegments;
+        std::vector<TEntry>      mIndex;
+        std::map<uint32_t,int>   mFrameNumIdx;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecReader::open(const std::string& baseName)
+{
+    close();
+    for(int segmentIdx = 0; ; ++segmentIdx) {
+        const int fd = ::open(TFrameRecFormat::segmentName(baseName,segmentIdx).c_str(),O_RDONLY);
+        if(fd < 0) {
+            break;
+        }
+
+        struct stat fileStat;
+        void* data = MAP_FAILED;
+        if((fstat(fd,&fileStat) == 0) && (fileStat.st_size >= static_cast<off_t>(sizeof(TFrameRecFormat::TFileHeader)))) {
+            data = mmap(0,fileStat.st_size,PROT_READ,MAP_SHARED,fd,0);
+        }
+        ::close(fd);
+        if(data == MAP_FAILED) {
+            break;
+        }
+
+        const TFrameRecFormat::TFileHeader* header = static_cast<const TFrameRecFormat::TFileHeader*>(data);
+        TSegment segment = { static_cast<const uint8_t*>(data), static_cast<uint64_t>(fileStat.st_size) };
+        mSegments.push_back(segment);
+        if((header->magic != TFrameRecFormat::SegmentMagic) || (header->version != TFrameRecFormat::Version)) {
+            close();
+            return false;
+        }
+        madvise(data,fileStat.st_size,MADV_SEQUENTIAL);
+        if(!loadIndex(baseName,segmentIdx)) {
+            scanIndex(segmentIdx);
+        }
+    }
+
+    for(size_t idx = 0; idx < mIndex.size(); ++idx) {
+        mFrameNumIdx.insert(std::make_pair(mIndex[idx].entry.frameNum,static_cast<int>(idx)));
+    }
+    return !mSegments.empty();
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameRecReader::close()
+{
+    for(size_t n = 0; n < mSegments.size(); ++n) {
+        munmap(const_cast<uint8_t*>(mSegments[n].data),mSegments[n].len);
+    }
+    mSegments.clear();
+    mIndex.clear();
+    mFrameNumIdx.clear();
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecReader::loadIndex(const std::string& baseName, int segmentIdx)
+{
+    FILE* file = std::fopen(TFrameRecFormat::indexName(baseName,segmentIdx).c_str(),"rb");
+    if(!file) {
+        return false;
+    }
+
+    TFrameRecFormat::TFileHeader header;
+    bool ok = (std::fread(&header,sizeof(header),1,file) == 1) && (header.magic == TFrameRecFormat::IndexMagic) &&
+              (header.version == TFrameRecFormat::Version) && (header.headerSize == sizeof(header));
+    const size_t indexBegin = mIndex.size();
+    TEntry entry;
+    entry.segmentIdx = segmentIdx;
+    while(ok && (std::fread(&entry.entry,sizeof(entry.entry),1,file) == 1)) {
+        const uint64_t len = mSegments[segmentIdx].len;
+        if((entry.entry.offset > len) || (len - entry.entry.offset < sizeof(TFrameRecFormat::TRecordHeader)) ||
+           (entry.entry.frameLen > len - entry.entry.offset - sizeof(TFrameRecFormat::TRecordHeader))) {
+            ok = false;
+            break;
+        }
+        mIndex.push_back(entry);
+    }
+    std::fclose(file);
+    if(!ok) {
+        mIndex.resize(indexBegin);
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameRecReader::scanIndex(int segmentIdx)
+{
+    const TSegment& segment = mSegments[segmentIdx];
+    uint64_t offset = reinterpret_cast<const TFrameRecFormat::TFileHeader*>(segment.data)->headerSize;
+    while(offset + sizeof(TFrameRecFormat::TRecordHeader) <= segment.len) {
+        const TFrameRecFormat::TRecordHeader* header = reinterpret_cast<const TFrameRecFormat::TRecordHeader*>(segment.data + offset);
+        if((header->magic != TFrameRecFormat::RecordMagic) || (offset + sizeof(*header) + header->frameLen > segment.len)) {
+            break;
+        }
+        TEntry entry = { { header->timestamp, offset, header->frameLen, header->frameNum }, segmentIdx };
+        mIndex.push_back(entry);
+        offset += TFrameRecFormat::alignUp(sizeof(*header) + header->frameLen,TFrameRecFormat::RecordAlignment);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline int TFrameRecReader::findFrameNum(uint32_t frameNum) const
+{
+    std::map<uint32_t,int>::const_iterator it = mFrameNumIdx.find(frameNum);
+    return (it != mFrameNumIdx.end()) ? it->second : -1;
+}
+
+//-----------------------------------------------------------------------------
+inline int TFrameRecReader::findTimestamp(uint64_t timestamp) const
+{
+    std::vector<TEntry>::const_iterator it = std::lower_bound(mIndex.begin(),mIndex.end(),timestamp,
+                                                              [](const TEntry& entry, uint64_t val) { return entry.entry.timestamp < val; });
+    return (it != mIndex.end()) ? static_cast<int>(it - mIndex.begin()) : -1;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecReader::frameView(int idx, TFrameRecView& view) const
+{
+    if(idx < 0 || idx >= frameCount()) {
+        return false;
+    }
+    const TEntry& entry = mIndex[idx];
+    const uint8_t* data = mSegments[entry.segmentIdx].data + entry.entry.offset + sizeof(TFrameRecFormat::TRecordHeader);
+    view.data      = data;
+    view.len       = entry.entry.frameLen;
+    view.frameNum  = entry.entry.frameNum;
+    view.timestamp = entry.entry.timestamp;
+    const uint32_t pixelOffset = serialFrameGeometry(data,view.len,view.width,view.height,view.pixelSize);
+    view.pixels    = data + pixelOffset;
+    return pixelOffset != 0;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRecReader::readFrame(int idx, TRawFramePtr framePtr, TFrameSerialStat* stat) const
+{
+    TFrameRecView view;
+    if(!frameView(idx,view)) {
+        return false;
+    }
+    return deserializeFrame<TBaseFrame>(framePtr,const_cast<uint8_t*>(view.data),view.len,stat);
+}
+
+#endif // FRAME_REC_H
@@ -0,0 +1,265 @@
+#if !defined(FRAME_REPLAY_H)
+#define FRAME_REPLAY_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+#include "tthread.h"
+#include "framerec.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Replay source: frames of a recorded file (see TFrameRecorder) or of a
+//  synthetic generator are loaded into frames of 'pool' and put to 'dst' queue,
+//  i.e. the replay takes place of a camera in the pipeline
+//
+//  OriginalTiming, FixedRate - the frame which is due when the pool is empty is
+//                              dropped, the schedule is kept
+//  AsFastAsPossible          - replay waits for the pool, no frames are dropped
+//-----------------------------------------------------------------------------
+class TFrameReplay : public TThread
+{
+    public:
+        enum TMode
+        {
+            OriginalTiming,
+            FixedRate,
+            AsFastAsPossible
+        };
+
+        //--- generator fills pixels/metainfo of the frame, msgId is set by replay
+        typedef std::function<void(TBaseFrame* frame, uint32_t frameNum)> TGenerator;
+
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : mode(OriginalTiming), frameRate(30.0), loops(1) {}
+
+            TMode  mode;
+            double frameRate;       // FixedRate mode, frames/s
+            int    loops;           // source repetitions, 0 - until stop()
+        };
+
+        //---------------------------------------------------------------------
+        struct TStat
+        {
+            uint64_t frames;
+            uint64_t dropped;
+            uint64_t bytes;
+            uint64_t errors;        // frames incompatible with pool frames
+            double   elapsed;       // s
+
+            double frameRate() const { return elapsed > 0 ? frames/elapsed : 0; }
+            double byteRate() const { return elapsed > 0 ? bytes/elapsed : 0; }
+        };
+
+        TFrameReplay(TMsgWrapperPoolQueue* pool, TMsgWrapperPoolQueue* dst, const TParams& params) : TThread(L"FrameReplay"), mPool(pool), mDst(dst),
+                     mParams(params), mSrcFrames(0), mFrameIdx(0), mLoop(0), mLoopBase(0), mFinished(false), mFrames(0), mDropped(0), mBytes(0), mErrors(0), mElapsedNs(0) {}
+        ~TFrameReplay() { stop(); }
+
+        //--- source: recorded file or generator producing 'frameNum' frames per loop
+        bool openFile(const std::string& baseName);
+        void setGenerator(TGenerator generator, uint32_t frameNum);
+        static void rampGenerator(TBaseFrame* frame, uint32_t frameNum);
+
+        bool begin();
+        void stop() { if(!threadExit()) threadFinish(); }
+        bool finished() const { return mFinished; }
+        TStat stat() const;
+
+    private:
+        typedef std::chrono::steady_clock TClock;
+
+        virtual bool onExec();
+        uint64_t dueOffset() const;
+        bool loadFrame(TRawFramePtr framePtr);
+        void waitUntil(TClock::time_point time) const;
+
+        static const int SpinTimeUs = 1000;
+
+        TMsgWrapperPoolQueue*   mPool;
+        TMsgWrapperPoolQueue*   mDst;
+        TParams                 mParams;
+        TFrameRecReader         mReader;
+        TGenerator              mGenerator;
+        uint32_t                mSrcFrames;
+        uint32_t                mFrameIdx;
+        int                     mLoop;
+        uint64_t                mLoopBase;      // ns from replay start to loop begin
+        TClock::time_point      mStartTime;
+        std::atomic<bool>       mFinished;
+        std::atomic<uint64_t>   mFrames;
+        std::atomic<uint64_t>   mDropped;
+        std::atomic<uint64_t>   mBytes;
+        std::atomic<uint64_t>   mErrors;
+        std::atomic<uint64_t>   mElapsedNs;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFrameReplay::openFile(const std::string& baseName)
+{
+    mGenerator = TGenerator();
+    mSrcFrames = 0;
+    if(!mReader.open(baseName)) {
+        return false;
+    }
+    mSrcFrames = mReader.frameCount();
+    return mSrcFrames != 0;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReplay::setGenerator(TGenerator generator, uint32_t frameNum)
+{
+    mReader.close();
+    mGenerator = generator ? generator : TGenerator(rampGenerator);
+    mSrcFrames = frameNum;
+}
+
+//-----------------------------------------------------------------------------
+//  diagonal ramp moving by one pixel per frame
+//-----------------------------------------------------------------------------
+inline void TFrameReplay::rampGenerator(TBaseFrame* frame, uint32_t frameNum)
+{
+    uint8_t* line = static_cast<uint8_t*>(frame->getPixelBuf());
+    for(int y = 0; y < frame->height(); ++y, line += frame->bytesPerLine()) {
+        if(frame->pixelSize() == sizeof(uint16_t)) {
+            uint16_t* pix = reinterpret_cast<uint16_t*>(line);
+            for(int x = 0; x < frame->width(); ++x) {
+                pix[x] = static_cast<uint16_t>(x + y + frameNum);
+            }
+        } else {
+            for(int x = 0; x < frame->width()*frame->pixelSize(); ++x) {
+                line[x] = static_cast<uint8_t>(x + y + frameNum);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameReplay::begin()
+{
+    if(!mPool || !mDst || !mSrcFrames || (mParams.mode != AsFastAsPossible && mParams.frameRate <= 0)) {
+        return false;
+    }
+    mFrameIdx = 0;
+    mLoop     = 0;
+    mLoopBase = 0;
+    mFinished = false;
+    mFrames   = mDropped = mBytes = mErrors = mElapsedNs = 0;
+    mStartTime = TClock::now();
+    start(QThread::HighPriority);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline TFrameReplay::TStat TFrameReplay::stat() const
+{
+    TStat stat;
+    stat.frames  = mFrames;
+    stat.dropped = mDropped;
+    stat.bytes   = mBytes;
+    stat.errors  = mErrors;
+    stat.elapsed = mElapsedNs*1e-9;
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+//  ns from replay start; generator frames use frameRate in OriginalTiming mode
+//-----------------------------------------------------------------------------
+inline uint64_t TFrameReplay::dueOffset() const
+{
+    if(mParams.mode == OriginalTiming && mReader.frameCount()) {
+        return mLoopBase + (mReader.timestamp(mFrameIdx) - mReader.timestamp(0));
+    }
+    return mLoopBase + static_cast<uint64_t>(mFrameIdx*1e9/mParams.frameRate);
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReplay::waitUntil(TClock::time_point time) const
+{
+    for(;;) {
+        const int64_t remaining = std::chrono::duration_cast<std::chrono::microseconds>(time - TClock::now()).count();
+        if(remaining <= 0 || threadExit()) {
+            return;
+        }
+        if(remaining > 2*SpinTimeUs) {
+            QThread::usleep(remaining - SpinTimeUs);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameReplay::loadFrame(TRawFramePtr framePtr)
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(framePtr);
+    if(!frame) {
+        return false;
+    }
+    if(mGenerator) {
+        frame->metaInfo().reset();
+        mGenerator(frame,mLoop*mSrcFrames + mFrameIdx);
+        framePtr->setMsgId(mLoop*mSrcFrames + mFrameIdx);
+        return true;
+    }
+    return mReader.readFrame(mFrameIdx,framePtr);     // msgId, net points and metainfo are restored
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameReplay::onExec()
+{
+    if(threadExit()) {
+        mFinished = true;
+        return true;
+    }
+
+    const uint64_t offset = dueOffset();
+    if(mParams.mode != AsFastAsPossible) {
+        waitUntil(mStartTime + std::chrono::nanoseconds(offset));
+    }
+
+    TRawFramePtr framePtr;
+    bool ok = mPool->get(framePtr);
+    if(mParams.mode == AsFastAsPossible) {
+        while(!ok && !threadExit()) {
+            std::this_thread::yield();
+            ok = mPool->get(framePtr);
+        }
+    }
+    if(!ok) {
+        if(!threadExit()) {
+            ++mDropped;
+        }
+    } else if(loadFrame(framePtr)) {
+        mBytes += checkMsg<TBaseFrame>(framePtr)->byteSize();
+        mDst->put(framePtr);
+        ++mFrames;
+    } else {
+        ++mErrors;
+        #if !defined(MSG_SELF_RELEASE)
+            TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(framePtr);
+        #endif
+    }
+    mElapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(TClock::now() - mStartTime).count();
+
+    //--- next frame
+    if(++mFrameIdx == mSrcFrames) {
+        mFrameIdx = 0;
+        if(++mLoop == mParams.loops) {
+            mFinished = true;
+            return true;
+        }
+        //--- next loop starts one frame period after the last frame
+        const uint64_t period = (mParams.mode != OriginalTiming || !mReader.frameCount() || mSrcFrames < 2)
+                                ? (mParams.frameRate > 0 ? static_cast<uint64_t>(1e9/mParams.frameRate) : 0)
+                                : (mReader.timestamp(mSrcFrames - 1) - mReader.timestamp(0))/(mSrcFrames - 1);
+        mLoopBase = offset + period;
+    }
+    return false;
+}
+
+#endif // FRAME_REPLAY_H
@@ -0,0 +1,192 @@
+#if !defined(FRAME_ROI_H)
+#define FRAME_ROI_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "frameview.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Region of interest of pooled frame: origin, size and parent row stride over
+//  parent pixels, no copy. The ROI holds parent TRawFramePtr: with
+//  MSG_SELF_RELEASE the parent is not returned to the pool while any of its
+//  ROIs exists; otherwise releaseMsg() of the owner returns it at once, so the
+//  owner must not release the parent until all of its ROIs are gone.
+//
+//  view() is usual TFrameView, e.g. TFrameStat::calc(roi.view()) processes
+//  ROI pixels only
+//-----------------------------------------------------------------------------
+template<typename T> class TFrameRoi
+{
+    public:
+        typedef T                TPixel;
+        typedef TFrameView<T>    TView;
+        typedef uint16_t         TMetaDataElem;
+
+        static const TMetaDataElem MetaTag     = 0x4F52;             // 'RO'
+        static const TMetaDataElem MetaVersion = 1;
+        static const uint32_t      MetaSize    = 8;                  // in TMetaDataElem units, see writeMetaInfo()
+
+        TFrameRoi() : mX(0), mY(0) {}
+
+        //--- invalid ROI when the rectangle is out of the parent frame or pixel type mismatch
+        TFrameRoi(TRawFramePtr parentPtr, int x, int y, int width, int height) : mX(0), mY(0)
+        {
+            const TView parentView = checkFrameView<TView>(parentPtr);
+            if(!parentView.isValid() || x < 0 || y < 0 || width <= 0 || height <= 0 ||
+               (x + width > parentView.width()) || (y + height > parentView.height())) {
+                return;
+            }
+            mParentPtr = parentPtr;
+            mView      = parentView.subView(x,y,width,height);
+            mX         = x;
+            mY         = y;
+        }
+
+        bool isValid() const { return mView.isValid(); }
+        int x() const { return mX; }
+        int y() const { return mY; }
+        int width() const { return mView.width(); }
+        int height() const { return mView.height(); }
+        int stride() const { return mView.stride(); }          // parent row stride, in pixels
+        const TView& view() const { return mView; }
+        TRawFramePtr parent() const { return mParentPtr; }
+        TBaseFrame* parentFrame() const { TRawFramePtr parentPtr = mParentPtr; return parentPtr ? checkMsg<TBaseFrame>(parentPtr) : 0; }
+
+        //--- ROI of ROI, x/y relative to this ROI
+        TFrameRoi subRoi(int x, int y, int width, int height) const
+        {
+            if(!isValid() || x < 0 || y < 0 || (x + width > this->width()) || (y + height > this->height())) {
+                return TFrameRoi();
+            }
+            return TFrameRoi(mParentPtr,mX + x,mY + y,width,height);
+        }
+
+        //--- ROI origin and parent size in metainfo of the frame serialized from ROI
+        static int findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo);
+        static bool readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo, int& x, int& y, int& parentWidth, int& parentHeight);
+        bool writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const;
+
+        uint32_t serialize(uint8_t* dst, uint32_t maxLen) const;
+        uint32_t serialSize() const;
+
+    private:
+        TRawFramePtr mParentPtr;
+        TView        mView;
+        int          mX;
+        int          mY;
+};
+
+typedef TFrameRoi<TRawFrame::TPixel>        TRawFrameRoi;
+typedef TFrameRoi<TScreenFrameGray::TPixel> TScreenFrameGrayRoi;
+
+//-----------------------------------------------------------------------------
+template<typename T> int TFrameRoi<T>::findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo)
+{
+    for(uint32_t idx = 0; idx + MetaSize <= metaInfo.metaInfoSize(); ++idx) {
+        if(metaInfo[idx] == MetaTag && metaInfo[idx + 1] == MetaVersion && metaInfo[idx + 2] == MetaSize) {
+            return static_cast<int>(idx);
+        }
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+template<typename T> bool TFrameRoi<T>::readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo, int& x, int& y, int& parentWidth, int& parentHeight)
+{
+    const int idx = findMetaInfo(metaInfo);
+    if(idx < 0) {
+        return false;
+    }
+    x            = metaInfo[idx + 4];
+    y            = metaInfo[idx + 5];
+    parentWidth  = metaInfo[idx + 6];
+    parentHeight = metaInfo[idx + 7];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  metainfo layout (TMetaDataElem units):
+//      [offset:  0] MetaTag
+//      [offset:  1] MetaVersion
+//      [offset:  2] MetaSize
+//      [offset:  3] reserved
+//      [offset:  4] x
+//      [offset:  5] y
+//      [offset:  6] parentWidth
+//      [offset:  7] parentHeight
+//
+//  when the parent is itself a frame made of ROI, the existing block is
+//  updated, so origin and size refer to the original frame
+//-----------------------------------------------------------------------------
+template<typename T> bool TFrameRoi<T>::writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const
+{
+    TBaseFrame* parent = parentFrame();
+    if(!parent) {
+        return false;
+    }
+
+    const int idx = findMetaInfo(metaInfo);
+    if(idx >= 0) {
+        metaInfo[idx + 4] += static_cast<TMetaDataElem>(mX);
+        metaInfo[idx + 5] += static_cast<TMetaDataElem>(mY);
+        return true;
+    }
+
+    TMetaDataElem block[MetaSize];
+    block[0] = MetaTag;
+    block[1] = MetaVersion;
+    block[2] = MetaSize;
+    block[3] = 0;
+    block[4] = static_cast<TMetaDataElem>(mX);
+    block[5] = static_cast<TMetaDataElem>(mY);
+    block[6] = static_cast<TMetaDataElem>(parent->width());
+    block[7] = static_cast<TMetaDataElem>(parent->height());
+    return metaInfo.write(block,MetaSize);
+}
+
+//-----------------------------------------------------------------------------
+template<typename T> uint32_t TFrameRoi<T>::serialSize() const
+{
+    return isValid() ? sizeof(TFrameSerialHeader) + TMetaInfo::serialSize() + width()*height()*sizeof(TPixel) : 0;
+}
+
+//-----------------------------------------------------------------------------
+//  serializeFrame() layout with ROI size and pixels: the receiver deserializes
+//  it by deserializeFrame() into the frame of ROI size; parent metainfo is
+//  sent with ROI block appended (not possible for metainfo of other element
+//  type - it is sent as is)
+//-----------------------------------------------------------------------------
+template<typename T> uint32_t TFrameRoi<T>::serialize(uint8_t* dst, uint32_t maxLen) const
+{
+    TBaseFrame* parent = parentFrame();
+    if(!isValid() || !parent) {
+        return 0;
+    }
+
+    TSerializer serializer(dst,maxLen);
+    serialFrameHeader(serializer,mParentPtr,sizeof(TPixel),width(),height(),false,0);
+
+    //--- metainfo
+    uint8_t* metaInfoPtr = static_cast<uint8_t*>(serializer.streamPtr());
+    if(parent->metaInfo().metaElemSize() == sizeof(TMetaDataElem)) {
+        //--- the whole buffer is serialized, the copy takes used elements only
+        TMetaInfoImpl<TMetaDataElem> metaInfo;
+        std::memset(const_cast<void*>(metaInfo.getMetaInfoBuf()),0,metaInfo.metaBufByteSize());
+        static_cast<TMetaInfo&>(metaInfo) = parent->metaInfo();
+        writeMetaInfo(metaInfo);
+        metaInfo.serialize(serializer);
+    } else {
+        parent->metaInfo().serialize(serializer);
+    }
+    uint32_t crc = serializer.isOk() ? TCrc32c::calc(metaInfoPtr,static_cast<uint8_t*>(serializer.streamPtr()) - metaInfoPtr) : 0;
+
+    //--- ROI rows
+    for(int row = 0; row < height(); ++row) {
+        serializer.writeCrc32c(mView.row(row),width(),crc);
+    }
+    return serialFrameFinish(dst,serializer,crc);
+}
+
+#endif // FRAME_ROI_H
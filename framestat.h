@@ -0,0 +1,458 @@
+#if !defined(FRAME_STAT_H)
+#define FRAME_STAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "SimdDefs.h"
+#include "framepar.h"
+#include "frameview.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+struct TFrameStatParams
+{
+    TFrameStatParams() : roiX(0), roiY(0), roiWidth(0), roiHeight(0), decimX(1), decimY(1), satLevel(0), bitDepth(0), enaHist(true), maxThreads(0) {}
+
+    int      roiX;          // ROI origin
+    int      roiY;
+    int      roiWidth;      // 0 - up to the right frame edge
+    int      roiHeight;     // 0 - up to the bottom frame edge
+    int      decimX;        // every decimX pixel of a row is used
+    int      decimY;        // every decimY row is used
+    uint32_t satLevel;      // pixels >= satLevel are counted as saturated, 0 - max value for bitDepth
+    int      bitDepth;      // significant pixel bits (defines histogram bin width), 0 - full pixel size
+    bool     enaHist;       // histogram calculation
+    int      maxThreads;    // 0 - all hardware threads
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class TFrameStat
+{
+    public:
+        typedef uint16_t TMetaDataElem;
+
+        static const int      HistBinNum  = 64;
+        static const uint16_t MetaTag     = 0x5354;                  // 'ST'
+        static const uint16_t MetaVersion = 1;
+        static const uint32_t MetaSize    = 22 + 2*HistBinNum;       // in TMetaDataElem units, see writeMetaInfo()
+
+        enum TFlags
+        {
+            RoiFlag   = 0x01,
+            DecimFlag = 0x02,
+            HistFlag  = 0x04
+        };
+
+        TFrameStat() { reset(); }
+        void reset()
+        {
+            mFlags = 0;
+            mRoiX = mRoiY = mRoiWidth = mRoiHeight = 0;
+            mDecimX = mDecimY = 1;
+            mHistBinShift = 0;
+            mMin = mMax = 0;
+            mPixelNum = mSatNum = 0;
+            mMean = mVariance = 0;
+            std::memset(mHist,0,sizeof(mHist));
+        }
+
+        uint32_t flags() const { return mFlags; }
+        uint32_t pixelNum() const { return mPixelNum; }
+        uint32_t minValue() const { return mMin; }
+        uint32_t maxValue() const { return mMax; }
+        float    mean() const { return mMean; }
+        float    variance() const { return mVariance; }
+        uint32_t satNum() const { return mSatNum; }
+        int      histBinShift() const { return mHistBinShift; }
+        uint32_t hist(int bin) const { return mHist[bin]; }
+
+        //--- single pass over frame pixels; TFrameType defines pixel type (TRawFrame, TScreenFrameGray)
+        template<typename T, int Width, int Height> bool calc(const TFrameView<T,Width,Height>& view, const TFrameStatParams& params = TFrameStatParams());
+        template<typename TFrameType> bool calc(TBaseFrame* frame, const TFrameStatParams& params = TFrameStatParams())
+        {
+            return calc(checkFrameView<TFrameView<typename TFrameType::TPixel>>(frame),params);
+        }
+        template<typename TFrameType> bool calc(TRawFramePtr framePtr, const TFrameStatParams& params = TFrameStatParams())
+        {
+            TBaseFrame* frame;
+            if(framePtr && (frame = checkMsg<TBaseFrame>(framePtr))) {
+                return calc<TFrameType>(frame,params);
+            } else {
+                return false;
+            }
+        }
+
+        bool writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const;
+        bool readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo);
+        static int findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo);
+
+    private:
+        //---------------------------------------------------------------------
+        struct TAccum
+        {
+            static const int SubHistNum = 4;  // interleaved sub-histograms break increment dependency chains
+
+            void reset()
+            {
+                min = 0xFFFFFFFF;
+                max = 0;
+                sum = sumSq = 0;
+                pixelNum = satNum = 0;
+                std::memset(hist,0,sizeof(hist));
+            }
+
+            void merge(const TAccum& right)
+            {
+                min       = std::min(min,right.min);
+                max       = std::max(max,right.max);
+                sum      += right.sum;
+                sumSq    += right.sumSq;
+                pixelNum += right.pixelNum;
+                satNum   += right.satNum;
+                for(int n = 0; n < SubHistNum; ++n) {
+                    for(int bin = 0; bin < HistBinNum; ++bin) {
+                        hist[n][bin] += right.hist[n][bin];
+                    }
+                }
+            }
+
+            uint32_t min;
+            uint32_t max;
+            uint64_t sum;
+            uint64_t sumSq;
+            uint32_t pixelNum;
+            uint32_t satNum;
+            uint32_t hist[SubHistNum][HistBinNum];
+        };
+
+        //---------------------------------------------------------------------
+        template<typename T> static void accumRow(const T* row, int len, int step, uint32_t satLevel, int binShift, bool enaHist, TAccum& acc)
+        {
+            uint32_t min = acc.min;
+            uint32_t max = acc.max;
+            uint64_t sum = 0;
+            uint64_t sumSq = 0;
+            uint32_t satNum = 0;
+            int      pixelNum = 0;
+
+            for(int x = 0; x < len; x += step, ++pixelNum) {
+                const uint32_t pix = row[x];
+                min    = std::min(min,pix);
+                max    = std::max(max,pix);
+                sum   += pix;
+                sumSq += static_cast<uint64_t>(pix)*pix;
+                satNum += (pix >= satLevel);
+                if(enaHist) {
+                    ++acc.hist[pixelNum & (TAccum::SubHistNum - 1)][std::min<uint32_t>(pix >> binShift,HistBinNum - 1)];
+                }
+            }
+            acc.min       = min;
+            acc.max       = max;
+            acc.sum      += sum;
+            acc.sumSq    += sumSq;
+            acc.satNum   += satNum;
+            acc.pixelNum += pixelNum;
+        }
+
+        #if defined(ENA_SIMD_AVX2)
+        //--- returns number of processed pixels, the tail is left for accumRow()
+        static int accumRowAvx2(const uint16_t* row, int len, uint32_t satLevel, int binShift, bool enaHist, TAccum& acc)
+        {
+            static const int FlushPeriod = 16384;   // 32-bit sum lanes and 16-bit saturation lanes are flushed before overflow
+
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i satV = _mm256_set1_epi16(static_cast<short>(satLevel));
+            const bool    enaSat = satLevel <= 0xFFFF;
+            __m256i vMin   = _mm256_set1_epi16(-1);
+            __m256i vMax   = zero;
+            __m256i vSum32 = zero;
+            __m256i vSum64 = zero;
+            __m256i vSq64  = zero;
+            __m256i vSat16 = zero;
+            __m256i vSat32 = zero;
+            alignas(32) uint16_t pix[16];
+
+            int x = 0;
+            int flush = 0;
+            for(; x + 16 <= len; x += 16) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+                vMin = _mm256_min_epu16(vMin,v);
+                vMax = _mm256_max_epu16(vMax,v);
+
+                const __m256i lo = _mm256_unpacklo_epi16(v,zero);
+                const __m256i hi = _mm256_unpackhi_epi16(v,zero);
+                vSum32 = _mm256_add_epi32(vSum32,_mm256_add_epi32(lo,hi));
+                vSq64  = _mm256_add_epi64(vSq64,_mm256_mul_epu32(lo,lo));
+                vSq64  = _mm256_add_epi64(vSq64,_mm256_mul_epu32(_mm256_srli_epi64(lo,32),_mm256_srli_epi64(lo,32)));
+                vSq64  = _mm256_add_epi64(vSq64,_mm256_mul_epu32(hi,hi));
+                vSq64  = _mm256_add_epi64(vSq64,_mm256_mul_epu32(_mm256_srli_epi64(hi,32),_mm256_srli_epi64(hi,32)));
+                vSat16 = _mm256_sub_epi16(vSat16,_mm256_cmpeq_epi16(_mm256_max_epu16(v,satV),v));
+
+                if(enaHist) {
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(pix),v);
+                    for(int n = 0; n < 16; ++n) {
+                        ++acc.hist[n & (TAccum::SubHistNum - 1)][std::min<uint32_t>(pix[n] >> binShift,HistBinNum - 1)];
+                    }
+                }
+
+                if(++flush == FlushPeriod) {
+                    vSum64 = _mm256_add_epi64(vSum64,_mm256_add_epi64(_mm256_unpacklo_epi32(vSum32,zero),_mm256_unpackhi_epi32(vSum32,zero)));
+                    vSat32 = _mm256_add_epi32(vSat32,_mm256_add_epi32(_mm256_unpacklo_epi16(vSat16,zero),_mm256_unpackhi_epi16(vSat16,zero)));
+                    vSum32 = vSat16 = zero;
+                    flush = 0;
+                }
+            }
+            if(x == 0) {
+                return 0;
+            }
+            vSum64 = _mm256_add_epi64(vSum64,_mm256_add_epi64(_mm256_unpacklo_epi32(vSum32,zero),_mm256_unpackhi_epi32(vSum32,zero)));
+            vSat32 = _mm256_add_epi32(vSat32,_mm256_add_epi32(_mm256_unpacklo_epi16(vSat16,zero),_mm256_unpackhi_epi16(vSat16,zero)));
+
+            //--- horizontal reduction
+            const __m128i min128 = _mm_min_epu16(_mm256_castsi256_si128(vMin),_mm256_extracti128_si256(vMin,1));
+            const __m128i max128 = _mm_max_epu16(_mm256_castsi256_si128(vMax),_mm256_extracti128_si256(vMax,1));
+            const __m128i ones   = _mm_set1_epi16(-1);
+            acc.min = std::min<uint32_t>(acc.min,_mm_extract_epi16(_mm_minpos_epu16(min128),0));
+            acc.max = std::max<uint32_t>(acc.max,0xFFFF - _mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(max128,ones)),0));
+
+            alignas(32) uint64_t sum64[4];
+            alignas(32) uint64_t sq64[4];
+            alignas(32) uint32_t sat32[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sum64),vSum64);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sq64),vSq64);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sat32),vSat32);
+            for(int n = 0; n < 4; ++n) {
+                acc.sum   += sum64[n];
+                acc.sumSq += sq64[n];
+            }
+            if(enaSat) {
+                for(int n = 0; n < 8; ++n) {
+                    acc.satNum += sat32[n];
+                }
+            }
+            acc.pixelNum += x;
+            return x;
+        }
+        #endif
+
+        //---
+        template<typename T> static void accumRowDispatch(const T* row, int len, int step, uint32_t satLevel, int binShift, bool enaHist, TAccum& acc)
+        {
+            accumRow(row,len,step,satLevel,binShift,enaHist,acc);
+        }
+
+        //---
+        void setResult(const TAccum& acc)
+        {
+            mPixelNum = acc.pixelNum;
+            mSatNum   = acc.satNum;
+            mMin      = acc.pixelNum ? acc.min : 0;
+            mMax      = acc.max;
+            if(acc.pixelNum) {
+                const double mean = static_cast<double>(acc.sum)/acc.pixelNum;
+                mMean     = static_cast<float>(mean);
+                mVariance = static_cast<float>(std::max(0.0,static_cast<double>(acc.sumSq)/acc.pixelNum - mean*mean));
+            }
+            for(int bin = 0; bin < HistBinNum; ++bin) {
+                mHist[bin] = 0;
+                for(int n = 0; n < TAccum::SubHistNum; ++n) {
+                    mHist[bin] += acc.hist[n][bin];
+                }
+            }
+        }
+
+        static void writeMeta32(TMetaDataElem* dst, uint32_t val) { dst[0] = static_cast<TMetaDataElem>(val); dst[1] = static_cast<TMetaDataElem>(val >> 16); }
+        static uint32_t readMeta32(const TMetaInfoImpl<TMetaDataElem>& metaInfo, uint32_t idx) { return metaInfo[idx] | (static_cast<uint32_t>(metaInfo[idx + 1]) << 16); }
+
+        uint32_t mFlags;
+        int      mRoiX;
+        int      mRoiY;
+        int      mRoiWidth;
+        int      mRoiHeight;
+        int      mDecimX;
+        int      mDecimY;
+        int      mHistBinShift;
+        uint32_t mMin;
+        uint32_t mMax;
+        uint32_t mPixelNum;
+        uint32_t mSatNum;
+        float    mMean;
+        float    mVariance;
+        uint32_t mHist[HistBinNum];
+};
+
+#if defined(ENA_SIMD_AVX2)
+//-----------------------------------------------------------------------------
+template<> inline void TFrameStat::accumRowDispatch<uint16_t>(const uint16_t* row, int len, int step, uint32_t satLevel, int binShift, bool enaHist, TAccum& acc)
+{
+    const int processed = (step == 1) ? accumRowAvx2(row,len,satLevel,binShift,enaHist,acc) : 0;
+    accumRow(row + processed,len - processed,step,satLevel,binShift,enaHist,acc);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+template<typename T, int Width, int Height> bool TFrameStat::calc(const TFrameView<T,Width,Height>& view, const TFrameStatParams& params)
+{
+    typedef T TPixel;
+
+    if(!view.isValid() || params.decimX < 1 || params.decimY < 1) {
+        return false;
+    }
+
+    //--- ROI clipping
+    const int frameWidth  = view.width();
+    const int frameHeight = view.height();
+    const int roiX        = std::max(0,params.roiX);
+    const int roiY        = std::max(0,params.roiY);
+    const int roiWidth    = std::min(params.roiWidth  ? params.roiWidth  : frameWidth,  frameWidth - roiX);
+    const int roiHeight   = std::min(params.roiHeight ? params.roiHeight : frameHeight, frameHeight - roiY);
+    if(roiWidth <= 0 || roiHeight <= 0) {
+        return false;
+    }
+
+    reset();
+    const int bitDepth = std::min(params.bitDepth ? params.bitDepth : static_cast<int>(8*sizeof(TPixel)),32);    // uint32_t levels
+    mFlags        = ((roiWidth != frameWidth || roiHeight != frameHeight) ? RoiFlag : 0) |
+                    ((params.decimX > 1 || params.decimY > 1) ? DecimFlag : 0) |
+                    (params.enaHist ? HistFlag : 0);
+    mRoiX         = roiX;
+    mRoiY         = roiY;
+    mRoiWidth     = roiWidth;
+    mRoiHeight    = roiHeight;
+    mDecimX       = params.decimX;
+    mDecimY       = params.decimY;
+    mHistBinShift = std::max(0,bitDepth - 6);       // 6 bits - HistBinNum
+
+    const uint32_t satLevel = params.satLevel ? params.satLevel : ((bitDepth >= 32) ? 0xFFFFFFFF : ((1u << bitDepth) - 1));
+    const int      rowNum   = (roiHeight + params.decimY - 1)/params.decimY;
+    const int      stripes  = TStripeExec::stripeNum(rowNum,roiWidth/params.decimX,params.maxThreads);
+    std::vector<TAccum> partial(stripes);
+
+    auto stripeFunc = [&](int stripeIdx, int rowBegin, int rowEnd) {
+        TAccum& acc = partial[stripeIdx];
+        acc.reset();
+        for(int row = rowBegin; row < rowEnd; ++row) {
+            const TPixel* rowBuf = view.row(roiY + row*params.decimY) + roiX;
+            accumRowDispatch(rowBuf,roiWidth,params.decimX,satLevel,mHistBinShift,params.enaHist,acc);
+        }
+    };
+    TStripeExec::run(rowNum,stripes,stripeFunc);
+
+    for(int n = 1; n < stripes; ++n) {
+        partial[0].merge(partial[n]);
+    }
+    setResult(partial[0]);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline int TFrameStat::findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo)
+{
+    for(uint32_t idx = 0; idx + MetaSize <= metaInfo.metaInfoSize(); ++idx) {
+        if(metaInfo[idx] == MetaTag && metaInfo[idx + 1] == MetaVersion && metaInfo[idx + 2] == MetaSize) {
+            return static_cast<int>(idx);
+        }
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+//  metainfo layout (TMetaDataElem units), 32-bit values are stored as (lo, hi):
+//      [offset:  0] MetaTag
+//      [offset:  1] MetaVersion
+//      [offset:  2] MetaSize
+//      [offset:  3] flags
+//      [offset:  4] roiX
+//      [offset:  5] roiY
+//      [offset:  6] roiWidth
+//      [offset:  7] roiHeight
+//      [offset:  8] decimX
+//      [offset:  9] decimY
+//      [offset: 10] histBinShift
+//      [offset: 11] reserved
+//      [offset: 12] min
+//      [offset: 13] max
+//      [offset: 14] pixelNum
+//      [offset: 16] satNum
+//      [offset: 18] mean           - float
+//      [offset: 20] variance       - float
+//      [offset: 22] hist[HistBinNum]
+//
+//  an existing block is overwritten, so repeated calls do not grow metainfo
+//-----------------------------------------------------------------------------
+inline bool TFrameStat::writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const
+{
+    TMetaDataElem block[MetaSize];
+    uint32_t meanBits, varianceBits;
+    std::memcpy(&meanBits,&mMean,sizeof(meanBits));
+    std::memcpy(&varianceBits,&mVariance,sizeof(varianceBits));
+
+    block[0]  = MetaTag;
+    block[1]  = MetaVersion;
+    block[2]  = MetaSize;
+    block[3]  = static_cast<TMetaDataElem>(mFlags);
+    block[4]  = static_cast<TMetaDataElem>(mRoiX);
+    block[5]  = static_cast<TMetaDataElem>(mRoiY);
+    block[6]  = static_cast<TMetaDataElem>(mRoiWidth);
+    block[7]  = static_cast<TMetaDataElem>(mRoiHeight);
+    block[8]  = static_cast<TMetaDataElem>(mDecimX);
+    block[9]  = static_cast<TMetaDataElem>(mDecimY);
+    block[10] = static_cast<TMetaDataElem>(mHistBinShift);
+    block[11] = 0;
+    block[12] = static_cast<TMetaDataElem>(mMin);
+    block[13] = static_cast<TMetaDataElem>(mMax);
+    writeMeta32(block + 14,mPixelNum);
+    writeMeta32(block + 16,mSatNum);
+    writeMeta32(block + 18,meanBits);
+    writeMeta32(block + 20,varianceBits);
+    for(int bin = 0; bin < HistBinNum; ++bin) {
+        writeMeta32(block + 22 + 2*bin,mHist[bin]);
+    }
+
+    const int idx = findMetaInfo(metaInfo);
+    if(idx >= 0) {
+        for(uint32_t n = 0; n < MetaSize; ++n) {
+            metaInfo[idx + n] = block[n];
+        }
+        return true;
+    }
+    return metaInfo.write(block,MetaSize);
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameStat::readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo)
+{
+    const int idx = findMetaInfo(metaInfo);
+    if(idx < 0) {
+        return false;
+    }
+
+    uint32_t meanBits, varianceBits;
+    mFlags        = metaInfo[idx + 3];
+    mRoiX         = metaInfo[idx + 4];
+    mRoiY         = metaInfo[idx + 5];
+    mRoiWidth     = metaInfo[idx + 6];
+    mRoiHeight    = metaInfo[idx + 7];
+    mDecimX       = metaInfo[idx + 8];
+    mDecimY       = metaInfo[idx + 9];
+    mHistBinShift = metaInfo[idx + 10];
+    mMin          = metaInfo[idx + 12];
+    mMax          = metaInfo[idx + 13];
+    mPixelNum     = readMeta32(metaInfo,idx + 14);
+    mSatNum       = readMeta32(metaInfo,idx + 16);
+    meanBits      = readMeta32(metaInfo,idx + 18);
+    varianceBits  = readMeta32(metaInfo,idx + 20);
+    std::memcpy(&mMean,&meanBits,sizeof(mMean));
+    std::memcpy(&mVariance,&varianceBits,sizeof(mVariance));
+    for(int bin = 0; bin < HistBinNum; ++bin) {
+        mHist[bin] = readMeta32(metaInfo,idx + 22 + 2*bin);
+    }
+    return true;
+}
+
+#endif // FRAME_STAT_H
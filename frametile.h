@@ -0,0 +1,162 @@
+#if !defined(FRAME_TILE_H)
+#define FRAME_TILE_H
+
+#include <cmath>
+#include <functional>
+#include <algorithm>
+
+#include "framepar.h"
+#include "frameview.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Tile of frame: the tile rectangle is written by the kernel, the halo
+//  rectangle (tile extended by 'halo' pixels, clipped by the frame) is the
+//  source area of neighbourhood kernels. Tiles of a layout cover the frame
+//  without overlap.
+//-----------------------------------------------------------------------------
+struct TTile
+{
+    int idx;
+    int x;
+    int y;
+    int width;
+    int height;
+    int haloX;
+    int haloY;
+    int haloWidth;
+    int haloHeight;
+
+    //--- tile/halo part of the frame view
+    template<typename T, int Width, int Height> TFrameView<T> view(const TFrameView<T,Width,Height>& frameView) const { return frameView.subView(x,y,width,height); }
+    template<typename T, int Width, int Height> TFrameView<T> haloView(const TFrameView<T,Width,Height>& frameView) const { return frameView.subView(haloX,haloY,haloWidth,haloHeight); }
+};
+
+//-----------------------------------------------------------------------------
+//  Tiles - cache-sized rectangles, tile rows are whole cache lines
+//  Stripes - full-width row bands of the same byte size, for row-oriented
+//            kernels (e.g. stream processing of lines)
+//-----------------------------------------------------------------------------
+class TTileLayout
+{
+    public:
+        enum TMode
+        {
+            Tiles,
+            Stripes
+        };
+
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : mode(Tiles), halo(0), tileBytes(DefaultTileBytes) {}
+
+            TMode mode;
+            int   halo;         // pixels
+            int   tileBytes;    // tile size without halo, source pixels
+        };
+
+        static const int DefaultTileBytes = 256*1024;  // source and destination tile in L2
+        static const int CacheLineBytes   = 64;
+
+        TTileLayout() : mWidth(0), mHeight(0), mTileWidth(1), mTileHeight(1), mCols(0), mRows(0), mHalo(0) {}
+        TTileLayout(int width, int height, int pixelSize, const TParams& params = TParams());
+
+        int tileNum() const { return mCols*mRows; }
+        int cols() const { return mCols; }
+        int rows() const { return mRows; }
+        int tileWidth() const { return mTileWidth; }
+        int tileHeight() const { return mTileHeight; }
+        TTile tile(int idx) const;
+
+    private:
+        int mWidth;
+        int mHeight;
+        int mTileWidth;
+        int mTileHeight;
+        int mCols;
+        int mRows;
+        int mHalo;
+};
+
+//-----------------------------------------------------------------------------
+inline TTileLayout::TTileLayout(int width, int height, int pixelSize, const TParams& params) :
+    mWidth(std::max(0,width)), mHeight(std::max(0,height)), mTileWidth(1), mTileHeight(1), mCols(0), mRows(0), mHalo(std::max(0,params.halo))
+{
+    if(!mWidth || !mHeight || pixelSize <= 0) {
+        return;
+    }
+
+    const int tilePixels = std::max(1,std::max(params.tileBytes,CacheLineBytes)/pixelSize);
+    if(params.mode == Stripes) {
+        mTileWidth = mWidth;
+    } else {
+        const int linePixels = std::max(1,CacheLineBytes/pixelSize);
+        const int side       = static_cast<int>(std::sqrt(static_cast<double>(tilePixels)));
+        mTileWidth = std::min(mWidth,std::max(linePixels,(side + linePixels - 1)/linePixels*linePixels));
+    }
+    mTileHeight = std::min(mHeight,std::max(1,tilePixels/mTileWidth));
+    mCols       = (mWidth + mTileWidth - 1)/mTileWidth;
+    mRows       = (mHeight + mTileHeight - 1)/mTileHeight;
+}
+
+//-----------------------------------------------------------------------------
+inline TTile TTileLayout::tile(int idx) const
+{
+    TTile tile;
+    tile.idx        = idx;
+    tile.x          = (idx % mCols)*mTileWidth;
+    tile.y          = (idx/mCols)*mTileHeight;
+    tile.width      = std::min(mTileWidth,mWidth - tile.x);
+    tile.height     = std::min(mTileHeight,mHeight - tile.y);
+    tile.haloX      = std::max(0,tile.x - mHalo);
+    tile.haloY      = std::max(0,tile.y - mHalo);
+    tile.haloWidth  = std::min(mWidth,tile.x + tile.width + mHalo) - tile.haloX;
+    tile.haloHeight = std::min(mHeight,tile.y + tile.height + mHalo) - tile.haloY;
+    return tile;
+}
+
+//-----------------------------------------------------------------------------
+//  Tile kernels over TWorkerPool::instance(): func(const TTile&) is called
+//  once per tile from any worker, tiles of one frame are processed by all
+//  cores; kernels must not write outside of their tile
+//-----------------------------------------------------------------------------
+class TTileExec
+{
+    public:
+        typedef std::function<void(const TTile& tile)> TTileFunc;
+        typedef std::function<void(TRawFramePtr)>      TFrameDoneFunc;
+
+        //--- returns when all tiles are done
+        template<typename TFunc> static void run(const TTileLayout& layout, TFunc& func)
+        {
+            TWorkerPool::instance().run(layout.tileNum(),[&layout,&func](int idx) { func(layout.tile(idx)); });
+        }
+
+        template<typename T, int Width, int Height, typename TFunc> static void run(const TFrameView<T,Width,Height>& view, const TTileLayout::TParams& params, TFunc& func)
+        {
+            const TTileLayout layout(view.width(),view.height(),sizeof(T),params);
+            run(layout,func);
+        }
+
+        //--- returns at once; done(framePtr) is called by the thread completing the last tile. The frame pointer is
+        //    held until then, which keeps the frame out of the pool with MSG_SELF_RELEASE only: otherwise the owner
+        //    must not release the frame before done()
+        static bool submit(TRawFramePtr framePtr, const TTileLayout::TParams& params, const TTileFunc& func, const TFrameDoneFunc& done);
+};
+
+//-----------------------------------------------------------------------------
+inline bool TTileExec::submit(TRawFramePtr framePtr, const TTileLayout::TParams& params, const TTileFunc& func, const TFrameDoneFunc& done)
+{
+    TBaseFrame* frame = framePtr ? checkMsg<TBaseFrame>(framePtr) : 0;
+    if(!frame) {
+        return false;
+    }
+    const TTileLayout layout(frame->width(),frame->height(),frame->pixelSize(),params);
+    TWorkerPool::instance().submit(layout.tileNum(),
+                                   [layout,func](int idx) { func(layout.tile(idx)); },
+                                   [framePtr,done]() { if(done) done(framePtr); });
+    return true;
+}
+
+#endif // FRAME_TILE_H
@@ -0,0 +1,923 @@
+#if !defined(FRAME_UDP_H)
+#define FRAME_UDP_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "tthread.h"
+#include "qudp_lib.h"
+#include "framechunk.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Frame over UDP packets: the frame stream of TFrameChunkWriter (header with
+//  FrameChunkFlag, metainfo, packed pixel lines) is cut into datagrams of
+//  UDP_LIB::TParams::netPacketSize bytes (TFramePacketWriter). Each datagram is
+//  TFramePacketHeader followed by a part of the stream; packets have no
+//  order, each one is placed at its stream offset. The header has own
+//  CRC32C, the payload is protected by UDP checksum
+//-----------------------------------------------------------------------------
+const uint32_t FramePacketMagic = 0x314B5046;  // 'FPK1'
+
+struct TFramePacketHeader
+{
+    uint32_t magic;             // [offset:    0] FramePacketMagic
+    uint32_t msgId;             // [offset:    1] frame msgId
+    uint32_t packetIdx;         // [offset:    2]
+    uint32_t packetNum;         // [offset:    3] packets of the frame
+    uint32_t offsetHi;          // [offset:    4] packet data offset in the frame stream
+    uint32_t offsetLo;          // [offset:    5]
+    uint32_t streamLenHi;       // [offset:    6] frame stream length
+    uint32_t streamLenLo;       // [offset:    7]
+    uint32_t dataLen;           // [offset:    8] packet data bytes after the header
+    uint32_t headerCrc;         // [offset:    9] CRC32C of the words above
+
+    uint64_t offset() const { return (static_cast<uint64_t>(offsetHi) << 32) | offsetLo; }
+    uint64_t streamLen() const { return (static_cast<uint64_t>(streamLenHi) << 32) | streamLenLo; }
+    uint32_t calcHeaderCrc() const { return TCrc32c::calc(this,offsetof(TFramePacketHeader,headerCrc)); }
+};
+
+static_assert(sizeof(TFramePacketHeader) == 10*sizeof(uint32_t),"TFramePacketHeader layout");
+
+//-----------------------------------------------------------------------------
+//  Network receive data of a reassembled frame, a metainfo block after the
+//  metainfo of the sender (TFrameReassembler::TParams::enaRxInfo): kernel
+//  receive time of the first and the last bundle of the frame (UDP_LIB
+//  RxTimestamps, 0 - not available), packets dropped by the socket while the
+//  frame was received (network side of the loss) and packets missing in the
+//  frame
+//-----------------------------------------------------------------------------
+struct TFrameRxInfo
+{
+    typedef uint16_t TMetaDataElem;
+
+    static const uint16_t MetaTag     = 0x5852;                  // 'RX'
+    static const uint16_t MetaVersion = 1;
+    static const uint32_t MetaSize    = 16;                      // in TMetaDataElem units, see writeMetaInfo()
+
+    TFrameRxInfo() : firstTime(0), lastTime(0), drops(0), lostPackets(0) {}
+
+    uint64_t firstTime;         // ns of CLOCK_REALTIME
+    uint64_t lastTime;
+    uint32_t drops;             // socket drops of the bundles with packets of the frame
+    uint32_t lostPackets;
+
+    static int findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo);
+    bool readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo);
+    bool writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const;
+};
+
+//-----------------------------------------------------------------------------
+inline int TFrameRxInfo::findMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo)
+{
+    for(uint32_t idx = 0; idx + MetaSize <= metaInfo.metaInfoSize(); ++idx) {
+        if(metaInfo[idx] == MetaTag && metaInfo[idx + 1] == MetaVersion && metaInfo[idx + 2] == MetaSize) {
+            return static_cast<int>(idx);
+        }
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+//  metainfo layout (TMetaDataElem units), values are stored from the low 16 bits:
+//      [offset:  0] MetaTag
+//      [offset:  1] MetaVersion
+//      [offset:  2] MetaSize
+//      [offset:  3] reserved
+//      [offset:  4] firstTime
+//      [offset:  8] lastTime
+//      [offset: 12] drops
+//      [offset: 14] lostPackets
+//
+//  an existing block is overwritten
+//-----------------------------------------------------------------------------
+inline bool TFrameRxInfo::writeMetaInfo(TMetaInfoImpl<TMetaDataElem>& metaInfo) const
+{
+    TMetaDataElem block[MetaSize];
+    block[0] = MetaTag;
+    block[1] = MetaVersion;
+    block[2] = MetaSize;
+    block[3] = 0;
+    for(int n = 0; n < 4; ++n) {
+        block[4 + n] = static_cast<TMetaDataElem>(firstTime >> 16*n);
+        block[8 + n] = static_cast<TMetaDataElem>(lastTime >> 16*n);
+    }
+    for(int n = 0; n < 2; ++n) {
+        block[12 + n] = static_cast<TMetaDataElem>(drops >> 16*n);
+        block[14 + n] = static_cast<TMetaDataElem>(lostPackets >> 16*n);
+    }
+
+    const int idx = findMetaInfo(metaInfo);
+    if(idx >= 0) {
+        for(uint32_t n = 0; n < MetaSize; ++n) {
+            metaInfo[idx + n] = block[n];
+        }
+        return true;
+    }
+    return metaInfo.write(block,MetaSize);
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameRxInfo::readMetaInfo(const TMetaInfoImpl<TMetaDataElem>& metaInfo)
+{
+    const int idx = findMetaInfo(metaInfo);
+    if(idx < 0) {
+        return false;
+    }
+    firstTime = lastTime = 0;
+    drops = lostPackets = 0;
+    for(int n = 3; n >= 0; --n) {
+        firstTime = (firstTime << 16) | metaInfo[idx + 4 + n];
+        lastTime  = (lastTime << 16) | metaInfo[idx + 8 + n];
+    }
+    for(int n = 1; n >= 0; --n) {
+        drops       = (drops << 16) | metaInfo[idx + 12 + n];
+        lostPackets = (lostPackets << 16) | metaInfo[idx + 14 + n];
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  One frame assembled from packets: pixels are written to the frame as
+//  packets come, the stream prefix (header, metainfo) is collected aside and
+//  read by finish(). Packet geometry is checked against the frame before any
+//  byte is written
+//-----------------------------------------------------------------------------
+class TFramePacketAssembly : public TFrameChunkLayout
+{
+    public:
+        typedef std::chrono::steady_clock TClock;
+
+        enum TResult
+        {
+            Added,
+            Duplicate,
+            BadPacket           // geometry does not match the frame
+        };
+
+        TFramePacketAssembly() : mMsgId(0), mPacketNum(0), mReceived(0), mPrefixReceived(0), mBytesReceived(0), mRxBundle(0) {}
+
+        bool begin(TRawFramePtr framePtr, uint32_t msgId, uint32_t packetNum, TClock::time_point startTime);
+        TRawFramePtr end() { TRawFramePtr framePtr = mFramePtr; mFramePtr = TRawFramePtr(); return framePtr; }
+        TResult add(const TFramePacketHeader& header, const uint8_t* data);
+        bool finish();
+
+        //--- receive data of the bundle 'bundleSeq' with packets of the frame, once per bundle
+        void addRxInfo(const UDP_LIB::TRxInfo& info, uint32_t bundleSeq);
+        void writeRxInfo();
+
+        bool active() const { return mFramePtr ? true : false; }
+        bool complete() const { return (mReceived == mPacketNum) && (mBytesReceived == mStreamLen); }
+        uint32_t msgId() const { return mMsgId; }
+        uint32_t packetNum() const { return mPacketNum; }
+        uint32_t receivedNum() const { return mReceived; }
+        TClock::time_point startTime() const { return mStartTime; }
+
+    private:
+        TRawFramePtr         mFramePtr;
+        std::vector<uint8_t> mPrefix;
+        std::vector<bool>    mPacketReceived;
+        uint32_t             mMsgId;
+        uint32_t             mPacketNum;
+        uint32_t             mReceived;
+        uint32_t             mPrefixReceived;
+        uint64_t             mBytesReceived;
+        TClock::time_point   mStartTime;
+        TFrameRxInfo         mRxInfo;
+        uint32_t             mRxBundle;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFramePacketAssembly::begin(TRawFramePtr framePtr, uint32_t msgId, uint32_t packetNum, TClock::time_point startTime)
+{
+    end();
+    TBaseFrame* frame = framePtr ? checkMsg<TBaseFrame>(framePtr) : 0;
+    if(!init(frame,minChunkSize()) || !packetNum || (packetNum > mStreamLen)) {
+        return false;
+    }
+    mPrefix.resize(prefixLen());
+    mPacketReceived.assign(packetNum,false);
+    mFramePtr       = framePtr;
+    mMsgId          = msgId;
+    mPacketNum      = packetNum;
+    mReceived       = 0;
+    mPrefixReceived = 0;
+    mBytesReceived  = 0;
+    mStartTime      = startTime;
+    mRxInfo         = TFrameRxInfo();
+    mRxBundle       = 0;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  'data' holds header.dataLen bytes (checked by the caller)
+//-----------------------------------------------------------------------------
+inline TFramePacketAssembly::TResult TFramePacketAssembly::add(const TFramePacketHeader& header, const uint8_t* data)
+{
+    const uint64_t offset = header.offset();
+    if((header.streamLen() != mStreamLen) || (header.packetNum != mPacketNum) || (header.packetIdx >= mPacketNum) || !header.dataLen ||
+       (offset > mStreamLen) || (header.dataLen > mStreamLen - offset) || ((header.packetIdx == 0) != (offset == 0))) {
+        return BadPacket;
+    }
+    if(mPacketReceived[header.packetIdx]) {
+        return Duplicate;
+    }
+
+    uint32_t done = 0;
+    if(offset < prefixLen()) {
+        done = std::min(header.dataLen,static_cast<uint32_t>(prefixLen() - offset));
+        std::memcpy(&mPrefix[offset],data,done);
+        mPrefixReceived += done;
+    }
+    if(done < header.dataLen) {
+        copyPixels<true,false>(offset + done,const_cast<uint8_t*>(data) + done,header.dataLen - done,0);
+    }
+    mPacketReceived[header.packetIdx] = true;
+    ++mReceived;
+    mBytesReceived += header.dataLen;
+    return Added;
+}
+
+//-----------------------------------------------------------------------------
+//  frame container data and metainfo from the prefix, false when the prefix
+//  is lost or bad: metainfo is reset then, msgId is taken from the packets.
+//  The hash of incomplete frame is not valid
+//-----------------------------------------------------------------------------
+inline bool TFramePacketAssembly::finish()
+{
+    TBaseFrame* frame = checkMsg<TBaseFrame>(mFramePtr);
+    TFrameSerialHeader header;
+    const bool prefixValid = (mPrefixReceived == prefixLen()) && readPrefix(mFramePtr,&mPrefix[0],mMsgId,header);
+    if(prefixValid) {
+        setFrameData(mFramePtr,header);
+    } else {
+        frame->metaInfo().reset();
+        mFramePtr->setMsgId(mMsgId);
+    }
+    if(!prefixValid || !complete()) {
+        frame->invalidateHash();
+    }
+    return prefixValid;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFramePacketAssembly::addRxInfo(const UDP_LIB::TRxInfo& info, uint32_t bundleSeq)
+{
+    if(bundleSeq == mRxBundle) {
+        return;
+    }
+    mRxBundle = bundleSeq;
+    if(info.firstTime && (!mRxInfo.firstTime || info.firstTime < mRxInfo.firstTime)) {
+        mRxInfo.firstTime = info.firstTime;
+    }
+    mRxInfo.lastTime = std::max(mRxInfo.lastTime,info.lastTime);
+    mRxInfo.drops   += info.drops;
+}
+
+//-----------------------------------------------------------------------------
+//  after finish(): the block changes metainfo, so the frame hash is not valid
+//-----------------------------------------------------------------------------
+inline void TFramePacketAssembly::writeRxInfo()
+{
+    TMetaInfo& metaInfo = checkMsg<TBaseFrame>(mFramePtr)->metaInfo();
+    if(metaInfo.metaElemSize() == sizeof(TFrameRxInfo::TMetaDataElem)) {
+        mRxInfo.lostPackets = mPacketNum - mReceived;
+        mRxInfo.writeMetaInfo(static_cast<TMetaInfoImpl<TFrameRxInfo::TMetaDataElem>&>(metaInfo));
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  Reassembly stage: bundles of the UDP_LIB receive channel are taken by
+//  getTransferH(), their packets are placed to frames of 'pool' and the
+//  bundles are given back by submitTransferH() at once. Up to 'maxFrames'
+//  frames are assembled at the same time, so packets of neighbouring frames
+//  may be mixed. Complete frames go to 'dst'. The socket handle is taken when
+//  the socket exists and is released when the thread finishes.
+//
+//  a frame is incomplete when 'timeout' ms pass from its first packet or its
+//  slot is taken by a new frame (all slots are busy); then
+//      DropPartial    - the frame goes back to the pool
+//      DeliverPartial - the frame goes to 'partialDst' ('dst' when 0) with
+//                       invalid hash; pixels of lost packets keep old
+//                       contents, metainfo is reset when the prefix is lost
+//  packets of the last RetiredNum retired frames (late, duplicated) are
+//  dropped. A frame which finds the pool empty is dropped as a whole
+//
+//  enaRxInfo: delivered frames get TFrameRxInfo in metainfo, receive times
+//  come from a channel with UDP_LIB::RxTimestamps
+//
+//  addBundle()/checkTimeouts() may be called by own receive loop instead of
+//  begin(), from one thread
+//-----------------------------------------------------------------------------
+class TFrameReassembler : public TThread
+{
+    public:
+        enum TPartialPolicy
+        {
+            DropPartial,
+            DeliverPartial
+        };
+
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : netPacketSize(0), maxFrames(4), timeout(100), policy(DropPartial), enaRxInfo(false) {}
+
+            unsigned       netPacketSize;   // UDP_LIB::TParams::netPacketSize of the channel
+            int            maxFrames;       // frames assembled at the same time
+            unsigned       timeout;         // ms from the first packet of the frame, 0 - no limit
+            TPartialPolicy policy;
+            bool           enaRxInfo;       // TFrameRxInfo block in metainfo of delivered frames
+        };
+
+        //---------------------------------------------------------------------
+        struct TStat
+        {
+            uint64_t frames;            // complete
+            uint64_t partialFrames;     // delivered incomplete (DeliverPartial)
+            uint64_t droppedFrames;     // incomplete (DropPartial), bad prefix, empty pool
+            uint64_t packets;           // placed to frames
+            uint64_t lostPackets;       // missing in incomplete frames
+            uint64_t latePackets;       // of retired frames
+            uint64_t duplicatePackets;
+            uint64_t badPackets;        // format, header CRC, geometry
+            uint64_t bundleErrors;      // transfer status is not Ok
+            uint64_t socketDrops;       // packets dropped by the socket (UDP_LIB RxTimestamps)
+        };
+
+        static const int RetiredNum = 64;
+
+        TFrameReassembler(TMsgWrapperPoolQueue* pool, TMsgWrapperPoolQueue* dst, const TParams& params, TMsgWrapperPoolQueue* partialDst = 0);
+        ~TFrameReassembler() { stop(); abort(); }
+
+        bool begin(unsigned long hostAddr, unsigned hostPort);
+        void stop() { if(!threadExit()) threadFinish(); }
+        TStat stat() const;
+
+        //--- bundle of 'netPacketSize' packet slots
+        void addBundle(const uint8_t* buf, int length, const UDP_LIB::TRxInfo* rxInfo = 0);
+        bool addPacket(const void* src, uint32_t len);
+        void checkTimeouts();
+
+        //--- incomplete frames are retired by the policy
+        void flush();
+
+    private:
+        typedef TFramePacketAssembly::TClock TClock;
+
+        static const unsigned PollTimeoutMs = 10;  // timeouts are checked while no bundles come
+
+        virtual bool onExec();
+        TFramePacketAssembly* findFrame(uint32_t msgId);
+        TFramePacketAssembly* newFrame(const TFramePacketHeader& header);
+        void retire(TFramePacketAssembly& frame);
+        void addRetired(uint32_t msgId);
+        bool isRetired(uint32_t msgId) const { return std::find(mRetired.begin(),mRetired.end(),msgId) != mRetired.end(); }
+        void abort();
+        static void releaseFrame(TRawFramePtr& framePtr);
+
+        TMsgWrapperPoolQueue*             mPool;
+        TMsgWrapperPoolQueue*             mDst;
+        TMsgWrapperPoolQueue*             mPartialDst;
+        TParams                           mParams;
+        unsigned long                     mHostAddr;
+        unsigned                          mHostPort;
+        UDP_LIB::TSocketHandle            mSocket;
+        std::vector<TFramePacketAssembly> mFrames;
+        std::vector<uint32_t>             mRetired;         // msgIds, ring
+        size_t                            mRetiredPos;
+        TFramePacketAssembly*             mLastFrame;       // of the previous packet: packets come in runs
+        TClock::time_point                mNow;
+        UDP_LIB::TRxInfo                  mBundleInfo;      // of the current bundle
+        uint32_t                          mBundleSeq;
+        std::atomic<uint64_t>             mFrameNum;
+        std::atomic<uint64_t>             mPartialFrames;
+        std::atomic<uint64_t>             mDroppedFrames;
+        std::atomic<uint64_t>             mPackets;
+        std::atomic<uint64_t>             mLostPackets;
+        std::atomic<uint64_t>             mLatePackets;
+        std::atomic<uint64_t>             mDuplicatePackets;
+        std::atomic<uint64_t>             mBadPackets;
+        std::atomic<uint64_t>             mBundleErrors;
+        std::atomic<uint64_t>             mSocketDrops;
+};
+
+//-----------------------------------------------------------------------------
+inline TFrameReassembler::TFrameReassembler(TMsgWrapperPoolQueue* pool, TMsgWrapperPoolQueue* dst, const TParams& params, TMsgWrapperPoolQueue* partialDst) :
+    TThread(L"FrameReassembler"), mPool(pool), mDst(dst), mPartialDst(partialDst ? partialDst : dst), mParams(params), mHostAddr(0), mHostPort(0),
+    mSocket(0), mFrames(std::max(1,params.maxFrames)), mRetiredPos(0), mLastFrame(0), mBundleSeq(0), mFrameNum(0), mPartialFrames(0), mDroppedFrames(0),
+    mPackets(0), mLostPackets(0), mLatePackets(0), mDuplicatePackets(0), mBadPackets(0), mBundleErrors(0), mSocketDrops(0)
+{
+    std::memset(&mBundleInfo,0,sizeof(mBundleInfo));
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFrameReassembler::begin(unsigned long hostAddr, unsigned hostPort)
+{
+    if(!mPool || !mDst || (mParams.netPacketSize <= sizeof(TFramePacketHeader))) {
+        return false;
+    }
+    mHostAddr = hostAddr;
+    mHostPort = hostPort;
+    start(QThread::HighPriority);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline TFrameReassembler::TStat TFrameReassembler::stat() const
+{
+    TStat stat;
+    stat.frames           = mFrameNum;
+    stat.partialFrames    = mPartialFrames;
+    stat.droppedFrames    = mDroppedFrames;
+    stat.packets          = mPackets;
+    stat.lostPackets      = mLostPackets;
+    stat.latePackets      = mLatePackets;
+    stat.duplicatePackets = mDuplicatePackets;
+    stat.badPackets       = mBadPackets;
+    stat.bundleErrors     = mBundleErrors;
+    stat.socketDrops      = mSocketDrops;
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::releaseFrame(TRawFramePtr& framePtr)
+{
+    #if !defined(MSG_SELF_RELEASE)
+        TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(framePtr);
+    #endif
+    framePtr = TRawFramePtr();
+}
+
+//-----------------------------------------------------------------------------
+//  a bundle has holes or short packets on XmitLenError, packets are parsed
+//  anyway: each one is checked by its header
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::addBundle(const uint8_t* buf, int length, const UDP_LIB::TRxInfo* rxInfo)
+{
+    const int packetSize = static_cast<int>(mParams.netPacketSize);
+    if(packetSize <= 0) {
+        return;
+    }
+    mNow = TClock::now();
+    if(rxInfo) {
+        mBundleInfo   = *rxInfo;
+        mSocketDrops += rxInfo->drops;
+    } else {
+        std::memset(&mBundleInfo,0,sizeof(mBundleInfo));
+    }
+    if(!++mBundleSeq) {
+        mBundleSeq = 1;     // 0 - no bundle in TFramePacketAssembly
+    }
+    for(int pos = 0; pos < length; pos += packetSize) {
+        addPacket(buf + pos,static_cast<uint32_t>(std::min(packetSize,length - pos)));
+    }
+    checkTimeouts();
+}
+
+//-----------------------------------------------------------------------------
+//  returns false for dropped packet
+//-----------------------------------------------------------------------------
+inline bool TFrameReassembler::addPacket(const void* src, uint32_t len)
+{
+    TDeserializer deserializer(src,len);
+    TFramePacketHeader header;
+    if(!deserializer.read(header) || (header.magic != FramePacketMagic) || (header.calcHeaderCrc() != header.headerCrc) ||
+       (header.dataLen > deserializer.remaining())) {
+        ++mBadPackets;
+        return false;
+    }
+
+    TFramePacketAssembly* frame = (mLastFrame && mLastFrame->active() && (mLastFrame->msgId() == header.msgId)) ? mLastFrame : findFrame(header.msgId);
+    if(!frame) {
+        if(isRetired(header.msgId)) {
+            ++mLatePackets;
+            return false;
+        }
+        if(!(frame = newFrame(header))) {
+            return false;
+        }
+    }
+    mLastFrame = frame;
+
+    switch(frame->add(header,deserializer.streamPtr())) {
+        case TFramePacketAssembly::Added:
+            ++mPackets;
+            frame->addRxInfo(mBundleInfo,mBundleSeq);
+            if(frame->complete()) {
+                retire(*frame);
+            }
+            return true;
+
+        case TFramePacketAssembly::Duplicate:
+            ++mDuplicatePackets;
+            return false;
+
+        default:
+            ++mBadPackets;
+            if(!frame->receivedNum()) {     // the frame was started by this packet
+                TRawFramePtr framePtr = frame->end();
+                releaseFrame(framePtr);
+            }
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline TFramePacketAssembly* TFrameReassembler::findFrame(uint32_t msgId)
+{
+    for(size_t n = 0; n < mFrames.size(); ++n) {
+        if(mFrames[n].active() && (mFrames[n].msgId() == msgId)) {
+            return &mFrames[n];
+        }
+    }
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//  free slot or the slot of the oldest frame
+//-----------------------------------------------------------------------------
+inline TFramePacketAssembly* TFrameReassembler::newFrame(const TFramePacketHeader& header)
+{
+    TFramePacketAssembly* frame = 0;
+    for(size_t n = 0; n < mFrames.size(); ++n) {
+        if(!mFrames[n].active()) {
+            frame = &mFrames[n];
+            break;
+        }
+        if(!frame || (mFrames[n].startTime() < frame->startTime())) {
+            frame = &mFrames[n];
+        }
+    }
+    if(frame->active()) {
+        retire(*frame);
+    }
+
+    TRawFramePtr framePtr;
+    if(!mPool->get(framePtr)) {
+        ++mDroppedFrames;
+        addRetired(header.msgId);
+        return 0;
+    }
+    if(!frame->begin(framePtr,header.msgId,header.packetNum,mNow)) {
+        ++mBadPackets;
+        releaseFrame(framePtr);
+        return 0;
+    }
+    return frame;
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::addRetired(uint32_t msgId)
+{
+    if(mRetired.size() < static_cast<size_t>(RetiredNum)) {
+        mRetired.push_back(msgId);
+    } else {
+        mRetired[mRetiredPos] = msgId;
+        mRetiredPos = (mRetiredPos + 1) % RetiredNum;
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::retire(TFramePacketAssembly& frame)
+{
+    addRetired(frame.msgId());
+    const bool complete    = frame.complete();
+    const bool prefixValid = frame.finish();
+    if(mParams.enaRxInfo) {
+        frame.writeRxInfo();
+    }
+    mLostPackets += frame.packetNum() - frame.receivedNum();
+    TRawFramePtr framePtr = frame.end();
+    if(complete && prefixValid) {
+        mDst->put(framePtr);
+        ++mFrameNum;
+    } else if(!complete && (mParams.policy == DeliverPartial)) {
+        mPartialDst->put(framePtr);
+        ++mPartialFrames;
+    } else {
+        releaseFrame(framePtr);
+        ++mDroppedFrames;
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::checkTimeouts()
+{
+    if(!mParams.timeout) {
+        return;
+    }
+    const TClock::time_point now = TClock::now();
+    for(size_t n = 0; n < mFrames.size(); ++n) {
+        if(mFrames[n].active() && (now - mFrames[n].startTime() >= std::chrono::milliseconds(mParams.timeout))) {
+            retire(mFrames[n]);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::flush()
+{
+    for(size_t n = 0; n < mFrames.size(); ++n) {
+        if(mFrames[n].active()) {
+            retire(mFrames[n]);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  frames in assembly go back to the pool without delivery
+//-----------------------------------------------------------------------------
+inline void TFrameReassembler::abort()
+{
+    for(size_t n = 0; n < mFrames.size(); ++n) {
+        TRawFramePtr framePtr = mFrames[n].end();
+        if(framePtr) {
+            releaseFrame(framePtr);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  the bundle is submitted back right after its packets are copied out
+//-----------------------------------------------------------------------------
+inline bool TFrameReassembler::onExec()
+{
+    if(threadExit()) {
+        flush();
+        UDP_LIB::releaseSocketHandle(mSocket);
+        mSocket = 0;
+        return true;
+    }
+
+    if(!mSocket) {
+        mSocket = UDP_LIB::getSocketHandle(mHostAddr,mHostPort);
+    }
+    UDP_LIB::Transfer transfer;
+    const UDP_LIB::TStatus status = mSocket ? UDP_LIB::getTransferH(mSocket,UDP_LIB::Receive,transfer,PollTimeoutMs) : UDP_LIB::SocketNotExist;
+    if(status == UDP_LIB::Ok) {
+        if(transfer.status != UDP_LIB::Ok) {
+            ++mBundleErrors;
+        }
+        UDP_LIB::TRxInfo rxInfo;
+        const bool rxInfoValid = UDP_LIB::getRxInfoH(mSocket,transfer,rxInfo) == UDP_LIB::Ok;
+        addBundle(transfer.buf,transfer.length,rxInfoValid ? &rxInfo : 0);
+        UDP_LIB::submitTransferH(mSocket,UDP_LIB::Receive,transfer);
+    } else if(status == UDP_LIB::SocketWaitTimeout) {
+        checkTimeouts();
+    } else {
+        QThread::msleep(PollTimeoutMs);     // no socket (yet)
+        checkTimeouts();
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+//  Gather lists of frame packets: packet 'idx' carries the stream bytes from
+//  idx*(packetSize - header); headers are built in the caller array, payload
+//  segments point to the prefix and to the frame pixels, nothing is copied.
+//  The last packet is padded to 'packetSize', so receive bundles stay packet
+//  aligned. The frame is held (and must not be modified) until end()
+//-----------------------------------------------------------------------------
+class TFramePacketWriter : public TFrameChunkLayout
+{
+    public:
+        static const uint32_t MaxPacketSize = 65507;   // UDP payload over IPv4
+
+        TFramePacketWriter() : mMsgId(0), mDataLen(0), mPacketNum(0) {}
+
+        bool begin(TRawFramePtr framePtr, uint32_t packetSize, bool enaHash = false);
+        TRawFramePtr end() { TRawFramePtr framePtr = mFramePtr; mFramePtr = TRawFramePtr(); mPacketNum = 0; return framePtr; }
+        uint32_t packetNum() const { return mPacketNum; }
+
+        //--- packets [firstIdx, firstIdx + num) to 'headers' and 'packets' of 'num' entries, segments to 'segments'
+        void writePackets(uint32_t firstIdx, uint32_t num, TFramePacketHeader* headers, UDP_LIB::TGatherPacket* packets, std::vector<UDP_LIB::TSegment>& segments) const;
+
+    private:
+        static const uint8_t* padding()
+        {
+            static const std::vector<uint8_t> zeros(MaxPacketSize);
+            return &zeros[0];
+        }
+
+        TRawFramePtr         mFramePtr;
+        std::vector<uint8_t> mPrefix;
+        uint32_t             mMsgId;
+        uint32_t             mDataLen;          // per packet
+        uint32_t             mPacketNum;
+};
+
+//-----------------------------------------------------------------------------
+inline bool TFramePacketWriter::begin(TRawFramePtr framePtr, uint32_t packetSize, bool enaHash)
+{
+    end();
+    TBaseFrame* frame = framePtr ? checkMsg<TBaseFrame>(framePtr) : 0;
+    if((packetSize <= sizeof(TFramePacketHeader)) || (packetSize > MaxPacketSize) || !init(frame,minChunkSize()) || !writePrefix(framePtr,enaHash,mPrefix)) {
+        return false;
+    }
+    mDataLen = packetSize - sizeof(TFramePacketHeader);
+    const uint64_t packetNum = (mStreamLen + mDataLen - 1)/mDataLen;
+    if(packetNum > 0xFFFFFFFF) {
+        return false;
+    }
+    mFramePtr  = framePtr;
+    mMsgId     = static_cast<uint32_t>(framePtr->msgId());
+    mPacketNum = static_cast<uint32_t>(packetNum);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  segment pointers are set when 'segments' is complete (no reallocation)
+//-----------------------------------------------------------------------------
+inline void TFramePacketWriter::writePackets(uint32_t firstIdx, uint32_t num, TFramePacketHeader* headers, UDP_LIB::TGatherPacket* packets,
+                                             std::vector<UDP_LIB::TSegment>& segments) const
+{
+    segments.clear();
+    for(uint32_t k = 0; k < num; ++k) {
+        const uint64_t offset = static_cast<uint64_t>(firstIdx + k)*mDataLen;
+        const uint32_t len    = static_cast<uint32_t>((mStreamLen - offset < mDataLen) ? mStreamLen - offset : mDataLen);
+        TFramePacketHeader& header = headers[k];
+        header.magic       = FramePacketMagic;
+        header.msgId       = mMsgId;
+        header.packetIdx   = firstIdx + k;
+        header.packetNum   = mPacketNum;
+        header.offsetHi    = static_cast<uint32_t>(offset >> 32);
+        header.offsetLo    = static_cast<uint32_t>(offset);
+        header.streamLenHi = static_cast<uint32_t>(mStreamLen >> 32);
+        header.streamLenLo = static_cast<uint32_t>(mStreamLen);
+        header.dataLen     = len;
+        header.headerCrc   = header.calcHeaderCrc();
+
+        const size_t first = segments.size();
+        const UDP_LIB::TSegment headerSegment = { &header, sizeof(header) };
+        segments.push_back(headerSegment);
+        uint32_t done = 0;
+        if(offset < prefixLen()) {
+            done = std::min(len,static_cast<uint32_t>(prefixLen() - offset));
+            const UDP_LIB::TSegment prefixSegment = { &mPrefix[offset], done };
+            segments.push_back(prefixSegment);
+        }
+        if(done < len) {
+            forPixels(offset + done,len - done,[&segments](uint8_t* pixels, uint32_t, uint32_t n) {
+                const UDP_LIB::TSegment pixelSegment = { pixels, n };
+                segments.push_back(pixelSegment);
+            });
+        }
+        if(len < mDataLen) {
+            const UDP_LIB::TSegment paddingSegment = { padding(), mDataLen - len };
+            segments.push_back(paddingSegment);
+        }
+        packets[k].segmentNum = static_cast<unsigned>(segments.size() - first);
+    }
+
+    const UDP_LIB::TSegment* segment = segments.empty() ? 0 : &segments[0];
+    for(uint32_t k = 0; k < num; ++k) {
+        packets[k].segments = segment;
+        segment += packets[k].segmentNum;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  Transmit stage: frames of 'src' go to the UDP_LIB transmit channel as
+//  packets of TFramePacketWriter by sendGatherH(), i.e. from the frame memory
+//  without bundles, PacketBatch packets per call. The frame is released
+//  right after its last packet is sent (taken by the kernel)
+//
+//  sendFrame() may be called by own loop instead of begin(), from one thread,
+//  with the handle of UDP_LIB::getSocketHandle()
+//-----------------------------------------------------------------------------
+class TFramePacketizer : public TThread
+{
+    public:
+        //---------------------------------------------------------------------
+        struct TParams
+        {
+            TParams() : netPacketSize(0), enaHash(false) {}
+
+            unsigned netPacketSize;     // UDP_LIB::TParams::netPacketSize of the channel
+            bool     enaHash;           // frame hash in the header
+        };
+
+        //---------------------------------------------------------------------
+        struct TStat
+        {
+            uint64_t frames;
+            uint64_t packets;
+            uint64_t bytes;             // frame stream
+            uint64_t errors;            // frames not sent: no socket, send error, frame not fitting packets
+        };
+
+        static const uint32_t PacketBatch = 256;
+
+        TFramePacketizer(TMsgWrapperPoolQueue* src, const TParams& params);
+        ~TFramePacketizer() { stop(); }
+
+        bool begin(unsigned long hostAddr, unsigned hostPort);
+        void stop() { if(!threadExit()) threadFinish(); }
+        TStat stat() const;
+
+        //--- the frame is released on return
+        bool sendFrame(UDP_LIB::TSocketHandle socket, TRawFramePtr framePtr);
+
+    private:
+        static const unsigned IdleSleepUs = 200;
+
+        virtual bool onExec();
+
+        TMsgWrapperPoolQueue*               mSrc;
+        TParams                             mParams;
+        unsigned long                       mHostAddr;
+        unsigned                            mHostPort;
+        UDP_LIB::TSocketHandle              mSocket;
+        TFramePacketWriter                  mWriter;
+        std::vector<TFramePacketHeader>     mHeaders;
+        std::vector<UDP_LIB::TGatherPacket> mPackets;
+        std::vector<UDP_LIB::TSegment>      mSegments;
+        std::atomic<uint64_t>               mFrameNum;
+        std::atomic<uint64_t>               mPacketNum;
+        std::atomic<uint64_t>               mBytes;
+        std::atomic<uint64_t>               mErrors;
+};
+
+//-----------------------------------------------------------------------------
+inline TFramePacketizer::TFramePacketizer(TMsgWrapperPoolQueue* src, const TParams& params) :
+    TThread(L"FramePacketizer"), mSrc(src), mParams(params), mHostAddr(0), mHostPort(0), mSocket(0), mHeaders(PacketBatch), mPackets(PacketBatch),
+    mFrameNum(0), mPacketNum(0), mBytes(0), mErrors(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFramePacketizer::begin(unsigned long hostAddr, unsigned hostPort)
+{
+    if(!mSrc || (mParams.netPacketSize <= sizeof(TFramePacketHeader))) {
+        return false;
+    }
+    mHostAddr = hostAddr;
+    mHostPort = hostPort;
+    start(QThread::HighPriority);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline TFramePacketizer::TStat TFramePacketizer::stat() const
+{
+    TStat stat;
+    stat.frames  = mFrameNum;
+    stat.packets = mPacketNum;
+    stat.bytes   = mBytes;
+    stat.errors  = mErrors;
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFramePacketizer::sendFrame(UDP_LIB::TSocketHandle socket, TRawFramePtr framePtr)
+{
+    bool ok = socket && mWriter.begin(framePtr,mParams.netPacketSize,mParams.enaHash);
+    const uint32_t packetNum = mWriter.packetNum();
+    for(uint32_t idx = 0; ok && (idx < packetNum); idx += PacketBatch) {
+        const uint32_t num = std::min(PacketBatch,packetNum - idx);
+        mWriter.writePackets(idx,num,&mHeaders[0],&mPackets[0],mSegments);
+        ok = UDP_LIB::sendGatherH(socket,&mPackets[0],num) == UDP_LIB::Ok;
+        if(ok) {
+            mPacketNum += num;
+        }
+    }
+    if(ok) {
+        mBytes += mWriter.streamLen();
+        ++mFrameNum;
+    } else {
+        ++mErrors;
+    }
+
+    mWriter.end();
+    #if !defined(MSG_SELF_RELEASE)
+        TBaseMsgWrapper<TMsgPoolPolicy>::releaseMsg(framePtr);
+    #endif
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TFramePacketizer::onExec()
+{
+    TRawFramePtr framePtr;
+    if(!mSrc->get(framePtr)) {
+        if(threadExit()) {
+            UDP_LIB::releaseSocketHandle(mSocket);
+            mSocket = 0;
+            return true;
+        }
+        QThread::usleep(IdleSleepUs);
+        return false;
+    }
+    if(!mSocket) {
+        mSocket = UDP_LIB::getSocketHandle(mHostAddr,mHostPort);
+    }
+    sendFrame(mSocket,framePtr);
+    return false;
+}
+
+#endif // FRAME_UDP_H
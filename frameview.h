@@ -0,0 +1,172 @@
+#if !defined(FRAME_VIEW_H)
+#define FRAME_VIEW_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "SimdDefs.h"
+#include "frame.h"
+
+//-----------------------------------------------------------------------------
+//  Statically typed view of frame pixels: no virtual calls and no pixel size
+//  checks after acquisition. Width/Height != 0 make frame size and row stride
+//  compile time constants (see RawFrame<Width,Height,Id>).
+//
+//  the view does not own pixels: the frame must be held by TRawFramePtr while
+//  the view is used
+//-----------------------------------------------------------------------------
+template<typename T, int Width = 0, int Height = 0> class TFrameView
+{
+    public:
+        typedef T TPixel;
+
+        static const bool IsStatic = (Width > 0) && (Height > 0);
+
+        //---------------------------------------------------------------------
+        //  row split for SIMD loops: [begin,alignedBegin) - head, [alignedBegin,alignedEnd) - aligned body, [alignedEnd,end) - tail
+        struct TRowSpan
+        {
+            T* begin;
+            T* alignedBegin;
+            T* alignedEnd;
+            T* end;
+
+            int headLen() const { return static_cast<int>(alignedBegin - begin); }
+            int bodyLen() const { return static_cast<int>(alignedEnd - alignedBegin); }
+            int tailLen() const { return static_cast<int>(end - alignedEnd); }
+        };
+
+        //---------------------------------------------------------------------
+        class TRowIterator
+        {
+            public:
+                TRowIterator(T* row, ptrdiff_t stride) : mRow(row), mStride(stride) {}
+                T* operator*() const { return mRow; }
+                TRowIterator& operator++() { mRow += mStride; return *this; }
+                bool operator==(const TRowIterator& right) const { return mRow == right.mRow; }
+                bool operator!=(const TRowIterator& right) const { return mRow != right.mRow; }
+
+            private:
+                T*        mRow;
+                ptrdiff_t mStride;
+        };
+
+        //---------------------------------------------------------------------
+        class TRowRange
+        {
+            public:
+                TRowRange(TRowIterator begin, TRowIterator end) : mBegin(begin), mEnd(end) {}
+                TRowIterator begin() const { return mBegin; }
+                TRowIterator end() const { return mEnd; }
+
+            private:
+                TRowIterator mBegin;
+                TRowIterator mEnd;
+        };
+
+        //---------------------------------------------------------------------
+        TFrameView() : mBuf(0), mWidth(Width), mHeight(Height), mStride(Width) {}
+        TFrameView(T* buf, int width, int height, int stride = 0) : mBuf(buf), mWidth(width), mHeight(height), mStride(stride ? stride : width) {}
+
+        bool isValid() const { return mBuf != 0; }
+        int width() const { return IsStatic ? Width : mWidth; }
+        int height() const { return IsStatic ? Height : mHeight; }
+        int stride() const { return IsStatic ? Width : mStride; }      // in pixels
+        int byteStride() const { return stride()*sizeof(T); }
+        bool isContiguous() const { return stride() == width(); }
+
+        T* data() const { return mBuf; }
+        T* row(int y) const { return mBuf + static_cast<ptrdiff_t>(y)*stride(); }
+        T& operator()(int x, int y) const { return row(y)[x]; }
+
+        TRowRange rows() const { return rows(0,height()); }
+        TRowRange rows(int rowBegin, int rowEnd) const { return TRowRange(TRowIterator(row(rowBegin),stride()),TRowIterator(row(rowEnd),stride())); }
+
+        //--- alignment in bytes, power of 2
+        TRowSpan rowSpan(int y, unsigned alignment = 32) const
+        {
+            TRowSpan span;
+            span.begin = row(y);
+            span.end   = span.begin + width();
+
+            const uintptr_t mask  = alignment - 1;
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(span.begin);
+            const uintptr_t end   = reinterpret_cast<uintptr_t>(span.end);
+            const uintptr_t alignedBegin = (begin + mask) & ~mask;
+            const uintptr_t alignedEnd   = end & ~mask;
+            if((alignedBegin >= alignedEnd) || ((alignedBegin - begin) % sizeof(T))) {
+                span.alignedBegin = span.alignedEnd = span.end;  // no aligned body: whole row is head
+            } else {
+                span.alignedBegin = reinterpret_cast<T*>(alignedBegin);
+                span.alignedEnd   = reinterpret_cast<T*>(alignedEnd);
+            }
+            return span;
+        }
+
+        //--- sub-view of rectangle, shares pixels and stride
+        TFrameView<T> subView(int x, int y, int width, int height) const { return TFrameView<T>(row(y) + x,width,height,stride()); }
+
+    private:
+        T*  mBuf;
+        int mWidth;
+        int mHeight;
+        int mStride;
+};
+
+//-----------------------------------------------------------------------------
+//  view type matched to frame type
+//-----------------------------------------------------------------------------
+template<typename TFrameType> struct TFrameViewOf
+{
+    typedef TFrameView<typename TFrameType::TPixel> TView;
+};
+
+template<int Width, int Height, int Id> struct TFrameViewOf<RawFrame<Width,Height,Id>>
+{
+    typedef TFrameView<TRawFrame::TPixel,Width,Height> TView;
+};
+
+template<int Width, int Height, int Id> struct TFrameViewOf<ScreenFrameGray<Width,Height,Id>>
+{
+    typedef TFrameView<TScreenFrameGray::TPixel,Width,Height> TView;
+};
+
+//-----------------------------------------------------------------------------
+//  pixel type holder for TBaseFrame::getPixelBuf<T>()
+//-----------------------------------------------------------------------------
+template<typename T> struct TFramePixelOf
+{
+    typedef T TPixel;
+};
+
+//-----------------------------------------------------------------------------
+//  checkMsg-style acquisition: returns invalid view when pixel type, frame size
+//  (static views) or row stride do not match
+//-----------------------------------------------------------------------------
+template<typename TView> TView checkFrameView(TBaseFrame* frame)
+{
+    typename TView::TPixel* buf;
+    if(!frame || !(buf = frame->getPixelBuf<TFramePixelOf<typename TView::TPixel>>())) {
+        return TView();
+    }
+
+    const int bytesPerLine = frame->bytesPerLine();
+    if(bytesPerLine % sizeof(typename TView::TPixel)) {
+        return TView();
+    }
+
+    TView view(buf,frame->width(),frame->height(),bytesPerLine/sizeof(typename TView::TPixel));
+    if(TView::IsStatic && ((view.width() != frame->width()) || (view.height() != frame->height()) ||
+                           (bytesPerLine != static_cast<int>(frame->width()*sizeof(typename TView::TPixel))))) {
+        return TView();
+    }
+    return view;
+}
+
+//-----------------------------------------------------------------------------
+template<typename TView> TView checkFrameView(TRawFramePtr framePtr)
+{
+    return framePtr ? checkFrameView<TView>(checkMsg<TBaseFrame>(framePtr)) : TView();
+}
+
+#endif // FRAME_VIEW_H
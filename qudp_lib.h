@@ -33,6 +33,24 @@ namespace UDP_LIB
         QUDP_DLL_API UDP_LIB::TStatus getTransfer(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer, unsigned timeout = INFINITE);
         QUDP_DLL_API unsigned getReadyTransferNum(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir);
         QUDP_DLL_API UDP_LIB::TStatus tryGetTransfer(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer);
+        /*not exist in UDP_LIB */ QUDP_DLL_API int getReadyHandle(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus sendGather(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::TGatherPacket* packets, unsigned packetNum);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus getRxInfo(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::Transfer& transfer, UDP_LIB::TRxInfo& info);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus getTxStat(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TTxStat& stat);
+
+        //--- by socket handle
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus createSocketHandle(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::TParams* rxParams, const UDP_LIB::TParams* txParams, UDP_LIB::TSocketHandle& handle);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TSocketHandle getSocketHandle(unsigned long hostAddr, unsigned hostPort);
+        /*not exist in UDP_LIB */ QUDP_DLL_API void releaseSocketHandle(UDP_LIB::TSocketHandle handle);
+        /*not exist in UDP_LIB */ QUDP_DLL_API bool isDirectionExistH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus submitTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus getTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer, unsigned timeout = INFINITE);
+        /*not exist in UDP_LIB */ QUDP_DLL_API unsigned getReadyTransferNumH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus tryGetTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer);
+        /*not exist in UDP_LIB */ QUDP_DLL_API int getReadyHandleH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus sendGatherH(UDP_LIB::TSocketHandle handle, const UDP_LIB::TGatherPacket* packets, unsigned packetNum);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus getRxInfoH(UDP_LIB::TSocketHandle handle, const UDP_LIB::Transfer& transfer, UDP_LIB::TRxInfo& info);
+        /*not exist in UDP_LIB */ QUDP_DLL_API UDP_LIB::TStatus getTxStatH(UDP_LIB::TSocketHandle handle, UDP_LIB::TTxStat& stat);
 }
 
 #ifdef __cplusplus
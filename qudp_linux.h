@@ -0,0 +1,2464 @@
+#if !defined(QUDP_LINUX_H)
+#define QUDP_LINUX_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "UDP_Defs.h"
+#include "qudp_uring.h"
+
+//-----------------------------------------------------------------------------
+//  Linux backend of UDP_LIB (qudp_lib.h API)
+//
+//  Each direction of a socket ('channel') owns 'numBundles' bundles of
+//  'numPacketsInBundle' slots of 'netPacketSize' bytes; packet 'n' of the
+//  bundle is at offset n*netPacketSize. A bundle is owned either by the user
+//  or by the library:
+//      Receive  - all bundles are submitted at createSocket(); the user takes
+//                 filled bundles by getTransfer() and gives them back by
+//                 submitTransfer()
+//      Transmit - all bundles are ready at createSocket(); the user takes an
+//                 empty bundle by getTransfer(), fills 'length' bytes and sends
+//                 it by submitTransfer(); the sent bundle is ready again with
+//                 status of the send
+//
+//  the bundle is received/sent by one recvmmsg()/sendmmsg() call of the
+//  channel thread. A received bundle is delivered when it is full or when no
+//  packet arrives for TParams::timeout ms ('length' < 'bufLength' then;
+//  timeout 0 or INFINITE - full bundles only).
+//  Receive sets XmitLenError when a packet is truncated or a short packet is
+//  not the last one of the bundle, transmit - when the kernel did not take
+//  all bytes
+//
+//  TParams::options UseOffload: UDP segmentation offload. Transmit (GSO) - a
+//  bundle goes to the kernel as runs of up to 64 packets, one send each; the
+//  kernel or the NIC splits them into 'netPacketSize' packets, the last one of
+//  the bundle is shorter when 'length' is not a multiple of the packet size.
+//  Receive (GRO, thread receive only) - coalesced runs of packets land in the
+//  bundle slots as they are; a run longer than the free slots goes on to the
+//  next bundle
+//
+//  TParams::options UseUring: the channel has no thread, bundles are queued
+//  to io_uring at submitTransfer() and completions are reaped by the calling
+//  thread of getTransfer()/tryGetTransfer()/getReadyTransferNum(), i.e. the
+//  user polls the channel. Receive uses multishot recv over a provided buffer
+//  ring of the submitted bundle slots (Linux 6.0) or, on older kernels, linked
+//  reads to registered bundle buffers; transmit - linked sendmsg per bundle.
+//  The channel falls back to the thread when io_uring is not available or
+//  onTransferReady is set (the callback needs a library thread)
+//
+//  TParams::queueNum (receive): the port is shared by 'queueNum' SO_REUSEPORT
+//  sockets, each with own thread and own pool of 'numBundles' bundles (ids
+//  queue*numBundles..); received bundles of all queues go to the one ready
+//  queue of the channel. TOption SteerByPeer/SteerByCpu select the queue by
+//  a CBPF program, PinThreads pins the thread of queue 'n' to CPU
+//  TParams::cpu + n. Multi-queue channels do not use io_uring
+//
+//  TParams::txBitRate/txPacketRate: the transmit channel and sendGather()
+//  send bursts of up to 'txBurst' packets (GSO runs are cut to the burst) at
+//  the departure times of TTxPacer. TOption TxTime hands the times to the fq
+//  qdisc (SO_TXTIME, CLOCK_MONOTONIC): the sender runs up to TxTimeLead ahead
+//  and the kernel spaces the bursts; without fq on the interface the times
+//  are ignored by the kernel, so TxTime is for hosts configured for it. The
+//  user space pacing sleeps and spins to the departure time. Paced channels
+//  do not use io_uring. getTxStat() gives achieved rate
+//
+//  TOption RxTimestamps (receive, no io_uring): getRxInfo() of a received bundle
+//  gives kernel receive time of its first and last packet (SO_TIMESTAMPNS)
+//  and packets dropped by the socket since the previous bundle of the socket
+//  (SO_RXQ_OVFL): receive buffer overflows, i.e. loss which a larger
+//  TParams::socketBufSize or a faster consumer avoids
+//
+//  getReadyHandle() returns eventfd of the channel for poll()/epoll (level
+//  triggered): it is readable while the channel has ready transfers, so one
+//  thread may wait on many sockets and take transfers by tryGetTransfer().
+//  The handle is owned by the library and is valid until the socket is
+//  closed. A UseUring channel is signalled by io_uring completions, the
+//  completions are reaped by the next tryGetTransfer()/getReadyTransferNum()
+//  which may find no ready transfer then; a partial receive bundle is
+//  delivered only by such a call, so the poll timeout should not be longer
+//  than TParams::timeout
+//
+//  sendGather() sends packets of the caller memory (e.g. frame pixels) to the
+//  peer of the transmit channel without bundles, see TSocket::sendGather()
+//
+//  *H entry points take the socket handle of createSocketHandle() or
+//  getSocketHandle() instead of the address: no socket table lookup and no
+//  library lock per call. The handle holds the socket: cleanUp() closes its
+//  channels (get of a transfer returns SocketNotExist, submit fails),
+//  the socket is freed when its last handle is released by
+//  releaseSocketHandle(); calls by handle do not check init(). The address entry points are the
+//  handle ones over a table lookup
+//
+//  addresses are in host byte order (QHostAddress::toIPv4Address()), host
+//  address 0 - any interface
+//
+//  the library entry points are defined in the translation unit which
+//  includes this file with QUDP_LIB_LINUX_IMPL defined
+//-----------------------------------------------------------------------------
+namespace UDP_LIB
+{
+namespace Linux
+{
+
+//-----------------------------------------------------------------------------
+inline sockaddr_in sockAddr(unsigned long addr, unsigned port)
+{
+    sockaddr_in sa;
+    std::memset(&sa,0,sizeof(sa));
+    sa.sin_family      = AF_INET;
+    sa.sin_addr.s_addr = htonl(static_cast<uint32_t>(addr));
+    sa.sin_port        = htons(static_cast<uint16_t>(port));
+    return sa;
+}
+
+//-----------------------------------------------------------------------------
+//  TParams::threadPriority (Windows scale, THREAD_PRIORITY_LOWEST = -2 ..
+//  THREAD_PRIORITY_HIGHEST = 2) to nice value of the calling thread; raising
+//  the priority needs CAP_SYS_NICE, failure is not an error
+//-----------------------------------------------------------------------------
+inline void setThreadPriority(int priority)
+{
+    if(priority) {
+        const int niceValue = std::max(-20,std::min(19,-5*priority));
+        setpriority(PRIO_PROCESS,static_cast<id_t>(syscall(SYS_gettid)),niceValue);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  calling thread to 'cpu' (modulo online CPUs), failure is not an error
+//-----------------------------------------------------------------------------
+inline void setThreadCpu(int cpu)
+{
+    const long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpu >= 0 && cpuNum > 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu % cpuNum,&cpuSet);
+        pthread_setaffinity_np(pthread_self(),sizeof(cpuSet),&cpuSet);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  SO_RCVBUF/SO_SNDBUF: the FORCE option passes over net.core.[rw]mem_max
+//  when the process has CAP_NET_ADMIN
+//-----------------------------------------------------------------------------
+inline void setSocketBufSize(int fd, TDirection dir, int size)
+{
+    if(size > 0) {
+        const int forceOpt = (dir == Receive) ? SO_RCVBUFFORCE : SO_SNDBUFFORCE;
+        if(setsockopt(fd,SOL_SOCKET,forceOpt,&size,sizeof(size)) != 0) {
+            setsockopt(fd,SOL_SOCKET,(dir == Receive) ? SO_RCVBUF : SO_SNDBUF,&size,sizeof(size));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  receive socket options: buffer size, TParams::timeout of recvmmsg()
+//-----------------------------------------------------------------------------
+inline void setRxOptions(int fd, const TParams& params)
+{
+    setSocketBufSize(fd,Receive,params.socketBufSize);
+    if(params.timeout && params.timeout != INFINITE) {
+        const timeval tv = { static_cast<time_t>(params.timeout/1000), static_cast<suseconds_t>((params.timeout % 1000)*1000) };
+        setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  GSO send: run of whole packets, at most 64 (UDP_MAX_SEGMENTS of older
+//  kernels) and 65507 bytes, the UDP payload limit over IPv4 (EMSGSIZE)
+//-----------------------------------------------------------------------------
+const int MaxRunLen = 65507;
+const int MaxRunNum = 64;
+
+inline int gsoStride(int packetSize) { return std::max(1,std::min(MaxRunNum,MaxRunLen/packetSize))*packetSize; }
+
+//-----------------------------------------------------------------------------
+//  receive queues of one port (TParams::queueNum): SO_REUSEPORT sockets,
+//  each with own thread and bundle pool
+//-----------------------------------------------------------------------------
+const unsigned MaxQueueNum = 64;
+
+//-----------------------------------------------------------------------------
+//  transmit pacing (TParams::txBitRate/txPacketRate): token bucket of
+//  'txBurst' packets. reserve() gives the departure time of a burst, bursts
+//  of concurrent senders (channel thread, sendGather()) take the time one
+//  after another; the burst takes the larger of its bytes at txBitRate and its
+//  packets at txPacketRate. The credit of an idle pacer or of a late wakeup is
+//  one burst, i.e. up to two bursts go back-to-back and the average rate holds
+//  over sleep latency. Costs are in ps: the byte time at 10 Gbit/s is below
+//  1 ns
+//-----------------------------------------------------------------------------
+class TTxPacer
+{
+    public:
+        explicit TTxPacer(const TParams& params);
+
+        bool isActive() const { return mBytePs || mPacketPs; }
+        unsigned burst() const { return mBurst; }
+
+        //--- TxTime: the socket accepted SO_TXTIME
+        void setTxTime(bool txTime) { mTxTime = txTime; }
+        bool txTime() const { return mTxTime; }
+
+        //--- departure time of the burst; waits for it (TxTime - up to TxTimeLead before)
+        uint64_t pace(unsigned packets, unsigned bytes);
+        uint64_t reserve(unsigned packets, unsigned bytes);
+
+        //--- [start, end] - the time of the send, ns of CLOCK_MONOTONIC
+        void sent(unsigned packets, unsigned bytes, uint64_t start, uint64_t end);
+        TTxStat stat() const;
+
+        static uint64_t now();
+        static void sleepUntil(uint64_t time);
+
+        //--- sleep, then spin the timer slack of the thread and WakeupNs
+        static void waitUntil(uint64_t time);
+
+        static const uint64_t TxTimeLead = 2000000;    // ns
+        static const uint64_t WakeupNs   = 20000;
+
+    private:
+        TTxPacer(const TTxPacer&);
+        TTxPacer& operator=(const TTxPacer&);
+
+        const uint64_t mBytePs;
+        const uint64_t mPacketPs;
+        const unsigned mBurst;
+        bool           mTxTime;
+
+        mutable std::mutex mMutex;
+        uint64_t           mNext;       // departure of the next burst, ns
+        uint64_t           mNextPs;     // fraction of ns
+        TTxStat            mStat;
+};
+
+//-----------------------------------------------------------------------------
+inline TTxPacer::TTxPacer(const TParams& params) :
+    mBytePs(params.txBitRate ? 8000000000000ull/params.txBitRate : 0), mPacketPs(params.txPacketRate ? 1000000000000ull/params.txPacketRate : 0),
+    mBurst(std::max(1u,params.txBurst)), mTxTime(false), mNext(0), mNextPs(0)
+{
+    std::memset(&mStat,0,sizeof(mStat));
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t TTxPacer::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return static_cast<uint64_t>(ts.tv_sec)*1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+//-----------------------------------------------------------------------------
+inline void TTxPacer::sleepUntil(uint64_t time)
+{
+    const timespec ts = { static_cast<time_t>(time/1000000000), static_cast<long>(time % 1000000000) };
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,0) == EINTR) {
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TTxPacer::waitUntil(uint64_t time)
+{
+    const uint64_t current = now();
+    if(current >= time) {
+        return;
+    }
+    const int slack = prctl(PR_GET_TIMERSLACK,0,0,0,0);
+    const uint64_t spinNs = WakeupNs + static_cast<uint64_t>(std::max(0,slack));
+    if(time - current > spinNs) {
+        sleepUntil(time - spinNs);
+    }
+    while(now() < time) {
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t TTxPacer::reserve(unsigned packets, unsigned bytes)
+{
+    const uint64_t current = now();
+    const uint64_t costPs  = std::max(bytes*mBytePs,packets*mPacketPs);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mNext + costPs/1000 < current) {
+        mNext   = current - costPs/1000;
+        mNextPs = 0;
+    }
+    const uint64_t departure = mNext;
+    mNextPs += costPs;
+    mNext   += mNextPs/1000;
+    mNextPs %= 1000;
+    return departure;
+}
+
+//-----------------------------------------------------------------------------
+inline uint64_t TTxPacer::pace(unsigned packets, unsigned bytes)
+{
+    const uint64_t departure = reserve(packets,bytes);
+    if(!mTxTime) {
+        waitUntil(departure);
+    } else if(departure > now() + TxTimeLead) {
+        sleepUntil(departure - TxTimeLead);
+    }
+    return departure;
+}
+
+//-----------------------------------------------------------------------------
+inline void TTxPacer::sent(unsigned packets, unsigned bytes, uint64_t start, uint64_t end)
+{
+    if(!packets) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mStat.packets) {
+        mStat.firstTime = start;
+    }
+    mStat.packets += packets;
+    mStat.bytes   += bytes;
+    mStat.lastTime = std::max(mStat.lastTime,end);
+}
+
+//-----------------------------------------------------------------------------
+inline TTxStat TTxPacer::stat() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    TTxStat stat = mStat;
+    const uint64_t time = stat.lastTime - stat.firstTime;
+    if(stat.packets && time) {
+        stat.bitRate    = static_cast<uint64_t>(stat.bytes*8e9/time);
+        stat.packetRate = static_cast<uint64_t>(stat.packets*1e9/time);
+    }
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+//  SCM_TXTIME after the control messages of 'hdr', the buffer has room
+//-----------------------------------------------------------------------------
+inline void addTxTime(msghdr& hdr, uint64_t time)
+{
+    cmsghdr* cmsg = reinterpret_cast<cmsghdr*>(static_cast<uint8_t*>(hdr.msg_control) + hdr.msg_controllen);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_TXTIME;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(time));
+    std::memcpy(CMSG_DATA(cmsg),&time,sizeof(time));
+    hdr.msg_controllen += CMSG_SPACE(sizeof(time));
+}
+
+//-----------------------------------------------------------------------------
+//  I/O of channel bundles: own thread (TMmsgIo) or polled by user calls
+//-----------------------------------------------------------------------------
+class TChannelIo
+{
+    public:
+        virtual ~TChannelIo() {}
+
+        virtual bool start() = 0;
+
+        //--- true - completions are reaped by reap() of user calls, submitted() is called after submit
+        virtual bool isPolled() const { return false; }
+        virtual void submitted() {}
+        virtual void reap(unsigned timeoutMs) { static_cast<void>(timeoutMs); }
+
+        //--- reap() waiting for completions returns (channel close)
+        virtual void wake() {}
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class TChannel
+{
+    public:
+        TChannel(TDirection dir, const TParams& params, const TNetAddr& host);
+        ~TChannel();
+
+        void setIo(TChannelIo* io) { mIo = io; }
+
+        //--- UseOffload is set and the socket accepted it
+        void setOffload(bool offload) { mOffload = offload; }
+        bool offload() const { return mOffload; }
+
+        bool isValid() const { return mBufs != 0; }
+        TDirection direction() const { return mDir; }
+        const TParams& params() const { return mParams; }
+        int bundleNum() const { return static_cast<int>(mBundles.size()); }
+        unsigned queueNum() const { return mQueueNum; }
+        int bundleLen() const { return mBundleLen; }
+        uint8_t* bundleBuf(int bundleId) const { return mBufs + static_cast<size_t>(bundleId)*mBundleLen; }
+
+        //--- eventfd, readable while there are ready transfers or the channel is closed; -1 - not available
+        int eventFd() const { return mEventFd; }
+
+        //--- transmit pacing and statistics
+        TTxPacer& pacer() { return mPacer; }
+
+        //--- user side: get() and tryGet() return SocketNotExist after close()
+        TStatus submit(const Transfer& transfer);
+        TStatus get(Transfer& transfer, unsigned timeout);
+        TStatus tryGet(Transfer& transfer);
+        unsigned readyNum();
+        TStatus rxInfo(const Transfer& transfer, TRxInfo& info) const;
+
+        //--- library side: takeSubmitted() waits for a submitted bundle of the queue, false after close()
+        bool takeSubmitted(unsigned queue, int& bundleId, int& length);
+        bool tryTakeSubmitted(unsigned queue, int& bundleId, int& length);
+        void complete(int bundleId, int length, TStatus status, const TRxInfo* rxInfo = 0);
+        void close();
+        bool isClosed() const { std::lock_guard<std::mutex> lock(mMutex); return mClosed; }
+
+    private:
+        struct TBundle
+        {
+            bool    isUser;     // owned by the user
+            int     length;
+            TStatus status;
+            TRxInfo rxInfo;
+        };
+
+        //--- bundles [queue*numBundles, (queue + 1)*numBundles)
+        struct TQueue
+        {
+            std::deque<int>         submitted;
+            std::condition_variable submitCond;
+        };
+
+        TChannel(const TChannel&);
+        TChannel& operator=(const TChannel&);
+
+        void fillTransfer(int bundleId, Transfer& transfer) const;
+        bool takeSubmitted(TQueue& queue, int& bundleId, int& length);
+        bool takeReady(Transfer& transfer);
+        void popReady(Transfer& transfer);
+        void reap(unsigned timeoutMs);
+
+        //--- mMutex is held
+        void signalEvent();
+        void clearEvent();
+
+        const TDirection        mDir;
+        const TParams           mParams;
+        const TNetAddr          mHost;
+        int                     mBundleLen;
+        uint8_t*                mBufs;
+        std::vector<TBundle>    mBundles;
+        unsigned                mQueueNum;
+        TChannelIo*             mIo;
+        std::atomic<bool>       mOffload;       // cleared by the io_uring GSO fallback, read by sendGather()
+        int                     mEventFd;
+        bool                    mEventSet;
+        TTxPacer                mPacer;
+
+        mutable std::mutex        mMutex;
+        std::unique_ptr<TQueue[]> mQueues;
+        std::condition_variable   mReadyCond;
+        std::deque<int>           mReady;
+        bool                      mClosed;
+};
+
+//-----------------------------------------------------------------------------
+//  receive queues: one bundle pool per queue, the ready queue is common
+//-----------------------------------------------------------------------------
+inline TChannel::TChannel(TDirection dir, const TParams& params, const TNetAddr& host) :
+    mDir(dir), mParams(params), mHost(host), mBundleLen(0), mBufs(0), mQueueNum((dir == Receive) ? std::max(1u,params.queueNum) : 1), mIo(0), mOffload(false),
+    mEventFd(eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC)), mEventSet(false), mPacer(params), mClosed(false)
+{
+    const uint64_t bundleLen = static_cast<uint64_t>(params.netPacketSize)*params.numPacketsInBundle;
+    const uint64_t bundleNum = static_cast<uint64_t>(params.numBundles)*mQueueNum;
+    if(!params.netPacketSize || params.netPacketSize > 0xFFFF || !params.numPacketsInBundle || !params.numBundles || bundleLen > 0x7FFFFFFF ||
+       mQueueNum > MaxQueueNum) {
+        return;
+    }
+    void* bufs = 0;
+    if(posix_memalign(&bufs,4096,bundleLen*bundleNum) != 0) {
+        return;
+    }
+    mBufs      = static_cast<uint8_t*>(bufs);
+    mBundleLen = static_cast<int>(bundleLen);
+    mQueues.reset(new TQueue[mQueueNum]);
+
+    const TBundle bundle = { false, 0, Ok, { 0, 0, 0 } };
+    mBundles.assign(bundleNum,bundle);
+    for(int bundleId = 0; bundleId < this->bundleNum(); ++bundleId) {
+        if(dir == Transmit) {
+            mReady.push_back(bundleId);
+        } else {
+            mQueues[bundleId/params.numBundles].submitted.push_back(bundleId);
+        }
+    }
+    if(!mReady.empty()) {
+        signalEvent();
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline TChannel::~TChannel()
+{
+    if(mEventFd >= 0) {
+        ::close(mEventFd);
+    }
+    std::free(mBufs);
+}
+
+//-----------------------------------------------------------------------------
+inline void TChannel::signalEvent()
+{
+    if(!mEventSet && mEventFd >= 0) {
+        const uint64_t value = 1;
+        mEventSet = write(mEventFd,&value,sizeof(value)) == sizeof(value);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TChannel::clearEvent()
+{
+    if(mEventFd >= 0) {
+        uint64_t value;
+        if(read(mEventFd,&value,sizeof(value)) == sizeof(value) || errno == EAGAIN) {
+            mEventSet = false;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  polled channel: the event is cleared before the completions are reaped, so
+//  a completion after the reap signals it again (io_uring eventfd); it is set
+//  again after the reap while ready transfers remain or the channel is closed
+//  (level triggered)
+//-----------------------------------------------------------------------------
+inline void TChannel::reap(unsigned timeoutMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        clearEvent();
+    }
+    mIo->reap(timeoutMs);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mReady.empty() || mClosed) {
+        signalEvent();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  mMutex is held, the ready queue is not empty. The event of polled channel
+//  is cleared only by reap()
+//-----------------------------------------------------------------------------
+inline void TChannel::popReady(Transfer& transfer)
+{
+    const int bundleId = mReady.front();
+    mReady.pop_front();
+    mBundles[bundleId].isUser = true;
+    fillTransfer(bundleId,transfer);
+    if(mReady.empty() && !(mIo && mIo->isPolled())) {
+        clearEvent();
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TChannel::fillTransfer(int bundleId, Transfer& transfer) const
+{
+    transfer.bundleId  = bundleId;
+    transfer.direction = mDir;
+    transfer.status    = mBundles[bundleId].status;
+    transfer.length    = mBundles[bundleId].length;
+    transfer.bufLength = mBundleLen;
+    transfer.buf       = bundleBuf(bundleId);
+    transfer.isStream  = mParams.numPacketsInBundle > 1;
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TChannel::submit(const Transfer& transfer)
+{
+    const int bundleId = transfer.bundleId;
+    if(bundleId < 0 || bundleId >= bundleNum() || transfer.buf != bundleBuf(bundleId) ||
+       (mDir == Transmit && (transfer.length < 0 || transfer.length > mBundleLen))) {
+        return SubmitError;
+    }
+    TQueue* queue;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(!mBundles[bundleId].isUser || mClosed) {
+            return SubmitError;
+        }
+        mBundles[bundleId].isUser = false;
+        mBundles[bundleId].length = (mDir == Transmit) ? transfer.length : 0;
+        queue = &mQueues[static_cast<unsigned>(bundleId)/mParams.numBundles];
+        queue->submitted.push_back(bundleId);
+    }
+    queue->submitCond.notify_one();
+    if(mIo) {
+        mIo->submitted();
+    }
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TChannel::get(Transfer& transfer, unsigned timeout)
+{
+    if(mIo && mIo->isPolled()) {
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds((timeout == INFINITE) ? 0 : timeout);
+        for(;;) {
+            if(isClosed()) {
+                return SocketNotExist;
+            }
+            if(takeReady(transfer)) {
+                return Ok;
+            }
+            unsigned waitMs = INFINITE;
+            if(timeout != INFINITE) {
+                const long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if(left <= 0) {
+                    reap(0);
+                    return isClosed() ? SocketNotExist : takeReady(transfer) ? Ok : SocketWaitTimeout;
+                }
+                waitMs = static_cast<unsigned>(left);
+            }
+            reap(waitMs);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(timeout == INFINITE) {
+        mReadyCond.wait(lock,[this]() { return mClosed || !mReady.empty(); });
+    } else if(!mReadyCond.wait_for(lock,std::chrono::milliseconds(timeout),[this]() { return mClosed || !mReady.empty(); })) {
+        return SocketWaitTimeout;
+    }
+    if(mClosed) {
+        return SocketNotExist;
+    }
+    popReady(transfer);
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TChannel::takeReady(Transfer& transfer)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mReady.empty()) {
+        return false;
+    }
+    popReady(transfer);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TChannel::tryGet(Transfer& transfer)
+{
+    if(mIo && mIo->isPolled()) {
+        reap(0);
+    }
+    return isClosed() ? SocketNotExist : takeReady(transfer) ? Ok : NoReadyTransfers;
+}
+
+//-----------------------------------------------------------------------------
+inline unsigned TChannel::readyNum()
+{
+    if(mIo && mIo->isPolled()) {
+        reap(0);
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    return static_cast<unsigned>(mReady.size());
+}
+
+//-----------------------------------------------------------------------------
+//  the bundle is owned by the user
+//-----------------------------------------------------------------------------
+inline TStatus TChannel::rxInfo(const Transfer& transfer, TRxInfo& info) const
+{
+    const int bundleId = transfer.bundleId;
+    if(mDir != Receive || bundleId < 0 || bundleId >= bundleNum() || transfer.buf != bundleBuf(bundleId)) {
+        return SocketTransferError;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mBundles[bundleId].isUser) {
+        return SocketTransferError;
+    }
+    info = mBundles[bundleId].rxInfo;
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+inline bool TChannel::takeSubmitted(unsigned queue, int& bundleId, int& length)
+{
+    TQueue& q = mQueues[queue];
+    std::unique_lock<std::mutex> lock(mMutex);
+    q.submitCond.wait(lock,[this,&q]() { return mClosed || !q.submitted.empty(); });
+    return takeSubmitted(q,bundleId,length);
+}
+
+//-----------------------------------------------------------------------------
+inline bool TChannel::tryTakeSubmitted(unsigned queue, int& bundleId, int& length)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return takeSubmitted(mQueues[queue],bundleId,length);
+}
+
+//-----------------------------------------------------------------------------
+//  mMutex is held
+//-----------------------------------------------------------------------------
+inline bool TChannel::takeSubmitted(TQueue& queue, int& bundleId, int& length)
+{
+    if(mClosed || queue.submitted.empty()) {
+        return false;
+    }
+    bundleId = queue.submitted.front();
+    length   = mBundles[bundleId].length;
+    queue.submitted.pop_front();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  onTransferReady() is called after the bundle is in the ready queue
+//-----------------------------------------------------------------------------
+inline void TChannel::complete(int bundleId, int length, TStatus status, const TRxInfo* rxInfo)
+{
+    static const TRxInfo noRxInfo = { 0, 0, 0 };
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBundles[bundleId].length = length;
+        mBundles[bundleId].status = status;
+        mBundles[bundleId].rxInfo = rxInfo ? *rxInfo : noRxInfo;
+        mReady.push_back(bundleId);
+        signalEvent();
+    }
+    mReadyCond.notify_one();
+    if(mParams.onTransferReady) {
+        const TNetAddr peer = { mParams.peerAddr, mParams.peerPort };
+        mParams.onTransferReady(mHost,peer,mDir);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  the library threads and the user calls waiting for a transfer return; the
+//  first call only, the channel I/O may be in destruction at the later ones
+//-----------------------------------------------------------------------------
+inline void TChannel::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mClosed) {
+            return;
+        }
+        mClosed = true;
+        signalEvent();
+    }
+    for(unsigned queue = 0; mQueues && queue < mQueueNum; ++queue) {
+        mQueues[queue].submitCond.notify_all();
+    }
+    mReadyCond.notify_all();
+    if(mIo) {
+        mIo->wake();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  channel thread: one recvmmsg()/sendmmsg() per bundle, the message array
+//  is built once, only the receive lengths are updated per call. GRO receive
+//  is one recvmsg() per coalesced run. A receive queue has own thread on own
+//  socket and takes the bundles of the queue only
+//-----------------------------------------------------------------------------
+class TMmsgIo : public TChannelIo
+{
+    public:
+        TMmsgIo(int fd, TChannel& channel, unsigned queue);
+        ~TMmsgIo() { stop(); }
+
+        bool start() { mThread = std::thread(&TMmsgIo::exec,this); return true; }
+        void stop();
+
+    private:
+        TMmsgIo(const TMmsgIo&);
+        TMmsgIo& operator=(const TMmsgIo&);
+
+        void exec();
+        void prepare(uint8_t* buf, int msgNum, int stride, int lastLen);
+        int recvBundle(uint8_t* buf, TStatus& status, TRxInfo& rxInfo);
+        int recvBundleGro(uint8_t* buf, TStatus& status, TRxInfo& rxInfo);
+        int sendBundle(uint8_t* buf, int length, TStatus& status);
+        uint64_t pace(int first, int end);
+        uint64_t readControl(msghdr& hdr);
+
+        void addPacket(int slot, int len, int& length, TStatus& status) const;
+        int placeRun(uint8_t* buf, int& slot, int& length, TStatus& status, const uint8_t* src, int len, int segSize) const;
+
+        //--- control messages of a received packet: UDP_GRO, SCM_TIMESTAMPNS, SO_RXQ_OVFL
+        static const size_t ControlWords = (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t)) + sizeof(uint64_t) - 1)/sizeof(uint64_t);
+
+        const int            mFd;
+        TChannel&            mChannel;
+        const unsigned       mQueue;
+        const int            mPacketSize;
+        const int            mPacketNum;
+        sockaddr_in          mPeer;
+        std::vector<mmsghdr> mMsgs;
+        std::vector<iovec>   mIovs;
+        bool                 mGso;
+        std::thread          mThread;
+
+        //--- GRO: tail of the run which did not fit the bundle
+        std::vector<uint8_t> mSpill;
+        std::vector<uint8_t> mCarry;
+        int                  mCarryPos;
+        int                  mCarryLen;
+        int                  mCarrySeg;
+        uint64_t             mCarryTime;
+
+        //--- RxTimestamps/TxTime: control buffers of mMsgs, socket drop counter
+        const bool            mStamps;
+        const bool            mTxTime;
+        std::vector<uint64_t> mControl;
+        uint32_t              mDropCounter;
+        uint32_t              mBundleDrops;     // counter at the previous bundle
+};
+
+//-----------------------------------------------------------------------------
+inline TMmsgIo::TMmsgIo(int fd, TChannel& channel, unsigned queue) :
+    mFd(fd), mChannel(channel), mQueue(queue), mPacketSize(static_cast<int>(channel.params().netPacketSize)), mPacketNum(static_cast<int>(channel.params().numPacketsInBundle)),
+    mPeer(sockAddr(channel.params().peerAddr,channel.params().peerPort)), mMsgs(mPacketNum), mIovs(mPacketNum),
+    mGso(channel.direction() == Transmit && channel.offload()), mCarryPos(0), mCarryLen(0), mCarrySeg(0), mCarryTime(0),
+    mStamps(channel.direction() == Receive && (channel.params().options & RxTimestamps)), mTxTime(channel.direction() == Transmit && channel.pacer().txTime()),
+    mDropCounter(0), mBundleDrops(0)
+{
+    std::memset(mMsgs.data(),0,mMsgs.size()*sizeof(mmsghdr));
+    for(int n = 0; n < mPacketNum; ++n) {
+        mMsgs[n].msg_hdr.msg_iov    = &mIovs[n];
+        mMsgs[n].msg_hdr.msg_iovlen = 1;
+        if(channel.direction() == Transmit) {
+            mMsgs[n].msg_hdr.msg_name    = &mPeer;
+            mMsgs[n].msg_hdr.msg_namelen = sizeof(mPeer);
+        }
+    }
+    if(channel.direction() == Receive && channel.offload()) {
+        mSpill.resize(MaxRunLen);
+        mCarry.resize(MaxRunLen);
+    }
+    if(mStamps || mTxTime) {
+        mControl.resize(static_cast<size_t>(mPacketNum)*ControlWords);
+        for(int n = 0; n < mPacketNum; ++n) {
+            mMsgs[n].msg_hdr.msg_control = &mControl[n*ControlWords];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  the receive thread blocked in recvmmsg() is woken by shutdown() of the
+//  socket, the channel is closed before
+//-----------------------------------------------------------------------------
+inline void TMmsgIo::stop()
+{
+    mChannel.close();
+    if(mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TMmsgIo::prepare(uint8_t* buf, int msgNum, int stride, int lastLen)
+{
+    for(int n = 0; n < msgNum; ++n) {
+        mIovs[n].iov_base          = buf + static_cast<size_t>(n)*stride;
+        mIovs[n].iov_len           = (n == msgNum - 1) ? lastLen : stride;
+        mMsgs[n].msg_hdr.msg_flags = 0;
+        mMsgs[n].msg_len           = 0;
+        if(!mControl.empty()) {
+            mMsgs[n].msg_hdr.msg_controllen = mStamps ? ControlWords*sizeof(uint64_t) : 0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  packets to the bundle until it is full or TParams::timeout (SO_RCVTIMEO)
+//  passes without a packet; -1 - the socket is shut down
+//-----------------------------------------------------------------------------
+inline int TMmsgIo::recvBundle(uint8_t* buf, TStatus& status, TRxInfo& rxInfo)
+{
+    prepare(buf,mPacketNum,mPacketSize,mPacketSize);
+    status = Ok;
+    int msgNum = 0;
+    while(msgNum < mPacketNum) {
+        const int res = recvmmsg(mFd,&mMsgs[msgNum],mPacketNum - msgNum,0,0);
+        if(res > 0) {
+            msgNum += res;
+            continue;
+        }
+        if(res == 0) {
+            return -1;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            if(msgNum) {
+                break;
+            }
+            continue;
+        }
+        if(errno != EINTR) {
+            if(msgNum) {
+                break;
+            }
+            return -1;
+        }
+    }
+
+    int length = 0;
+    for(int n = 0; n < msgNum; ++n) {
+        if((mMsgs[n].msg_hdr.msg_flags & MSG_TRUNC) || (n < msgNum - 1 && static_cast<int>(mMsgs[n].msg_len) != mPacketSize)) {
+            status = XmitLenError;
+        }
+        length = n*mPacketSize + static_cast<int>(mMsgs[n].msg_len);
+    }
+    if(mStamps && msgNum) {
+        rxInfo.firstTime = readControl(mMsgs[0].msg_hdr);
+        rxInfo.lastTime  = readControl(mMsgs[msgNum - 1].msg_hdr);
+    }
+    return length;
+}
+
+//-----------------------------------------------------------------------------
+//  RxTimestamps: receive time of the packet, 0 - none. The socket drop
+//  counter comes with packets after the first drop only
+//-----------------------------------------------------------------------------
+inline uint64_t TMmsgIo::readControl(msghdr& hdr)
+{
+    uint64_t time = 0;
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr,cmsg)) {
+        if(cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if(cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            std::memcpy(&ts,CMSG_DATA(cmsg),sizeof(ts));
+            time = static_cast<uint64_t>(ts.tv_sec)*1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+        } else if(cmsg->cmsg_type == SO_RXQ_OVFL) {
+            std::memcpy(&mDropCounter,CMSG_DATA(cmsg),sizeof(mDropCounter));
+        }
+    }
+    return time;
+}
+
+//-----------------------------------------------------------------------------
+//  packet of 'len' bytes in 'slot': the bundle has holes when a short packet
+//  is not the last one
+//-----------------------------------------------------------------------------
+inline void TMmsgIo::addPacket(int slot, int len, int& length, TStatus& status) const
+{
+    if(len > mPacketSize) {
+        status = XmitLenError;
+        len    = mPacketSize;
+    }
+    if(length != slot*mPacketSize) {
+        status = XmitLenError;
+    }
+    length = slot*mPacketSize + len;
+}
+
+//-----------------------------------------------------------------------------
+//  run of 'segSize' packets copied to free slots, returns bytes taken
+//-----------------------------------------------------------------------------
+inline int TMmsgIo::placeRun(uint8_t* buf, int& slot, int& length, TStatus& status, const uint8_t* src, int len, int segSize) const
+{
+    int pos = 0;
+    while(pos < len && slot < mPacketNum) {
+        const int segLen = std::min(segSize,len - pos);
+        std::memcpy(buf + static_cast<size_t>(slot)*mPacketSize,src + pos,std::min(segLen,mPacketSize));
+        addPacket(slot++,segLen,length,status);
+        pos += segLen;
+    }
+    return pos;
+}
+
+//-----------------------------------------------------------------------------
+//  GRO: the run is received to the free slots and to the spill buffer; a run
+//  of 'netPacketSize' packets lands in the slots as is, the part in the spill
+//  buffer is carried to the next bundle. Runs of other packet size (short
+//  packets, XmitLenError) are copied packet by packet
+//-----------------------------------------------------------------------------
+inline int TMmsgIo::recvBundleGro(uint8_t* buf, TStatus& status, TRxInfo& rxInfo)
+{
+    status = Ok;
+    int slot   = 0;
+    int length = 0;
+    if(mCarryLen) {
+        const int taken = placeRun(buf,slot,length,status,&mCarry[mCarryPos],mCarryLen,mCarrySeg);
+        mCarryPos += taken;
+        mCarryLen -= taken;
+        rxInfo.firstTime = rxInfo.lastTime = mCarryTime;
+    }
+
+    uint64_t control[ControlWords];
+    while(slot < mPacketNum) {
+        const int regionLen = (mPacketNum - slot)*mPacketSize;
+        iovec iovs[2];
+        iovs[0].iov_base = buf + static_cast<size_t>(slot)*mPacketSize;
+        iovs[0].iov_len  = regionLen;
+        iovs[1].iov_base = mSpill.data();
+        iovs[1].iov_len  = mSpill.size();
+        msghdr msg;
+        std::memset(&msg,0,sizeof(msg));
+        msg.msg_iov        = iovs;
+        msg.msg_iovlen     = 2;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        const int res = static_cast<int>(recvmsg(mFd,&msg,0));
+        if(res < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(slot || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                break;
+            }
+            if(mChannel.isClosed()) {
+                return -1;
+            }
+            continue;
+        }
+        if(res == 0 && mChannel.isClosed()) {
+            return -1;
+        }
+
+        int segSize = res;
+        for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg,cmsg)) {
+            if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                std::memcpy(&segSize,CMSG_DATA(cmsg),sizeof(segSize));
+            }
+        }
+        if(mStamps) {
+            mCarryTime = readControl(msg);
+            if(!slot) {
+                rxInfo.firstTime = mCarryTime;
+            }
+            rxInfo.lastTime = mCarryTime;
+        }
+
+        if(res <= segSize || segSize == mPacketSize) {
+            //--- single packet or run of full packets in place
+            const int inRegion = std::min(res,regionLen);
+            int pos = 0;
+            do {
+                addPacket(slot++,std::min(segSize,inRegion - pos),length,status);
+                pos += segSize;
+            } while(pos < inRegion);
+            if(res > regionLen && segSize == mPacketSize) {
+                std::memcpy(mCarry.data(),mSpill.data(),res - regionLen);
+                mCarryPos = 0;
+                mCarryLen = res - regionLen;
+                mCarrySeg = segSize;
+            }
+        } else {
+            //--- run of short packets: staged in the carry buffer and spread to the slots
+            std::memmove(mCarry.data(),iovs[0].iov_base,std::min(res,regionLen));
+            if(res > regionLen) {
+                std::memcpy(mCarry.data() + regionLen,mSpill.data(),res - regionLen);
+            }
+            const int taken = placeRun(buf,slot,length,status,mCarry.data(),res,segSize);
+            mCarryPos = taken;
+            mCarryLen = res - taken;
+            mCarrySeg = segSize;
+        }
+    }
+    return length;
+}
+
+//-----------------------------------------------------------------------------
+//  'length' bytes as packets of 'netPacketSize', the last one is shorter;
+//  GSO - runs of packets with UDP_SEGMENT set on the socket. Paced - bursts
+//  of messages, a GSO run is not longer than the burst
+//-----------------------------------------------------------------------------
+inline int TMmsgIo::sendBundle(uint8_t* buf, int length, TStatus& status)
+{
+    status = Ok;
+    TTxPacer& pacer = mChannel.pacer();
+    const int burstLen = static_cast<int>(std::min<unsigned>(pacer.burst(),MaxRunNum))*mPacketSize;
+    const int stride   = mGso ? (pacer.isActive() ? std::min(gsoStride(mPacketSize),burstLen) : gsoStride(mPacketSize)) : mPacketSize;
+    const int msgNum   = (length + stride - 1)/stride;
+    if(!msgNum) {
+        return 0;
+    }
+    prepare(buf,msgNum,stride,length - (msgNum - 1)*stride);
+    const int burstMsgs = pacer.isActive() ? std::max(1u,pacer.burst()*mPacketSize/stride) : msgNum;
+
+    int sent = 0;
+    int sentBytes = 0;
+    int burstEnd = 0;
+    uint64_t start = TTxPacer::now();
+    uint64_t departure = 0;
+    while(sent < msgNum) {
+        if(sent == burstEnd) {
+            burstEnd = std::min(msgNum,sent + burstMsgs);
+            if(pacer.isActive()) {
+                departure = pace(sent,burstEnd);
+                if(!sent) {
+                    start = pacer.txTime() ? departure : TTxPacer::now();
+                }
+            }
+        }
+        const int res = sendmmsg(mFd,&mMsgs[sent],burstEnd - sent,0);
+        if(res > 0) {
+            for(int n = sent; n < sent + res; ++n) {
+                sentBytes += static_cast<int>(mMsgs[n].msg_len);
+            }
+            sent += res;
+        } else if(res < 0 && mGso && !sent && (errno == EIO || errno == EINVAL || errno == EMSGSIZE)) {
+            //--- no GSO on the route (e.g. device without checksum offload)
+            const int segSize = 0;
+            setsockopt(mFd,SOL_UDP,UDP_SEGMENT,&segSize,sizeof(segSize));
+            mGso = false;
+            return sendBundle(buf,length,status);
+        } else if(res < 0 && errno != EINTR) {
+            status = SocketTransferError;
+            break;
+        }
+    }
+    pacer.sent((sentBytes + mPacketSize - 1)/mPacketSize,sentBytes,start,std::max(TTxPacer::now(),departure));
+    if(status == Ok && sentBytes != length) {
+        status = XmitLenError;
+    }
+    return sentBytes;
+}
+
+//-----------------------------------------------------------------------------
+//  departure of the burst of messages [first, end), TxTime - to the messages
+//-----------------------------------------------------------------------------
+inline uint64_t TMmsgIo::pace(int first, int end)
+{
+    unsigned packets = 0;
+    unsigned bytes   = 0;
+    for(int n = first; n < end; ++n) {
+        const unsigned len = static_cast<unsigned>(mIovs[n].iov_len);
+        packets += (len + mPacketSize - 1)/mPacketSize;
+        bytes   += len;
+    }
+    const uint64_t departure = mChannel.pacer().pace(packets,bytes);
+    if(mTxTime) {
+        for(int n = first; n < end; ++n) {
+            addTxTime(mMsgs[n].msg_hdr,departure);
+        }
+    }
+    return departure;
+}
+
+//-----------------------------------------------------------------------------
+inline void TMmsgIo::exec()
+{
+    setThreadPriority(mChannel.params().threadPriority);
+    if(mChannel.params().options & PinThreads) {
+        setThreadCpu(mChannel.params().cpu + static_cast<int>(mQueue));
+    }
+    if(mChannel.direction() == Transmit && mChannel.pacer().isActive() && !mTxTime) {
+        prctl(PR_SET_TIMERSLACK,1,0,0,0);       // shorter spin of TTxPacer::waitUntil()
+    }
+
+    int bundleId, length;
+    while(mChannel.takeSubmitted(mQueue,bundleId,length)) {
+        TStatus status;
+        TRxInfo rxInfo = { 0, 0, 0 };
+        if(mChannel.direction() == Receive) {
+            length = mSpill.empty() ? recvBundle(mChannel.bundleBuf(bundleId),status,rxInfo) : recvBundleGro(mChannel.bundleBuf(bundleId),status,rxInfo);
+            if(length < 0) {
+                return;
+            }
+            rxInfo.drops = mDropCounter - mBundleDrops;
+            mBundleDrops = mDropCounter;
+        } else {
+            length = sendBundle(mChannel.bundleBuf(bundleId),length,status);
+        }
+        mChannel.complete(bundleId,length,status,&rxInfo);
+    }
+}
+
+#if defined(QUDP_URING)
+//-----------------------------------------------------------------------------
+//  io_uring channel without thread: bundles are queued at submitted(),
+//  completions are processed under the lock by reap() of any user call, the
+//  wait for completions is outside of the lock
+//
+//  receive, multishot mode: one recv op takes the packet slots of submitted
+//  bundles from the provided buffer ring in ring order, so slots are filled
+//  bundle by bundle. A partly filled bundle is delivered after TParams::timeout
+//  by cancel of the recv op and rebuild of the ring without the bundle
+//
+//  receive, linked mode (no multishot/buffer ring): the front bundle is read by
+//  a chain of linked reads from registered buffers (one per bundle); a short
+//  packet breaks the chain, the rest of the bundle is queued again
+//
+//  transmit: a bundle is a chain of linked sendmsg ops (per packet or per GSO
+//  run), chains of all submitted bundles are in flight at once. A GSO run
+//  refused by the route (EIO/EINVAL/EMSGSIZE) turns the offload off, as in
+//  TMmsgIo::sendBundle(): the rest of the bundle is sent again per packet
+//-----------------------------------------------------------------------------
+class TUringIo : public TChannelIo
+{
+    public:
+        TUringIo(int fd, TChannel& channel);
+        ~TUringIo() { stop(); }
+
+        bool start();
+        bool isPolled() const { return true; }
+        void submitted();
+        void reap(unsigned timeoutMs);
+        void wake();
+
+    private:
+        static const uint64_t RecvTag   = 1ULL << 40;
+        static const uint64_t CancelTag = 1ULL << 41;
+        static const uint64_t WakeTag   = 1ULL << 42;
+        static const unsigned BufGroup  = 0;
+        static const unsigned MaxRingEntries = 32768;
+
+        TUringIo(const TUringIo&);
+        TUringIo& operator=(const TUringIo&);
+
+        static unsigned pow2(unsigned val) { unsigned res = 1; while(res < val) res <<= 1; return res; }
+        unsigned slotNum() const { return static_cast<unsigned>(mChannel.bundleNum())*mPacketNum; }
+        uint8_t* slotBuf(unsigned slot) const { return mChannel.bundleBuf(slot/mPacketNum) + static_cast<size_t>(slot % mPacketNum)*mPacketSize; }
+
+        void stop();
+        void issue();
+        void submit() { if(mRing.submit() == -EBUSY) { mPending = true; } }
+        bool process();
+        void checkFlush();
+        unsigned flushWait() const;
+
+        void ringAdd(int bundleId, unsigned fromSlot);
+        void ringRebuild();
+        void armRecv();
+        void startChain();
+        void cancel(uint64_t userData);
+        void recvPacket(unsigned slot, int len);
+        void deliverFront();
+        void onRecv(const io_uring_cqe& cqe);
+        void onChainRead(const io_uring_cqe& cqe);
+        void onSend(const io_uring_cqe& cqe);
+        void issueSend(int bundleId);
+
+        const int                mFd;
+        TChannel&                mChannel;
+        const unsigned           mPacketSize;
+        const unsigned           mPacketNum;
+        const TDirection         mDir;
+        std::mutex               mMutex;
+        TUring                   mRing;
+        int                      mInFlight;     // ops without final CQE
+        bool                     mPending;      // SQEs not taken by the kernel (CQ overflow)
+        bool                     mStop;
+
+        //--- receive
+        std::deque<int>          mRxBundles;    // bundles in the kernel, in fill order
+        unsigned                 mFill;         // filled slots of the front bundle
+        int                      mLength;
+        TStatus                  mStatus;
+        bool                     mMultishot;
+        bool                     mArmed;        // multishot recv or read chain in flight
+        bool                     mCancelling;
+        int                      mChainOps;
+        io_uring_buf*            mBufRing;
+        unsigned                 mBufRingEntries;
+        std::chrono::steady_clock::time_point mLastPacket;
+
+        //--- transmit
+        std::vector<msghdr>      mTxMsgs;       // per slot
+        std::vector<iovec>       mTxIovs;
+        std::vector<int>         mTxOps;        // per bundle
+        std::vector<int>         mTxSent;
+        std::vector<int>         mTxLength;
+        std::vector<TStatus>     mTxStatus;
+        std::vector<uint64_t>    mTxStart;      // TTxStat time
+        std::vector<bool>        mTxGso;        // chain of GSO runs
+        std::vector<bool>        mTxResend;     // GSO refused, the rest is sent again
+        std::deque<int>          mTxResendQueue;
+        sockaddr_in              mPeer;
+};
+
+//-----------------------------------------------------------------------------
+inline TUringIo::TUringIo(int fd, TChannel& channel) :
+    mFd(fd), mChannel(channel), mPacketSize(channel.params().netPacketSize), mPacketNum(channel.params().numPacketsInBundle), mDir(channel.direction()),
+    mInFlight(0), mPending(false), mStop(false), mFill(0), mLength(0), mStatus(Ok), mMultishot(false), mArmed(false), mCancelling(false), mChainOps(0),
+    mBufRing(0), mBufRingEntries(0), mPeer(sockAddr(channel.params().peerAddr,channel.params().peerPort))
+{
+}
+
+//-----------------------------------------------------------------------------
+//  SQ holds a whole chain of a bundle; CQ holds completions of all slots
+//-----------------------------------------------------------------------------
+inline bool TUringIo::start()
+{
+    if(mPacketNum + 8 > MaxRingEntries) {
+        return false;
+    }
+    if(!mRing.init(pow2(mPacketNum + 8),std::min(2*MaxRingEntries,pow2(2*slotNum() + 16)))) {
+        return false;
+    }
+    //--- completions signal the channel event, no thread reaps them
+    if(mChannel.eventFd() >= 0 && mRing.registerEventFd(mChannel.eventFd()) != 0) {
+        mRing.close();
+        return false;
+    }
+
+    if(mDir == Receive) {
+        //--- registered buffers: one per bundle
+        std::vector<iovec> iovs(mChannel.bundleNum());
+        for(int bundleId = 0; bundleId < mChannel.bundleNum(); ++bundleId) {
+            iovs[bundleId].iov_base = mChannel.bundleBuf(bundleId);
+            iovs[bundleId].iov_len  = mChannel.bundleLen();
+        }
+        if(mRing.registerBuffers(iovs.data(),static_cast<unsigned>(iovs.size())) != 0) {
+            mRing.close();
+            return false;
+        }
+
+        //--- provided buffer ring of all slots
+        if(slotNum() <= MaxRingEntries) {
+            mBufRingEntries = pow2(slotNum());
+            void* ring = 0;
+            if(posix_memalign(&ring,4096,mBufRingEntries*sizeof(io_uring_buf)) == 0) {
+                std::memset(ring,0,mBufRingEntries*sizeof(io_uring_buf));
+                mBufRing = static_cast<io_uring_buf*>(ring);
+                mMultishot = mRing.registerBufRing(mBufRing,mBufRingEntries,BufGroup) == 0;
+            }
+        }
+    } else {
+        mTxMsgs.resize(slotNum());
+        mTxIovs.resize(slotNum());
+        mTxOps.assign(mChannel.bundleNum(),0);
+        mTxSent.assign(mChannel.bundleNum(),0);
+        mTxLength.assign(mChannel.bundleNum(),0);
+        mTxStatus.assign(mChannel.bundleNum(),Ok);
+        mTxStart.assign(mChannel.bundleNum(),0);
+        mTxGso.assign(mChannel.bundleNum(),false);
+        mTxResend.assign(mChannel.bundleNum(),false);
+        std::memset(mTxMsgs.data(),0,mTxMsgs.size()*sizeof(msghdr));
+        for(unsigned slot = 0; slot < slotNum(); ++slot) {
+            mTxMsgs[slot].msg_iov       = &mTxIovs[slot];
+            mTxMsgs[slot].msg_iovlen    = 1;
+            mTxMsgs[slot].msg_name      = &mPeer;
+            mTxMsgs[slot].msg_namelen   = sizeof(mPeer);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    issue();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  the socket is shut down by TSocket: ops in flight complete, they are
+//  drained before the buffers are freed
+//-----------------------------------------------------------------------------
+inline void TUringIo::stop()
+{
+    if(!mRing.isValid()) {
+        std::free(mBufRing);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+        if(mInFlight) {
+            io_uring_sqe* sqe = mRing.sqe();
+            if(sqe) {
+                sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+                sqe->fd           = mFd;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD;
+                sqe->user_data    = CancelTag;
+                ++mInFlight;
+                submit();
+            }
+        }
+    }
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    for(;;) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            process();
+            if(mInFlight <= 0 || std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+        }
+        mRing.wait(10);
+    }
+    mRing.close();
+    std::free(mBufRing);
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::submitted()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    issue();
+}
+
+//-----------------------------------------------------------------------------
+//  NOP completion for the waiter of reap()
+//-----------------------------------------------------------------------------
+inline void TUringIo::wake()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    io_uring_sqe* sqe = mRing.isValid() ? mRing.sqe() : 0;
+    if(sqe) {
+        sqe->opcode    = IORING_OP_NOP;
+        sqe->user_data = WakeTag;
+        ++mInFlight;
+        submit();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  bundles submitted by the user to the kernel
+//-----------------------------------------------------------------------------
+inline void TUringIo::issue()
+{
+    if(mStop) {
+        return;
+    }
+    int bundleId, length;
+    if(mDir == Receive) {
+        while(mChannel.tryTakeSubmitted(0,bundleId,length)) {
+            mRxBundles.push_back(bundleId);
+            if(mMultishot && !mCancelling) {
+                ringAdd(bundleId,0);
+            }
+        }
+        if(!mArmed && !mCancelling && !mRxBundles.empty()) {
+            if(mMultishot) {
+                armRecv();
+            } else {
+                startChain();
+            }
+        }
+    } else {
+        while(!mTxResendQueue.empty() && mRing.sqSpace() >= mPacketNum) {
+            issueSend(mTxResendQueue.front());
+            mTxResendQueue.pop_front();
+        }
+        while(mTxResendQueue.empty() && mRing.sqSpace() >= mPacketNum && mChannel.tryTakeSubmitted(0,bundleId,length)) {
+            mTxLength[bundleId] = length;
+            mTxSent[bundleId]   = 0;
+            mTxStart[bundleId]  = TTxPacer::now();
+            issueSend(bundleId);
+        }
+    }
+    submit();
+}
+
+//-----------------------------------------------------------------------------
+//  chain of the bundle bytes not sent yet
+//-----------------------------------------------------------------------------
+inline void TUringIo::issueSend(int bundleId)
+{
+    const unsigned stride = mChannel.offload() ? gsoStride(mPacketSize) : mPacketSize;
+    const unsigned offset = static_cast<unsigned>(mTxSent[bundleId]);
+    const unsigned length = static_cast<unsigned>(mTxLength[bundleId]) - offset;
+    const unsigned msgNum = (length + stride - 1)/stride;
+    mTxStatus[bundleId] = Ok;
+    mTxGso[bundleId]    = stride != mPacketSize;
+    mTxResend[bundleId] = false;
+    mTxOps[bundleId]    = static_cast<int>(msgNum);
+    if(!msgNum) {
+        mChannel.complete(bundleId,mTxSent[bundleId],Ok);
+        return;
+    }
+    const unsigned first = static_cast<unsigned>(bundleId)*mPacketNum;
+    for(unsigned n = 0; n < msgNum; ++n) {
+        mTxIovs[first + n].iov_base = mChannel.bundleBuf(bundleId) + offset + static_cast<size_t>(n)*stride;
+        mTxIovs[first + n].iov_len  = (n == msgNum - 1) ? length - n*stride : stride;
+        io_uring_sqe* sqe = mRing.sqe();
+        sqe->opcode    = IORING_OP_SENDMSG;
+        sqe->fd        = mFd;
+        sqe->addr      = reinterpret_cast<uintptr_t>(&mTxMsgs[first + n]);
+        sqe->len       = 1;
+        sqe->flags     = (n < msgNum - 1) ? IOSQE_IO_LINK : 0;
+        sqe->user_data = first + n;
+    }
+    mInFlight += static_cast<int>(msgNum);
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::ringAdd(int bundleId, unsigned fromSlot)
+{
+    const unsigned first = static_cast<unsigned>(bundleId)*mPacketNum;
+    for(unsigned n = fromSlot; n < mPacketNum; ++n) {
+        TUring::bufRingAdd(mBufRing,mBufRingEntries,n - fromSlot,slotBuf(first + n),mPacketSize,first + n);
+    }
+    TUring::bufRingAdvance(mBufRing,mPacketNum - fromSlot);
+}
+
+//-----------------------------------------------------------------------------
+//  after cancel: the ring is registered again with free slots of the bundles
+//  in the kernel
+//-----------------------------------------------------------------------------
+inline void TUringIo::ringRebuild()
+{
+    mRing.unregisterBufRing(BufGroup);
+    std::memset(mBufRing,0,mBufRingEntries*sizeof(io_uring_buf));
+    if(mRing.registerBufRing(mBufRing,mBufRingEntries,BufGroup) != 0) {
+        mMultishot = false;
+        return;
+    }
+    for(size_t n = 0; n < mRxBundles.size(); ++n) {
+        ringAdd(mRxBundles[n],n ? 0 : mFill);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  MSG_TRUNC: the result is the datagram length, truncation is detected
+//-----------------------------------------------------------------------------
+inline void TUringIo::armRecv()
+{
+    io_uring_sqe* sqe = mRing.sqe();
+    if(!sqe) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = mFd;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BufGroup;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->msg_flags = MSG_TRUNC;
+    sqe->user_data = RecvTag;
+    mArmed = true;
+    ++mInFlight;
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::startChain()
+{
+    const int bundleId = mRxBundles.front();
+    const unsigned first = static_cast<unsigned>(bundleId)*mPacketNum;
+    for(unsigned n = mFill; n < mPacketNum; ++n) {
+        io_uring_sqe* sqe = mRing.sqe();
+        sqe->opcode    = IORING_OP_READ_FIXED;
+        sqe->fd        = mFd;
+        sqe->addr      = reinterpret_cast<uintptr_t>(slotBuf(first + n));
+        sqe->len       = mPacketSize;
+        sqe->buf_index = static_cast<uint16_t>(bundleId);
+        sqe->flags     = (n < mPacketNum - 1) ? IOSQE_IO_LINK : 0;
+        sqe->user_data = first + n;
+    }
+    mChainOps = static_cast<int>(mPacketNum - mFill);
+    mInFlight += mChainOps;
+    mArmed = true;
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::cancel(uint64_t userData)
+{
+    io_uring_sqe* sqe = mRing.sqe();
+    if(!sqe) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = userData;
+    sqe->user_data = CancelTag;
+    mCancelling = true;
+    ++mInFlight;
+    submit();
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::recvPacket(unsigned slot, int len)
+{
+    if(mRxBundles.empty() || slot != static_cast<unsigned>(mRxBundles.front())*mPacketNum + mFill) {
+        mStatus = SocketTransferError;
+        return;
+    }
+    if(len > static_cast<int>(mPacketSize)) {
+        mStatus = XmitLenError;
+        len = static_cast<int>(mPacketSize);
+    }
+    if(mLength != static_cast<int>(mFill*mPacketSize)) {
+        mStatus = XmitLenError;
+    }
+    mLength = static_cast<int>(mFill*mPacketSize) + len;
+    mLastPacket = std::chrono::steady_clock::now();
+    if(++mFill == mPacketNum) {
+        deliverFront();
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::deliverFront()
+{
+    const int bundleId = mRxBundles.front();
+    mRxBundles.pop_front();
+    mChannel.complete(bundleId,mLength,mStatus);
+    mFill   = 0;
+    mLength = 0;
+    mStatus = Ok;
+}
+
+//-----------------------------------------------------------------------------
+//  multishot recv: EINVAL - not supported by the kernel, linked mode is used
+//-----------------------------------------------------------------------------
+inline void TUringIo::onRecv(const io_uring_cqe& cqe)
+{
+    if(cqe.flags & IORING_CQE_F_BUFFER) {
+        recvPacket(cqe.flags >> IORING_CQE_BUFFER_SHIFT,cqe.res);
+    }
+    if(cqe.flags & IORING_CQE_F_MORE) {
+        return;
+    }
+    mArmed = false;
+    --mInFlight;
+    if(mStop) {
+        return;
+    }
+    if(cqe.res == -EINVAL && !(cqe.flags & IORING_CQE_F_BUFFER)) {
+        mRing.unregisterBufRing(BufGroup);
+        mMultishot = false;
+    }
+    if(cqe.res == -ENOBUFS && !mCancelling) {
+        return;                     // all slots are filled, armed again by issue() of next submit/reap
+    }
+    if(mCancelling) {
+        mCancelling = false;
+        if(mFill) {
+            deliverFront();
+        }
+        if(mMultishot) {
+            ringRebuild();
+        }
+    }
+    issue();
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::onChainRead(const io_uring_cqe& cqe)
+{
+    --mInFlight;
+    if(cqe.res >= 0) {
+        recvPacket(static_cast<unsigned>(cqe.user_data),cqe.res);
+    } else if(cqe.res != -ECANCELED) {
+        mStatus = SocketTransferError;
+    }
+    if(--mChainOps > 0) {
+        return;
+    }
+    mArmed = false;
+    if(mCancelling) {
+        mCancelling = false;
+        if(mFill) {
+            deliverFront();
+        }
+    }
+    issue();
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::onSend(const io_uring_cqe& cqe)
+{
+    --mInFlight;
+    const int bundleId = static_cast<int>(cqe.user_data/mPacketNum);
+    if(cqe.res >= 0) {
+        mTxSent[bundleId] += cqe.res;
+    } else if(mTxGso[bundleId] && !mStop && (cqe.res == -EIO || cqe.res == -EINVAL || cqe.res == -EMSGSIZE)) {
+        //--- no GSO on the route (e.g. device without checksum offload), the next ops of the chain are cancelled
+        if(mChannel.offload()) {
+            const int segSize = 0;
+            setsockopt(mFd,SOL_UDP,UDP_SEGMENT,&segSize,sizeof(segSize));
+            mChannel.setOffload(false);
+        }
+        mTxResend[bundleId] = true;
+    } else {
+        mTxStatus[bundleId] = SocketTransferError;
+    }
+    if(--mTxOps[bundleId] > 0) {
+        return;
+    }
+    if(mTxResend[bundleId]) {
+        mTxResendQueue.push_back(bundleId);
+        issue();
+        return;
+    }
+    if(mTxStatus[bundleId] == Ok && mTxSent[bundleId] != mTxLength[bundleId]) {
+        mTxStatus[bundleId] = XmitLenError;
+    }
+    mChannel.pacer().sent((mTxSent[bundleId] + mPacketSize - 1)/mPacketSize,mTxSent[bundleId],mTxStart[bundleId],TTxPacer::now());
+    mChannel.complete(bundleId,mTxSent[bundleId],mTxStatus[bundleId]);
+}
+
+//-----------------------------------------------------------------------------
+//  false - no CQE
+//-----------------------------------------------------------------------------
+inline bool TUringIo::process()
+{
+    bool res = false;
+    while(io_uring_cqe* cqePtr = mRing.peekCqe()) {
+        const io_uring_cqe cqe = *cqePtr;
+        mRing.cqeSeen();
+        res = true;
+        if(cqe.user_data == CancelTag) {
+            --mInFlight;
+            if(cqe.res < 0 && !mStop) {
+                mCancelling = false;       // the op is already complete
+            }
+        } else if(cqe.user_data == WakeTag) {
+            --mInFlight;
+        } else if(cqe.user_data == RecvTag) {
+            onRecv(cqe);
+        } else if(mDir == Receive) {
+            onChainRead(cqe);
+        } else {
+            onSend(cqe);
+        }
+    }
+    if(mPending) {
+        mPending = false;
+        submit();
+    }
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+inline unsigned TUringIo::flushWait() const
+{
+    const unsigned timeout = mChannel.params().timeout;
+    if(mDir != Receive || !mFill || mCancelling || !timeout || timeout == INFINITE) {
+        return INFINITE;
+    }
+    const long long passed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - mLastPacket).count();
+    return (passed >= timeout) ? 0 : static_cast<unsigned>(timeout - passed);
+}
+
+//-----------------------------------------------------------------------------
+//  partly filled front bundle after TParams::timeout without packets
+//-----------------------------------------------------------------------------
+inline void TUringIo::checkFlush()
+{
+    if(mStop || flushWait() != 0) {
+        return;
+    }
+    if(!mArmed) {
+        deliverFront();
+        if(mMultishot) {
+            ringRebuild();
+        }
+        issue();
+    } else {
+        cancel(mMultishot ? RecvTag : static_cast<uint64_t>(mRxBundles.front())*mPacketNum + mFill);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TUringIo::reap(unsigned timeoutMs)
+{
+    unsigned waitMs;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        issue();
+        const bool done = process();
+        checkFlush();
+        if(done || !timeoutMs) {
+            return;
+        }
+        waitMs = std::min(timeoutMs,flushWait());
+    }
+    if(waitMs) {
+        mRing.wait(waitMs);
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    process();
+    checkFlush();
+}
+#endif // QUDP_URING
+
+//-----------------------------------------------------------------------------
+//  socket bound to host address/port, receive and/or transmit channel
+//-----------------------------------------------------------------------------
+class TSocket
+{
+    public:
+        TSocket(unsigned long hostAddr, unsigned hostPort) : mFd(-1), mHostAddr(hostAddr), mHostPort(hostPort), mGatherGso(false) {}
+        ~TSocket();
+
+        TStatus create(const TParams* rxParams, const TParams* txParams);
+
+        //--- channels are closed, the socket is freed by its last user
+        void close();
+
+        //--- 0 when the direction does not exist
+        TChannel* channel(TDirection dir) const { return (dir == Receive) ? mRx.get() : (dir == Transmit) ? mTx.get() : 0; }
+
+        //--- transmit channel exists
+        TStatus sendGather(const TGatherPacket* packets, unsigned packetNum);
+
+    private:
+        TSocket(const TSocket&);
+        TSocket& operator=(const TSocket&);
+
+        TChannelIo* createIo(TChannel& channel, int fd, unsigned queue);
+        TStatus createQueues(const TParams& rxParams);
+
+        static const unsigned MaxGatherIovs = 1024;    // UIO_MAXIOV
+        static const size_t   CmsgWords     = (CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t)) + sizeof(uint64_t) - 1)/sizeof(uint64_t);
+
+        int                                      mFd;
+        std::vector<int>                         mQueueFds;     // receive queues 1.., queue 0 - mFd
+        const unsigned long                      mHostAddr;
+        const unsigned                           mHostPort;
+        std::unique_ptr<TChannel>                mRx;
+        std::unique_ptr<TChannel>                mTx;
+        std::vector<std::unique_ptr<TChannelIo>> mRxIo;         // per queue
+        std::unique_ptr<TChannelIo>              mTxIo;
+        std::atomic<bool>                        mGatherGso;
+};
+
+//-----------------------------------------------------------------------------
+inline TSocket::~TSocket()
+{
+    close();
+    if(mFd >= 0) {
+        shutdown(mFd,SHUT_RDWR);
+    }
+    for(size_t n = 0; n < mQueueFds.size(); ++n) {
+        shutdown(mQueueFds[n],SHUT_RDWR);
+    }
+    mRxIo.clear();
+    mTxIo.reset();
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+    for(size_t n = 0; n < mQueueFds.size(); ++n) {
+        ::close(mQueueFds[n]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline void TSocket::close()
+{
+    if(mRx) {
+        mRx->close();
+    }
+    if(mTx) {
+        mTx->close();
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+inline TStatus TSocket::create(const TParams* rxParams, const TParams* txParams)
+{
+    if(!rxParams && !txParams) {
+        return SocketCreationError;
+    }
+    const TNetAddr host = { mHostAddr, mHostPort };
+    if(rxParams) {
+        mRx.reset(new TChannel(Receive,*rxParams,host));
+    }
+    if(txParams) {
+        mTx.reset(new TChannel(Transmit,*txParams,host));
+    }
+    if((mRx && !mRx->isValid()) || (mTx && !mTx->isValid())) {
+        return SocketCreationError;
+    }
+
+    mFd = socket(AF_INET,SOCK_DGRAM | SOCK_CLOEXEC,0);
+    if(mFd < 0) {
+        return SocketCreationError;
+    }
+    if(rxParams) {
+        setRxOptions(mFd,*rxParams);
+        if(mRx->queueNum() > 1) {
+            const int on = 1;
+            setsockopt(mFd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on));
+        }
+    }
+    if(txParams) {
+        setSocketBufSize(mFd,Transmit,txParams->socketBufSize);
+        if(txParams->options & UseOffload) {
+            const int segSize = static_cast<int>(txParams->netPacketSize);
+            mTx->setOffload(setsockopt(mFd,SOL_UDP,UDP_SEGMENT,&segSize,sizeof(segSize)) == 0);
+            mGatherGso = mTx->offload();
+        }
+        if((txParams->options & TxTime) && mTx->pacer().isActive()) {
+            sock_txtime txTime;
+            txTime.clockid = CLOCK_MONOTONIC;
+            txTime.flags   = 0;
+            mTx->pacer().setTxTime(setsockopt(mFd,SOL_SOCKET,SO_TXTIME,&txTime,sizeof(txTime)) == 0);
+        }
+    }
+    const sockaddr_in addr = sockAddr(mHostAddr,mHostPort);
+    if(bind(mFd,reinterpret_cast<const sockaddr*>(&addr),sizeof(addr)) != 0) {
+        return SocketBindError;
+    }
+    if(mRx && mRx->queueNum() > 1) {
+        const TStatus status = createQueues(*rxParams);
+        if(status != Ok) {
+            return status;
+        }
+    }
+
+    if(mRx) {
+        for(unsigned queue = 0; queue < mRx->queueNum(); ++queue) {
+            mRxIo.push_back(std::unique_ptr<TChannelIo>(createIo(*mRx,queue ? mQueueFds[queue - 1] : mFd,queue)));
+        }
+    }
+    if(mTx) {
+        mTxIo.reset(createIo(*mTx,mFd,0));
+    }
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+//  sockets of receive queues 1.. join the SO_REUSEPORT group of mFd, the
+//  index of a socket in the group is its queue. The kernel selects the
+//  socket by flow hash (addresses and ports), so packets of one flow keep
+//  their order; the steering program selects it by peer address or by the
+//  receiving CPU (RSS/RPS queue of the NIC), see TOption
+//-----------------------------------------------------------------------------
+inline TStatus TSocket::createQueues(const TParams& rxParams)
+{
+    const sockaddr_in addr = sockAddr(mHostAddr,mHostPort);
+    const int on = 1;
+    for(unsigned queue = 1; queue < mRx->queueNum(); ++queue) {
+        const int fd = socket(AF_INET,SOCK_DGRAM | SOCK_CLOEXEC,0);
+        if(fd < 0) {
+            return SocketCreationError;
+        }
+        mQueueFds.push_back(fd);
+        setRxOptions(fd,rxParams);
+        if(setsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on)) != 0 || bind(fd,reinterpret_cast<const sockaddr*>(&addr),sizeof(addr)) != 0) {
+            return SocketBindError;
+        }
+    }
+
+    if(rxParams.options & (SteerByPeer | SteerByCpu)) {
+        const uint32_t src = (rxParams.options & SteerByCpu) ? static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)
+                                                             : static_cast<uint32_t>(SKF_NET_OFF + 12);   // IPv4 source address
+        sock_filter code[] =
+        {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS,src),
+            BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,mRx->queueNum()),
+            BPF_STMT(BPF_RET | BPF_A,0)
+        };
+        sock_fprog prog;
+        prog.len    = sizeof(code)/sizeof(code[0]);
+        prog.filter = code;
+        if(setsockopt(mFd,SOL_SOCKET,SO_ATTACH_REUSEPORT_CBPF,&prog,sizeof(prog)) != 0) {
+            return SocketCreationError;
+        }
+    }
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+inline TChannelIo* TSocket::createIo(TChannel& channel, int fd, unsigned queue)
+{
+    const bool rxStamps = channel.direction() == Receive && (channel.params().options & RxTimestamps);
+#if defined(QUDP_URING)
+    if((channel.params().options & UseUring) && !channel.params().onTransferReady && channel.queueNum() == 1 && !rxStamps && !channel.pacer().isActive()) {
+        TUringIo* io = new TUringIo(fd,channel);
+        if(io->start()) {
+            channel.setIo(io);
+            return io;
+        }
+        delete io;
+    }
+#endif
+    const int on = 1;
+    if(channel.direction() == Receive && (channel.params().options & UseOffload)) {
+        channel.setOffload(setsockopt(fd,SOL_UDP,UDP_GRO,&on,sizeof(on)) == 0);
+    }
+    if(rxStamps) {
+        setsockopt(fd,SOL_SOCKET,SO_TIMESTAMPNS,&on,sizeof(on));
+        setsockopt(fd,SOL_SOCKET,SO_RXQ_OVFL,&on,sizeof(on));
+    }
+    TMmsgIo* io = new TMmsgIo(fd,channel,queue);
+    if(!queue) {
+        channel.setIo(io);
+    }
+    io->start();
+    return io;
+}
+
+//-----------------------------------------------------------------------------
+//  packets go to the peer of the transmit channel from the caller memory by
+//  sendmmsg() of the calling thread, bypassing the bundles; the memory may be
+//  reused on return. GSO - runs of whole packets (the last one of a run may be
+//  shorter) are one message with own UDP_SEGMENT; with the socket option set
+//  (offload channel) every message has own UDP_SEGMENT, 0 for a packet, so
+//  the fallback does not depend on the option cleared by the channel. Paced - bursts of messages of the channel
+//  pacer, a GSO run is not longer than the burst
+//-----------------------------------------------------------------------------
+inline TStatus TSocket::sendGather(const TGatherPacket* packets, unsigned packetNum)
+{
+    TTxPacer&      pacer      = mTx->pacer();
+    const unsigned packetSize = mTx->params().netPacketSize;
+    const bool     gso        = mGatherGso;
+    const bool     segCmsg    = mTx->offload();     // UDP_SEGMENT of the socket may be set
+    const unsigned gsoRun     = gso ? gsoStride(static_cast<int>(packetSize))/packetSize : 1;
+    const unsigned runMax     = pacer.isActive() ? std::min(gsoRun,pacer.burst()) : gsoRun;
+
+    //--- messages: packet or GSO run, iovs of message 'm' are [msgIov[m], msgIov[m + 1])
+    std::vector<iovec>    iovs;
+    std::vector<unsigned> msgIov;
+    std::vector<unsigned> msgPacket;        // first packet
+    std::vector<unsigned> msgLen;
+    std::vector<uint16_t> msgSegSize;       // 0 - no GSO
+    for(unsigned n = 0; n < packetNum; ) {
+        msgIov.push_back(static_cast<unsigned>(iovs.size()));
+        msgPacket.push_back(n);
+        unsigned len = 0;
+        unsigned num = 0;
+        while(n < packetNum && num < runMax) {
+            const TGatherPacket& packet = packets[n];
+            if(num && (iovs.size() - msgIov.back() + packet.segmentNum > MaxGatherIovs)) {
+                break;
+            }
+            unsigned packetLen = 0;
+            for(unsigned k = 0; k < packet.segmentNum; ++k) {
+                const iovec iov = { const_cast<void*>(packet.segments[k].buf), packet.segments[k].length };
+                iovs.push_back(iov);
+                packetLen += packet.segments[k].length;
+            }
+            if(packetLen > packetSize) {
+                return SubmitError;
+            }
+            len += packetLen;
+            ++num;
+            ++n;
+            if(packetLen != packetSize) {
+                break;                      // short packet ends the run
+            }
+        }
+        msgLen.push_back(len);
+        msgSegSize.push_back(static_cast<uint16_t>((num > 1) ? packetSize : 0));
+    }
+    msgIov.push_back(static_cast<unsigned>(iovs.size()));
+    msgPacket.push_back(packetNum);
+
+    const size_t msgNum = msgLen.size();
+    sockaddr_in peer = sockAddr(mTx->params().peerAddr,mTx->params().peerPort);
+    std::vector<mmsghdr> msgs(msgNum);
+    std::vector<uint64_t> control(msgNum*CmsgWords);
+    for(size_t m = 0; m < msgNum; ++m) {
+        msghdr& hdr = msgs[m].msg_hdr;
+        std::memset(&msgs[m],0,sizeof(msgs[m]));
+        hdr.msg_name    = &peer;
+        hdr.msg_namelen = sizeof(peer);
+        hdr.msg_iov     = iovs.empty() ? 0 : &iovs[msgIov[m]];
+        hdr.msg_iovlen  = msgIov[m + 1] - msgIov[m];
+        if(pacer.txTime()) {
+            hdr.msg_control = &control[m*CmsgWords];
+        }
+        if(segCmsg) {
+            hdr.msg_control    = &control[m*CmsgWords];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+            std::memcpy(CMSG_DATA(cmsg),&msgSegSize[m],sizeof(uint16_t));
+        }
+    }
+
+    TStatus  status    = Ok;
+    size_t   sent      = 0;
+    size_t   burstEnd  = 0;
+    unsigned sentBytes = 0;
+    uint64_t start     = TTxPacer::now();
+    uint64_t departure = 0;
+    while(sent < msgNum && status == Ok) {
+        if(sent == burstEnd) {
+            burstEnd = msgNum;
+            if(pacer.isActive()) {
+                unsigned burstPackets = 0;
+                unsigned burstBytes   = 0;
+                for(burstEnd = sent; burstEnd < msgNum; ++burstEnd) {
+                    const unsigned num = msgPacket[burstEnd + 1] - msgPacket[burstEnd];
+                    if(burstEnd > sent && burstPackets + num > pacer.burst()) {
+                        break;
+                    }
+                    burstPackets += num;
+                    burstBytes   += msgLen[burstEnd];
+                }
+                departure = pacer.pace(burstPackets,burstBytes);
+                if(!sent) {
+                    start = pacer.txTime() ? departure : TTxPacer::now();
+                }
+                if(pacer.txTime()) {
+                    for(size_t m = sent; m < burstEnd; ++m) {
+                        addTxTime(msgs[m].msg_hdr,departure);
+                    }
+                }
+            }
+        }
+        const int res = sendmmsg(mFd,&msgs[sent],static_cast<unsigned>(burstEnd - sent),0);
+        if(res > 0) {
+            for(size_t m = sent; m < sent + res; ++m) {
+                sentBytes += msgs[m].msg_len;
+                if(msgs[m].msg_len != msgLen[m]) {
+                    status = XmitLenError;
+                }
+            }
+            sent += res;
+        } else if(res < 0 && gso && (errno == EIO || errno == EINVAL || errno == EMSGSIZE)) {
+            //--- no GSO on the route, the rest goes packet by packet
+            mGatherGso = false;
+            pacer.sent(msgPacket[sent],sentBytes,start,TTxPacer::now());
+            return sendGather(packets + msgPacket[sent],packetNum - msgPacket[sent]);
+        } else if(res < 0 && errno != EINTR) {
+            status = SocketTransferError;
+        }
+    }
+    pacer.sent(msgPacket[sent],sentBytes,start,std::max(TTxPacer::now(),departure));
+    return status;
+}
+
+//-----------------------------------------------------------------------------
+//  socket table of the library: sockets are held by shared pointer, so a
+//  call waiting in getTransfer() does not hold the table lock
+//-----------------------------------------------------------------------------
+class TLib
+{
+    public:
+        typedef std::shared_ptr<TSocket> TSocketPtr;
+
+        static TLib& instance()
+        {
+            static TLib lib;
+            return lib;
+        }
+
+        TStatus init();
+        TStatus cleanUp();
+        TStatus status() const;
+        TStatus createSocket(unsigned long hostAddr, unsigned hostPort, const TParams* rxParams, const TParams* txParams, TSocketPtr* socketPtr = 0);
+        TSocketPtr socket(unsigned long hostAddr, unsigned hostPort) const;
+        TStatus find(unsigned long hostAddr, unsigned hostPort, TSocketPtr& socketPtr) const;
+
+    private:
+        typedef uint64_t TKey;
+        static TKey key(unsigned long hostAddr, unsigned hostPort) { return (static_cast<uint64_t>(hostAddr & 0xFFFFFFFF) << 16) | (hostPort & 0xFFFF); }
+
+        TLib() : mInit(false) {}
+
+        mutable std::mutex         mMutex;
+        std::map<TKey,TSocketPtr>  mSockets;
+        bool                       mInit;
+};
+
+//-----------------------------------------------------------------------------
+inline TStatus TLib::init()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mInit = true;
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+//  channels of the sockets are closed, so the waiting calls return; a socket
+//  is freed when the last call (or handle) using it is done
+//-----------------------------------------------------------------------------
+inline TStatus TLib::cleanUp()
+{
+    std::map<TKey,TSocketPtr> sockets;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(!mInit) {
+            return NotInitialized;
+        }
+        mInit = false;
+        sockets.swap(mSockets);
+    }
+    for(std::map<TKey,TSocketPtr>::iterator it = sockets.begin(); it != sockets.end(); ++it) {
+        it->second->close();
+    }
+    return Ok;
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TLib::status() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mInit ? Ok : NotInitialized;
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TLib::createSocket(unsigned long hostAddr, unsigned hostPort, const TParams* rxParams, const TParams* txParams, TSocketPtr* socketPtr)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mInit) {
+        return NotInitialized;
+    }
+    if(mSockets.count(key(hostAddr,hostPort))) {
+        return SocketAlreadyExist;
+    }
+    TSocketPtr newSocket = std::make_shared<TSocket>(hostAddr,hostPort);
+    const TStatus status = newSocket->create(rxParams,txParams);
+    if(status == Ok) {
+        mSockets[key(hostAddr,hostPort)] = newSocket;
+        if(socketPtr) {
+            *socketPtr = newSocket;
+        }
+    }
+    return status;
+}
+
+//-----------------------------------------------------------------------------
+inline TLib::TSocketPtr TLib::socket(unsigned long hostAddr, unsigned hostPort) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    const std::map<TKey,TSocketPtr>::const_iterator it = mSockets.find(key(hostAddr,hostPort));
+    return (it != mSockets.end()) ? it->second : TSocketPtr();
+}
+
+//-----------------------------------------------------------------------------
+inline TStatus TLib::find(unsigned long hostAddr, unsigned hostPort, TSocketPtr& socketPtr) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mInit) {
+        return NotInitialized;
+    }
+    const std::map<TKey,TSocketPtr>::const_iterator it = mSockets.find(key(hostAddr,hostPort));
+    if(it == mSockets.end()) {
+        return SocketNotExist;
+    }
+    socketPtr = it->second;
+    return Ok;
+}
+
+}
+}
+
+//-----------------------------------------------------------------------------
+//  qudp_lib.h entry points
+//-----------------------------------------------------------------------------
+#if defined(QUDP_LIB_LINUX_IMPL)
+
+#include "qudp_lib.h"
+
+namespace UDP_LIB
+{
+    //--- socket handle: the socket is held until releaseSocketHandle()
+    struct TSocketObject
+    {
+        Linux::TLib::TSocketPtr socketPtr;
+    };
+
+namespace Linux
+{
+    //--- channel of the handle socket or status
+    inline TStatus findChannel(TSocketHandle handle, TDirection dir, TChannel*& channel)
+    {
+        if(!handle) {
+            return SocketNotExist;
+        }
+        channel = handle->socketPtr->channel(dir);
+        return channel ? Ok : SocketXmitNotExist;
+    }
+
+    //--- existing socket as a temporary handle of the address API call
+    inline TStatus findSocket(unsigned long hostAddr, unsigned hostPort, TSocketObject& socket)
+    {
+        return TLib::instance().find(hostAddr,hostPort,socket.socketPtr);
+    }
+}
+}
+
+UDP_LIB::TStatus UDP_LIB::init() { return Linux::TLib::instance().init(); }
+UDP_LIB::TStatus UDP_LIB::cleanUp() { return Linux::TLib::instance().cleanUp(); }
+UDP_LIB::TStatus UDP_LIB::getStatus() { return Linux::TLib::instance().status(); }
+bool UDP_LIB::isSocketExist(unsigned long hostAddr, unsigned hostPort) { return Linux::TLib::instance().socket(hostAddr,hostPort) != 0; }
+
+//-----------------------------------------------------------------------------
+bool UDP_LIB::isDirectionExist(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir)
+{
+    const Linux::TLib::TSocketPtr socketPtr = Linux::TLib::instance().socket(hostAddr,hostPort);
+    return socketPtr && socketPtr->channel(dir);
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::createSocket(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::TParams* rxParams, const UDP_LIB::TParams* txParams)
+{
+    return Linux::TLib::instance().createSocket(hostAddr,hostPort,rxParams,txParams);
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::submitTransfer(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? submitTransferH(&socket,dir,transfer) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getTransfer(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer, unsigned timeout)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? getTransferH(&socket,dir,transfer,timeout) : status;
+}
+
+//-----------------------------------------------------------------------------
+unsigned UDP_LIB::getReadyTransferNum(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir)
+{
+    TSocketObject socket;
+    return (Linux::findSocket(hostAddr,hostPort,socket) == Ok) ? getReadyTransferNumH(&socket,dir) : 0;
+}
+
+//-----------------------------------------------------------------------------
+int UDP_LIB::getReadyHandle(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir)
+{
+    TSocketObject socket;
+    return (Linux::findSocket(hostAddr,hostPort,socket) == Ok) ? getReadyHandleH(&socket,dir) : -1;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::tryGetTransfer(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? tryGetTransferH(&socket,dir,transfer) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::sendGather(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::TGatherPacket* packets, unsigned packetNum)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? sendGatherH(&socket,packets,packetNum) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getRxInfo(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::Transfer& transfer, UDP_LIB::TRxInfo& info)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? getRxInfoH(&socket,transfer,info) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getTxStat(unsigned long hostAddr, unsigned hostPort, UDP_LIB::TTxStat& stat)
+{
+    TSocketObject socket;
+    const TStatus status = Linux::findSocket(hostAddr,hostPort,socket);
+    return (status == Ok) ? getTxStatH(&socket,stat) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::createSocketHandle(unsigned long hostAddr, unsigned hostPort, const UDP_LIB::TParams* rxParams, const UDP_LIB::TParams* txParams,
+                                             UDP_LIB::TSocketHandle& handle)
+{
+    Linux::TLib::TSocketPtr socketPtr;
+    const TStatus status = Linux::TLib::instance().createSocket(hostAddr,hostPort,rxParams,txParams,&socketPtr);
+    handle = 0;
+    if(status == Ok) {
+        handle = new TSocketObject;
+        handle->socketPtr = socketPtr;
+    }
+    return status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TSocketHandle UDP_LIB::getSocketHandle(unsigned long hostAddr, unsigned hostPort)
+{
+    TSocketObject socket;
+    if(Linux::findSocket(hostAddr,hostPort,socket) != Ok) {
+        return 0;
+    }
+    TSocketHandle handle = new TSocketObject;
+    handle->socketPtr.swap(socket.socketPtr);
+    return handle;
+}
+
+//-----------------------------------------------------------------------------
+void UDP_LIB::releaseSocketHandle(UDP_LIB::TSocketHandle handle) { delete handle; }
+
+//-----------------------------------------------------------------------------
+bool UDP_LIB::isDirectionExistH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir)
+{
+    return handle && handle->socketPtr->channel(dir);
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::submitTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,dir,channel);
+    return (status == Ok) ? channel->submit(transfer) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer, unsigned timeout)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,dir,channel);
+    return (status == Ok) ? channel->get(transfer,timeout) : status;
+}
+
+//-----------------------------------------------------------------------------
+unsigned UDP_LIB::getReadyTransferNumH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir)
+{
+    Linux::TChannel* channel = 0;
+    return (Linux::findChannel(handle,dir,channel) == Ok) ? channel->readyNum() : 0;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::tryGetTransferH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir, UDP_LIB::Transfer& transfer)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,dir,channel);
+    return (status == Ok) ? channel->tryGet(transfer) : status;
+}
+
+//-----------------------------------------------------------------------------
+int UDP_LIB::getReadyHandleH(UDP_LIB::TSocketHandle handle, UDP_LIB::TDirection dir)
+{
+    Linux::TChannel* channel = 0;
+    return (Linux::findChannel(handle,dir,channel) == Ok) ? channel->eventFd() : -1;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::sendGatherH(UDP_LIB::TSocketHandle handle, const UDP_LIB::TGatherPacket* packets, unsigned packetNum)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,Transmit,channel);
+    return (status == Ok) ? handle->socketPtr->sendGather(packets,packetNum) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getRxInfoH(UDP_LIB::TSocketHandle handle, const UDP_LIB::Transfer& transfer, UDP_LIB::TRxInfo& info)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,Receive,channel);
+    return (status == Ok) ? channel->rxInfo(transfer,info) : status;
+}
+
+//-----------------------------------------------------------------------------
+UDP_LIB::TStatus UDP_LIB::getTxStatH(UDP_LIB::TSocketHandle handle, UDP_LIB::TTxStat& stat)
+{
+    Linux::TChannel* channel = 0;
+    const TStatus status = Linux::findChannel(handle,Transmit,channel);
+    if(status == Ok) {
+        stat = channel->pacer().stat();
+    }
+    return status;
+}
+
+#endif // QUDP_LIB_LINUX_IMPL
+
+#endif // QUDP_LINUX_H
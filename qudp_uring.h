@@ -0,0 +1,257 @@
+#if !defined(QUDP_URING_H)
+#define QUDP_URING_H
+
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+    #include <linux/io_uring.h>
+#endif
+
+//-----------------------------------------------------------------------------
+//  io_uring is used by raw system calls (no liburing). QUDP_URING is defined
+//  when the kernel headers have everything used here (Linux 6.0 UAPI); the
+//  running kernel is checked by TUring::init() and by the ops themselves
+//-----------------------------------------------------------------------------
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT) && defined(IORING_ENTER_EXT_ARG)
+    #define QUDP_URING
+#endif
+
+#if defined(QUDP_URING)
+
+namespace UDP_LIB
+{
+namespace Linux
+{
+
+//-----------------------------------------------------------------------------
+//  SQ/CQ rings of one io_uring instance. The class is not thread-safe: SQ
+//  filling and CQ consumption are serialized by the owner; wait() may be
+//  called without that lock (it does not touch the rings)
+//-----------------------------------------------------------------------------
+class TUring
+{
+    public:
+        TUring() : mFd(-1), mSqRing(0), mCqRing(0), mSqes(0), mSqRingSize(0), mCqRingSize(0), mSqesSize(0), mSqHead(0), mSqTail(0), mSqMask(0),
+                   mSqArray(0), mSqEntries(0), mCqHead(0), mCqTail(0), mCqMask(0), mCqes(0), mSqLocalTail(0) {}
+        ~TUring() { close(); }
+
+        //--- false when io_uring is not available (kernel, seccomp) or lacks required features
+        bool init(unsigned sqEntries, unsigned cqEntries);
+        void close();
+        bool isValid() const { return mFd >= 0; }
+
+        //--- 0 when SQ is full: submit() and retry
+        io_uring_sqe* sqe();
+        unsigned sqSpace() const { return mSqEntries - (mSqLocalTail - __atomic_load_n(mSqHead,__ATOMIC_ACQUIRE)); }
+        int submit();
+
+        //--- waits up to 'timeoutMs' for a CQE, INFINITE - no limit
+        int wait(unsigned timeoutMs);
+
+        io_uring_cqe* peekCqe() const
+        {
+            const unsigned head = *mCqHead;
+            return (head != __atomic_load_n(mCqTail,__ATOMIC_ACQUIRE)) ? &mCqes[head & *mCqMask] : 0;
+        }
+        void cqeSeen() { __atomic_store_n(mCqHead,*mCqHead + 1,__ATOMIC_RELEASE); }
+
+        int registerBuffers(const iovec* iovs, unsigned num) { return enterRegister(IORING_REGISTER_BUFFERS,iovs,num); }
+        int registerEventFd(int fd) { return enterRegister(IORING_REGISTER_EVENTFD,&fd,1); }
+        int registerBufRing(io_uring_buf* ring, unsigned entries, unsigned groupId);
+        int unregisterBufRing(unsigned groupId);
+
+        //--- provided buffer ring, 'entries' is a power of 2; the ring is an array of
+        //    io_uring_buf with tail in resv of entry 0 (io_uring_buf_ring::bufs is not
+        //    at offset 0 in C++: __DECLARE_FLEX_ARRAY adds an empty struct member)
+        static void bufRingAdd(io_uring_buf* ring, unsigned entries, unsigned offset, void* addr, unsigned len, unsigned bufId)
+        {
+            io_uring_buf& buf = ring[(ring[0].resv + offset) & (entries - 1)];
+            buf.addr = reinterpret_cast<uintptr_t>(addr);
+            buf.len  = len;
+            buf.bid  = static_cast<uint16_t>(bufId);
+        }
+        static void bufRingAdvance(io_uring_buf* ring, unsigned count) { __atomic_store_n(&ring[0].resv,static_cast<uint16_t>(ring[0].resv + count),__ATOMIC_RELEASE); }
+
+    private:
+        TUring(const TUring&);
+        TUring& operator=(const TUring&);
+
+        int enterRegister(unsigned opcode, const void* arg, unsigned num) { return syscall(__NR_io_uring_register,mFd,opcode,arg,num) < 0 ? -errno : 0; }
+
+        int           mFd;
+        void*         mSqRing;
+        void*         mCqRing;
+        io_uring_sqe* mSqes;
+        size_t        mSqRingSize;
+        size_t        mCqRingSize;
+        size_t        mSqesSize;
+        unsigned*     mSqHead;
+        unsigned*     mSqTail;
+        unsigned*     mSqMask;
+        unsigned*     mSqArray;
+        unsigned      mSqEntries;
+        unsigned*     mCqHead;
+        unsigned*     mCqTail;
+        unsigned*     mCqMask;
+        io_uring_cqe* mCqes;
+        unsigned      mSqLocalTail;
+};
+
+//-----------------------------------------------------------------------------
+//  no COOP_TASKRUN: completion work runs on the submitting thread, which may
+//  be any user thread, so it must be notified. SUBMIT_ALL (5.18) is dropped
+//  for older kernels; EXT_ARG (timed wait, 5.11) and NODROP are required
+//-----------------------------------------------------------------------------
+inline bool TUring::init(unsigned sqEntries, unsigned cqEntries)
+{
+    io_uring_params params;
+    std::memset(&params,0,sizeof(params));
+    params.flags      = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    params.cq_entries = cqEntries;
+    mFd = static_cast<int>(syscall(__NR_io_uring_setup,sqEntries,&params));
+    if(mFd < 0 && errno == EINVAL) {
+        std::memset(&params,0,sizeof(params));
+        params.flags      = IORING_SETUP_CQSIZE;
+        params.cq_entries = cqEntries;
+        mFd = static_cast<int>(syscall(__NR_io_uring_setup,sqEntries,&params));
+    }
+    if(mFd < 0) {
+        return false;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close();
+        return false;
+    }
+
+    mSqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    mCqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+    mSqRingSize = mCqRingSize = (mSqRingSize > mCqRingSize) ? mSqRingSize : mCqRingSize;
+    mSqesSize   = params.sq_entries*sizeof(io_uring_sqe);
+
+    mSqRing = mmap(0,mSqRingSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,mFd,IORING_OFF_SQ_RING);
+    if(mSqRing == MAP_FAILED) {
+        mSqRing = 0;
+        close();
+        return false;
+    }
+    mCqRing = mSqRing;
+    void* sqes = mmap(0,mSqesSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,mFd,IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        close();
+        return false;
+    }
+    mSqes = static_cast<io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(mSqRing);
+    uint8_t* cq = static_cast<uint8_t*>(mCqRing);
+    mSqHead      = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    mSqTail      = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    mSqMask      = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    mSqArray     = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    mSqEntries   = params.sq_entries;
+    mCqHead      = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    mCqTail      = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    mCqMask      = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    mCqes        = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    mSqLocalTail = *mSqTail;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//  the kernel cancels requests in flight when the ring is closed
+//-----------------------------------------------------------------------------
+inline void TUring::close()
+{
+    if(mSqes) {
+        munmap(mSqes,mSqesSize);
+        mSqes = 0;
+    }
+    if(mSqRing) {
+        munmap(mSqRing,mSqRingSize);
+        mSqRing = mCqRing = 0;
+    }
+    if(mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+inline io_uring_sqe* TUring::sqe()
+{
+    const unsigned head = __atomic_load_n(mSqHead,__ATOMIC_ACQUIRE);
+    if(mSqLocalTail - head >= mSqEntries) {
+        return 0;
+    }
+    const unsigned idx = mSqLocalTail & *mSqMask;
+    mSqArray[idx] = idx;
+    ++mSqLocalTail;
+    io_uring_sqe* sqe = &mSqes[idx];
+    std::memset(sqe,0,sizeof(*sqe));
+    return sqe;
+}
+
+//-----------------------------------------------------------------------------
+inline int TUring::submit()
+{
+    const unsigned toSubmit = mSqLocalTail - *mSqTail;
+    if(!toSubmit) {
+        return 0;
+    }
+    __atomic_store_n(mSqTail,mSqLocalTail,__ATOMIC_RELEASE);
+    int res;
+    do {
+        res = static_cast<int>(syscall(__NR_io_uring_enter,mFd,toSubmit,0,0,0,0));
+    } while(res < 0 && errno == EINTR);
+    return res < 0 ? -errno : res;
+}
+
+//-----------------------------------------------------------------------------
+inline int TUring::wait(unsigned timeoutMs)
+{
+    __kernel_timespec ts;
+    ts.tv_sec  = timeoutMs/1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000)*1000000;
+    io_uring_getevents_arg arg;
+    std::memset(&arg,0,sizeof(arg));
+    arg.ts = (timeoutMs == 0xFFFFFFFF) ? 0 : reinterpret_cast<uintptr_t>(&ts);
+
+    const int res = static_cast<int>(syscall(__NR_io_uring_enter,mFd,0,1,IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,&arg,sizeof(arg)));
+    return (res < 0) ? -errno : res;
+}
+
+//-----------------------------------------------------------------------------
+inline int TUring::registerBufRing(io_uring_buf* ring, unsigned entries, unsigned groupId)
+{
+    io_uring_buf_reg reg;
+    std::memset(&reg,0,sizeof(reg));
+    reg.ring_addr    = reinterpret_cast<uintptr_t>(ring);
+    reg.ring_entries = entries;
+    reg.bgid         = static_cast<uint16_t>(groupId);
+    return enterRegister(IORING_REGISTER_PBUF_RING,&reg,1);
+}
+
+//-----------------------------------------------------------------------------
+inline int TUring::unregisterBufRing(unsigned groupId)
+{
+    io_uring_buf_reg reg;
+    std::memset(&reg,0,sizeof(reg));
+    reg.bgid = static_cast<uint16_t>(groupId);
+    return enterRegister(IORING_UNREGISTER_PBUF_RING,&reg,1);
+}
+
+}
+}
+
+#endif // QUDP_URING
+
+#endif // QUDP_URING_H
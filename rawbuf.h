@@ -15,24 +15,24 @@ class TRawBuf
 		template <typename T> class TCreator
 		{
 			public:
-				explicit TCreator(unsigned bufSize) : mBufSize(bufSize) {}
+				explicit TCreator(size_t bufSize) : mBufSize(bufSize) {}
 				TRawBuf* createMsg() { return new TRawBuf(mBufSize,sizeof(T)); }
 
 			private:
-				unsigned mBufSize;
+				size_t mBufSize;
 		};
 		//---------------------------------------------------------------------
 
 		template <typename T> T* getDataBuf() { return reinterpret_cast<T*>(mBuf); }
-		unsigned byteBufSize() const { return mByteBufSize; }
-		unsigned byteDataLen() const { return mByteDataLen; }
+		size_t byteBufSize() const { return mByteBufSize; }
+		size_t byteDataLen() const { return mByteDataLen; }
 		unsigned elemSize() const { return mElemSize; }
 		//void setElemSize(unsigned);
-		unsigned nativeBufSize() const { return byteBufSize()/elemSize(); }
-		template <typename T> unsigned bufSize() const { return byteBufSize()/sizeof(T); }
-		template <typename T> unsigned dataLen() const { return byteDataLen()/sizeof(T); }
-		template <typename T> void setDataLen(unsigned dataLen)  { mByteDataLen = dataLen*sizeof(T); }
-		template <typename T> void resizeBuf(unsigned bufSize) { resizeBuf(bufSize, sizeof(T)); }
+		size_t nativeBufSize() const { return byteBufSize()/elemSize(); }
+		template <typename T> size_t bufSize() const { return byteBufSize()/sizeof(T); }
+		template <typename T> size_t dataLen() const { return byteDataLen()/sizeof(T); }
+		template <typename T> void setDataLen(size_t dataLen)  { mByteDataLen = dataLen*sizeof(T); }
+		template <typename T> void resizeBuf(size_t bufSize) { resizeBuf(bufSize, sizeof(T)); }
 
         //---
 		TRawBuf& operator=(const TRawBuf& right)
@@ -54,7 +54,7 @@ class TRawBuf
 	protected:
 		static const size_t BufAlignment = 128;
 
-		TRawBuf(unsigned bufSize, unsigned elemSize) : mElemSize(0), mByteBufSize(0), mByteDataLen(0), mBuf(0) { resizeBuf(bufSize,elemSize); }
+		TRawBuf(size_t bufSize, unsigned elemSize) : mElemSize(0), mByteBufSize(0), mByteDataLen(0), mBuf(0) { resizeBuf(bufSize,elemSize); }
 
         #if defined(Q_OS_WIN)
             virtual ~TRawBuf() { _aligned_free(mBuf); }
@@ -62,7 +62,8 @@ class TRawBuf
             virtual ~TRawBuf() { free(mBuf); }
         #endif
 
-		void resizeBuf(unsigned bufSize, unsigned elemSize)
+		//--- sizes are size_t: buffers of stitched/stacked frames exceed 4 GB
+		void resizeBuf(size_t bufSize, unsigned elemSize)
 		{
 			if(mByteBufSize != bufSize*elemSize) {
 				mByteBufSize = bufSize*elemSize;
@@ -73,6 +74,8 @@ class TRawBuf
                     free(mBuf);
                     int res = posix_memalign(&mBuf, BufAlignment, mByteBufSize);
                     if(res) {
+                        mBuf         = 0;
+                        mByteBufSize = 0;
                         qDebug() << "[ERROR] unsucessfull posix_memalign";
                     }
                 #endif
@@ -84,8 +87,8 @@ class TRawBuf
 		}
 
 		unsigned mElemSize;
-		unsigned mByteBufSize;
-		unsigned mByteDataLen;
+		size_t   mByteBufSize;
+		size_t   mByteDataLen;
 		void*    mBuf;
 };
 